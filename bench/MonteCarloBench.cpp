@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Analytic.h"
+#include "MonteCarlo.h"
+#include "Parallel.h"
+#include "Repricing.h"
+
+// End-to-end benchmarks of the pricing engine: random number generation, path stepping, full pricing latency, the
+// cost of the Greeks, incremental repricing, single against double precision and a convergence report against the
+// Black-Scholes price. Results are printed as tables and, with --json, written as one JSON document that can be
+// compared across releases. The exit code is non-zero if single precision moves any estimate too far.
+namespace {
+    constexpr std::uint64_t BENCH_SEED = 42;
+    constexpr int NUM_REPEATS = 3;
+    // Single precision passes if it moves the price, delta and vega by at most this many of their standard errors
+    constexpr double MAX_PRECISION_SHIFT = 0.1;
+    // A cached price passes if it is within this many standard errors of the same option simulated afresh
+    constexpr double MAX_REPRICING_SHIFT = 3.0;
+
+    struct BenchConfig {
+        bool quick = false;
+        std::string jsonPath;
+    };
+
+    struct Timing {
+        double wallSeconds;
+        double cpuSeconds;
+    };
+
+    // Best wall time of NUM_REPEATS runs, with the CPU time (summed over threads) of that run
+    template <typename Function>
+    Timing timeBestOf(Function function) {
+        Timing best = { 1e300, 0.0 };
+        for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+            const std::clock_t cpuStart = std::clock();
+            const auto wallStart = std::chrono::steady_clock::now();
+            function();
+            const std::chrono::duration<double> wallElapsed = std::chrono::steady_clock::now() - wallStart;
+            const double cpuSeconds = double (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+            if (wallElapsed.count() < best.wallSeconds) {
+                best = { wallElapsed.count(), cpuSeconds };
+            }
+        }
+        return best;
+    }
+
+    // Collects flat JSON objects, one per measurement
+    class JsonRecords {
+    public:
+        JsonRecords& begin() {
+            records.emplace_back();
+            return *this;
+        }
+
+        JsonRecords& field(const std::string& key, const std::string& value) {
+            append(key, "\"" + value + "\"");
+            return *this;
+        }
+
+        JsonRecords& field(const std::string& key, double value) {
+            std::ostringstream stream;
+            stream << std::setprecision(10) << (std::isfinite(value) ? value : 0.0);
+            append(key, stream.str());
+            return *this;
+        }
+
+        std::string toString(const std::string& indent) const {
+            std::string json = "[";
+            for (std::size_t i = 0; i < records.size(); i++) {
+                json += (i == 0 ? "\n" : ",\n") + indent + "  {" + records[i] + "}";
+            }
+            return json + "\n" + indent + "]";
+        }
+
+    private:
+        std::vector<std::string> records;
+
+        void append(const std::string& key, const std::string& value) {
+            std::string& record = records.back();
+            record += (record.empty() ? "\"" : ", \"") + key + "\": " + value;
+        }
+    };
+
+    SimulationSettings createSettings(int numSimulations, int numThreads) {
+        SimulationSettings settings;
+        settings.seed = BENCH_SEED;
+        settings.numThreads = numThreads;
+        settings.numSimulations = numSimulations;
+        return settings;
+    }
+
+    std::vector<int> getThreadCounts() {
+        const int maxThreads = resolveThreadCount(0);
+        return maxThreads > 1 ? std::vector<int> { 1, maxThreads } : std::vector<int> { 1 };
+    }
+
+    void outputHeader(const std::string& title) {
+        std::cout << std::endl << title << std::endl << std::string(title.size(), '-') << std::endl;
+    }
+
+    // Normals per second, materialised for every path and step the way a non-streamed run stores them
+    void benchmarkRandomNumbers(const BenchConfig& config, JsonRecords& records) {
+        outputHeader("Random number generation");
+        const int numPaths = config.quick ? 10000 : 100000;
+        for (bool quasiRandom : { false, true }) {
+            for (int numThreads : getThreadCounts()) {
+                const Timing timing = timeBestOf([&]() {
+                    const RandomNormals normals = quasiRandom
+                     ? createQuasiRandomNormals(numPaths, NUM_YEARLY_WORKING_DAYS, NUM_YEARLY_WORKING_DAYS, BENCH_SEED, false, numThreads, false)
+                     : createRandomNormals(numPaths, NUM_YEARLY_WORKING_DAYS, BENCH_SEED, false, numThreads, false);
+                });
+                const double normalsPerSecond = double (numPaths) * NUM_YEARLY_WORKING_DAYS / timing.wallSeconds;
+                const std::string generator = quasiRandom ? "sobol" : "philox";
+                std::cout << std::left << std::setw(8) << generator << std::right << std::setw(4) << numThreads << " threads"
+                          << std::setw(12) << std::fixed << std::setprecision(2) << normalsPerSecond / 1e6 << " M normals/s" << std::endl;
+                records.begin().field("workload", "rng").field("generator", generator).field("threads", numThreads)
+                 .field("paths", numPaths).field("steps", NUM_YEARLY_WORKING_DAYS).field("wallSeconds", timing.wallSeconds)
+                 .field("normalsPerSecond", normalsPerSecond);
+            }
+        }
+    }
+
+    // Pricing over pre-generated normals on the daily grid, so only the path walk and the estimators are timed
+    void benchmarkPathSteps(const BenchConfig& config, JsonRecords& records) {
+        outputHeader("Path stepping (daily grid, normals pre-generated)");
+        const OptionParams option { 100.0, 100.0, 1.0, 0.05, 0.2, OptionType::Call };
+        const int numPaths = config.quick ? 10000 : 100000;
+        SimulationSettings settings = createSettings(numPaths, 0);
+        settings.forceSteppedPaths = true;
+        const TimeGrid grid = createTimeGrid(option, settings);
+        const RandomNormals normals = createGridNormals(grid, settings);
+
+        for (int numThreads : getThreadCounts()) {
+            settings.numThreads = numThreads;
+            const Timing timing = timeBestOf([&]() {
+                runMonteCarloSimulation(option, grid, normals, false, "", settings);
+            });
+            const double pathStepsPerSecond = double (numPaths) * getNumGridSteps(grid) / timing.wallSeconds;
+            std::cout << std::setw(4) << numThreads << " threads" << std::setw(12) << std::fixed << std::setprecision(2)
+                      << pathStepsPerSecond / 1e6 << " M path-steps/s  (" << getKernelIsaName(detectKernelIsa()) << " kernel)" << std::endl;
+            records.begin().field("workload", "pathSteps").field("kernel", getKernelIsaName(detectKernelIsa()))
+             .field("threads", numThreads).field("paths", numPaths).field("steps", getNumGridSteps(grid))
+             .field("wallSeconds", timing.wallSeconds).field("pathStepsPerSecond", pathStepsPerSecond);
+        }
+    }
+
+    // Full pricing latency including normal generation, as a caller of runMonteCarloSimulation would see it
+    void benchmarkLatency(const BenchConfig& config, JsonRecords& records) {
+        outputHeader("Pricing latency (normals generated per run)");
+        const std::vector<double> maturities = config.quick ? std::vector<double> { 1.0 } : std::vector<double> { 0.25, 1.0, 5.0 };
+        const std::vector<int> pathCounts = config.quick ? std::vector<int> { 10000 } : std::vector<int> { 10000, 100000 };
+        std::cout << std::left << std::setw(10) << "grid" << std::right << std::setw(10) << "maturity" << std::setw(10) << "paths"
+                  << std::setw(9) << "threads" << std::setw(14) << "latency (ms)" << std::endl;
+
+        for (bool stepped : { false, true }) {
+            for (double maturity : maturities) {
+                const OptionParams option { 100.0, 100.0, maturity, 0.05, 0.2, OptionType::Call };
+                for (int numPaths : pathCounts) {
+                    for (int numThreads : getThreadCounts()) {
+                        SimulationSettings settings = createSettings(numPaths, numThreads);
+                        settings.forceSteppedPaths = stepped;
+                        settings.streamNormals = true;
+                        const Timing timing = timeBestOf([&]() {
+                            const TimeGrid grid = createTimeGrid(option, settings);
+                            runMonteCarloSimulation(option, grid, createGridNormals(grid, settings), false, "", settings);
+                        });
+                        const std::string gridName = stepped ? "stepped" : "terminal";
+                        std::cout << std::left << std::setw(10) << gridName << std::right << std::setw(10) << std::fixed
+                                  << std::setprecision(2) << maturity << std::setw(10) << numPaths << std::setw(9) << numThreads
+                                  << std::setw(14) << std::setprecision(3) << timing.wallSeconds * 1e3 << std::endl;
+                        records.begin().field("workload", "latency").field("grid", gridName).field("maturity", maturity)
+                         .field("paths", numPaths).field("threads", numThreads).field("wallSeconds", timing.wallSeconds)
+                         .field("cpuSeconds", timing.cpuSeconds);
+                    }
+                }
+            }
+        }
+    }
+
+    // Extra time taken by the five Greeks and their standard errors over pricing alone, on the same normals
+    void benchmarkGreeks(const BenchConfig& config, JsonRecords& records) {
+        outputHeader("Greeks cost (same normals, with and without Greeks)");
+        const int numPaths = config.quick ? 10000 : 100000;
+        for (bool stepped : { false, true }) {
+            const OptionParams option { 100.0, 100.0, 1.0, 0.05, 0.2, OptionType::Call };
+            SimulationSettings settings = createSettings(numPaths, 0);
+            settings.forceSteppedPaths = stepped;
+            const TimeGrid grid = createTimeGrid(option, settings);
+            const RandomNormals normals = createGridNormals(grid, settings);
+
+            for (int numThreads : getThreadCounts()) {
+                settings.numThreads = numThreads;
+                settings.computeGreeks = false;
+                const Timing priceTiming = timeBestOf([&]() {
+                    runMonteCarloSimulation(option, grid, normals, false, "", settings);
+                });
+                settings.computeGreeks = true;
+                const Timing greeksTiming = timeBestOf([&]() {
+                    runMonteCarloSimulation(option, grid, normals, false, "", settings);
+                });
+                const std::string gridName = stepped ? "stepped" : "terminal";
+                std::cout << std::left << std::setw(10) << gridName << std::right << std::setw(4) << numThreads << " threads"
+                          << std::fixed << std::setprecision(3) << std::setw(10) << priceTiming.wallSeconds * 1e3 << " ms price"
+                          << std::setw(10) << greeksTiming.wallSeconds * 1e3 << " ms price + Greeks"
+                          << std::setw(8) << std::setprecision(2) << greeksTiming.wallSeconds / priceTiming.wallSeconds << "x" << std::endl;
+                records.begin().field("workload", "greeks").field("grid", gridName).field("threads", numThreads)
+                 .field("paths", numPaths).field("priceSeconds", priceTiming.wallSeconds)
+                 .field("priceAndGreeksSeconds", greeksTiming.wallSeconds);
+            }
+        }
+    }
+
+    // Absolute error against Black-Scholes and the reported standard error as the CPU time spent grows
+    void benchmarkConvergence(const BenchConfig& config, JsonRecords& records) {
+        outputHeader("Convergence against Black-Scholes (terminal grid, all threads)");
+        const OptionParams option { 100.0, 100.0, 1.0, 0.05, 0.2, OptionType::Call };
+        const double referencePrice = calculateBlackScholesPrice(option);
+        const int maxPaths = config.quick ? 64000 : 4096000;
+        std::cout << "Black-Scholes price " << std::setprecision(6) << referencePrice << std::endl;
+        std::cout << std::left << std::setw(18) << "method" << std::right << std::setw(10) << "paths" << std::setw(14) << "abs error"
+                  << std::setw(14) << "std error" << std::setw(12) << "CPU (s)" << std::endl;
+
+        const std::vector<std::string> methods = { "crude", "antithetic", "control-variate", "qmc" };
+        for (const std::string& method : methods) {
+            for (int numPaths = 1000; numPaths <= maxPaths; numPaths *= 4) {
+                SimulationSettings settings = createSettings(numPaths, 0);
+                settings.varianceReduction.antithetic = method != "crude";
+                settings.varianceReduction.terminalPriceControl = method == "control-variate";
+                settings.quasiRandom = method == "qmc";
+                settings.computeGreeks = false;
+
+                OptionResult result {};
+                const Timing timing = timeBestOf([&]() {
+                    const TimeGrid grid = createTimeGrid(option, settings);
+                    result = runMonteCarloSimulation(option, grid, createGridNormals(grid, settings), false, "", settings);
+                });
+                const double absoluteError = std::abs(result.averagePayoff - referencePrice);
+                std::cout << std::left << std::setw(18) << method << std::right << std::setw(10) << numPaths << std::scientific
+                          << std::setprecision(3) << std::setw(14) << absoluteError << std::setw(14) << result.standardError
+                          << std::setw(12) << std::fixed << std::setprecision(4) << timing.cpuSeconds << std::endl;
+                records.begin().field("method", method).field("paths", numPaths).field("price", result.averagePayoff)
+                 .field("absoluteError", absoluteError).field("standardError", result.standardError)
+                 .field("cpuSeconds", timing.cpuSeconds).field("wallSeconds", timing.wallSeconds);
+            }
+        }
+    }
+
+    // A risk loop's ticks: each market move is priced afresh and through a warm repricing cache, against Black-Scholes
+    // Returns whether every cached price was within MAX_REPRICING_SHIFT standard errors of the fresh one
+    bool benchmarkRepricing(const BenchConfig& config, JsonRecords& records) {
+        outputHeader("Incremental repricing (terminal grid, all threads)");
+        const OptionParams baseOption { 100.0, 100.0, 1.0, 0.05, 0.2, OptionType::Call };
+        const SimulationSettings settings = createSettings(config.quick ? 10000 : 100000, 0);
+        std::cout << std::left << std::setw(14) << "move" << std::right << std::setw(14) << "fresh (ms)" << std::setw(14) << "cached (ms)"
+                  << std::setw(12) << "B-S price" << std::setw(12) << "fresh" << std::setw(12) << "cached" << std::setw(12) << "std error"
+                  << std::setw(12) << "shift (SE)" << std::endl;
+
+        struct MarketMove {
+            std::string name;
+            double spotPrice;
+            double volatility;
+            double riskFreeRate;
+        };
+        bool passed = true;
+        const std::vector<MarketMove> moves = {
+            { "spot +0.5%", 100.5, 0.2, 0.05 }, { "vol +0.5%", 100.0, 0.205, 0.05 },
+            { "rate +0.25%", 100.0, 0.2, 0.0525 }, { "all three", 100.5, 0.205, 0.0525 }
+        };
+        for (const MarketMove& move : moves) {
+            OptionParams option = baseOption;
+            option.spotPrice = move.spotPrice;
+            option.volatility = move.volatility;
+            option.riskFreeRate = move.riskFreeRate;
+
+            OptionResult freshResult {};
+            const Timing freshTiming = timeBestOf([&]() {
+                const TimeGrid grid = createTimeGrid(option, settings);
+                freshResult = runMonteCarloSimulation(option, grid, createGridNormals(grid, settings), false, "", settings);
+            });
+            // A fresh cache per repeat, warmed at the base market, so that only the move itself is timed and never hits
+            OptionResult cachedResult {};
+            double cachedSeconds = 1e300;
+            for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+                RepricingCache cache;
+                repriceOption(cache, baseOption, settings);
+                const auto start = std::chrono::steady_clock::now();
+                cachedResult = repriceOption(cache, option, settings);
+                cachedSeconds = std::min(cachedSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            const double referencePrice = calculateBlackScholesPrice(option);
+            const double shift = std::abs(cachedResult.averagePayoff - freshResult.averagePayoff) / cachedResult.standardError;
+            passed = passed && shift <= MAX_REPRICING_SHIFT;
+            std::cout << std::left << std::setw(14) << move.name << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(14) << freshTiming.wallSeconds * 1e3 << std::setw(14) << cachedSeconds * 1e3 << std::setprecision(4)
+                      << std::setw(12) << referencePrice << std::setw(12) << freshResult.averagePayoff << std::setw(12)
+                      << cachedResult.averagePayoff << std::setw(12) << cachedResult.standardError << std::setprecision(2)
+                      << std::setw(12) << shift << (shift <= MAX_REPRICING_SHIFT ? "" : "  FAILED") << std::endl;
+            records.begin().field("workload", "repricing").field("move", move.name).field("paths", settings.numSimulations)
+             .field("freshSeconds", freshTiming.wallSeconds).field("cachedSeconds", cachedSeconds)
+             .field("referencePrice", referencePrice).field("freshPrice", freshResult.averagePayoff)
+             .field("cachedPrice", cachedResult.averagePayoff).field("cachedStandardError", cachedResult.standardError)
+             .field("shift", shift);
+        }
+        return passed;
+    }
+
+    // Validation of single precision: the same paths priced with double and with float normals and kernels, and how far
+    // the price, delta and vega moved in units of their standard errors. Returns whether every shift was within
+    // MAX_PRECISION_SHIFT.
+    bool benchmarkPrecision(const BenchConfig& config, JsonRecords& records) {
+        outputHeader("Single against double precision (stepped grid, same normals)");
+        const std::vector<double> maturities = config.quick ? std::vector<double> { 1.0 } : std::vector<double> { 0.25, 1.0, 2.0 };
+        const std::vector<OptionParams> options = { { 100.0, 100.0, 1.0, 0.05, 0.2, OptionType::Call }, { 100.0, 80.0, 1.0, 0.05, 0.2, OptionType::Put } };
+        std::cout << std::left << std::setw(12) << "option" << std::right << std::setw(10) << "maturity" << std::setw(13) << "double (ms)"
+                  << std::setw(13) << "single (ms)" << std::setw(12) << "price" << std::setw(13) << "difference" << std::setw(12)
+                  << "std error" << std::setw(15) << "max shift (SE)" << std::endl;
+
+        bool passed = true;
+        for (OptionParams option : options) {
+            for (double maturity : maturities) {
+                option.timeToMaturity = maturity;
+                OptionResult results[2];
+                Timing timings[2];
+                for (int precision = 0; precision < 2; precision++) {
+                    SimulationSettings settings = createSettings(config.quick ? 20000 : 100000, 0);
+                    settings.forceSteppedPaths = true;
+                    settings.singlePrecision = precision == 1;
+                    timings[precision] = timeBestOf([&]() {
+                        const TimeGrid grid = createTimeGrid(option, settings);
+                        results[precision] = runMonteCarloSimulation(option, grid, createGridNormals(grid, settings), false, "", settings);
+                    });
+                }
+
+                auto calculateShift = [](double estimate, double singleEstimate, double standardError) {
+                    return standardError > 0.0 ? std::abs(singleEstimate - estimate) / standardError : 0.0;
+                };
+                const double maxShift = std::max({ calculateShift(results[0].averagePayoff, results[1].averagePayoff, results[0].standardError),
+                 calculateShift(results[0].greeks.delta, results[1].greeks.delta, results[0].greekStandardErrors.delta),
+                 calculateShift(results[0].greeks.vega, results[1].greeks.vega, results[0].greekStandardErrors.vega) });
+                passed = passed && maxShift <= MAX_PRECISION_SHIFT;
+
+                const std::string optionName = std::string(option.optionType == OptionType::Call ? "call" : "put") + " K=" + std::to_string(int (option.strikePrice));
+                std::cout << std::left << std::setw(12) << optionName << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+                          << maturity << std::setprecision(3) << std::setw(13) << timings[0].wallSeconds * 1e3 << std::setw(13)
+                          << timings[1].wallSeconds * 1e3 << std::setprecision(5) << std::setw(12) << results[0].averagePayoff
+                          << std::scientific << std::setprecision(2) << std::setw(13) << results[1].averagePayoff - results[0].averagePayoff
+                          << std::setw(12) << results[0].standardError << std::setw(15) << maxShift
+                          << (maxShift <= MAX_PRECISION_SHIFT ? "" : "  FAILED") << std::endl;
+                records.begin().field("workload", "precision").field("option", optionName).field("maturity", maturity)
+                 .field("doubleSeconds", timings[0].wallSeconds).field("singleSeconds", timings[1].wallSeconds)
+                 .field("doublePrice", results[0].averagePayoff).field("singlePrice", results[1].averagePayoff)
+                 .field("standardError", results[0].standardError).field("maxShift", maxShift);
+            }
+        }
+        return passed;
+    }
+
+    void writeJson(const std::string& path, const JsonRecords& benchmarks, const JsonRecords& convergence) {
+        std::ofstream file(path);
+        if (!file) {
+            throw std::runtime_error("could not open " + path + " for writing");
+        }
+        file << "{\n"
+             << "  \"machine\": {\"hardwareThreads\": " << resolveThreadCount(0)
+             << ", \"kernel\": \"" << getKernelIsaName(detectKernelIsa()) << "\"},\n"
+             << "  \"benchmarks\": " << benchmarks.toString("  ") << ",\n"
+             << "  \"convergence\": " << convergence.toString("  ") << "\n"
+             << "}\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp("--quick", argv[i]) == 0) {
+            config.quick = true;
+        }
+        else if (strcmp("--json", argv[i]) == 0 && i + 1 < argc) {
+            config.jsonPath = argv[++i];
+        }
+        else {
+            std::cerr << "\033[31mERROR: Usage: MonteCarloBench [--quick] [--json outputFile]\033[0m";
+            return EXIT_FAILURE;
+        }
+    }
+
+    try {
+        JsonRecords benchmarks;
+        JsonRecords convergence;
+        benchmarkRandomNumbers(config, benchmarks);
+        benchmarkPathSteps(config, benchmarks);
+        benchmarkLatency(config, benchmarks);
+        benchmarkGreeks(config, benchmarks);
+        const bool repricingPassed = benchmarkRepricing(config, benchmarks);
+        const bool precisionPassed = benchmarkPrecision(config, benchmarks);
+        benchmarkConvergence(config, convergence);
+
+        if (!config.jsonPath.empty()) {
+            writeJson(config.jsonPath, benchmarks, convergence);
+            std::cout << std::endl << "Results written to " << config.jsonPath << std::endl;
+        }
+        if (!repricingPassed) {
+            std::cerr << "\033[31mERROR: A cached price was more than " << MAX_REPRICING_SHIFT << " standard errors from a fresh simulation.\033[0m";
+            return EXIT_FAILURE;
+        }
+        if (!precisionPassed) {
+            std::cerr << "\033[31mERROR: Single precision moved an estimate by more than " << MAX_PRECISION_SHIFT << " standard errors.\033[0m";
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << "\033[0m";
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "MonteCarlo.h"
+
+// Compares the original price-space simulatePath loop against each log-space batch kernel the CPU supports, in double
+// and in single precision, stepping the same paths from the same normals.
+namespace {
+    constexpr int NUM_BENCH_PATHS = 16384;
+    constexpr int NUM_BENCH_STEPS = NUM_YEARLY_WORKING_DAYS;
+    constexpr int NUM_REPEATS = 5;
+
+    template <typename Function>
+    double timeBestOf(Function function) {
+        double bestSeconds = 1e300;
+        for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            bestSeconds = std::min(bestSeconds, elapsed.count());
+        }
+        return bestSeconds;
+    }
+
+    void outputTiming(const std::string& name, double seconds, double baselineSeconds, double maxRelativeError) {
+        const double nanosecondsPerStep = seconds * 1e9 / (double (NUM_BENCH_PATHS) * NUM_BENCH_STEPS);
+        std::cout << std::left << std::setw(16) << name << std::right << std::fixed
+                  << std::setw(10) << std::setprecision(3) << seconds * 1e3 << " ms"
+                  << std::setw(10) << std::setprecision(3) << nanosecondsPerStep << " ns/path-step"
+                  << std::setw(9) << std::setprecision(2) << baselineSeconds / seconds << "x"
+                  << std::setw(14) << std::scientific << std::setprecision(2) << maxRelativeError << std::endl;
+    }
+}
+
+int main() {
+    const OptionParams option { 100.0, 100.0, 1.0, 0.05, 0.2, OptionType::Call };
+    const PathConstants constants = calculatePathConstants(option, DT);
+    const std::vector<std::vector<double>> randomNormals = generateRandomNormals(NUM_BENCH_PATHS, NUM_BENCH_STEPS, 42, 0);
+
+    // Pre-arrange the kernels' structure-of-arrays input so only the stepping is timed
+    const int numBatches = NUM_BENCH_PATHS / PATH_BATCH_SIZE;
+    std::vector<double> referencePrices(NUM_BENCH_PATHS);
+    std::vector<double> batchNormals(std::size_t (NUM_BENCH_PATHS) * NUM_BENCH_STEPS);
+    std::vector<float> singleBatchNormals(batchNormals.size());
+    for (int i = 0; i < NUM_BENCH_PATHS; i++) {
+        const std::size_t batchOffset = std::size_t (i / PATH_BATCH_SIZE) * NUM_BENCH_STEPS * PATH_BATCH_SIZE;
+        for (int j = 0; j < NUM_BENCH_STEPS; j++) {
+            batchNormals[batchOffset + j * PATH_BATCH_SIZE + i % PATH_BATCH_SIZE] = randomNormals[i][j];
+            singleBatchNormals[batchOffset + j * PATH_BATCH_SIZE + i % PATH_BATCH_SIZE] = float (randomNormals[i][j]);
+        }
+    }
+    const SinglePathConstants singleConstants = { float (constants.drift), float (constants.diffusion) };
+
+    auto calculateMaxRelativeError = [&](const std::vector<double>& finalPrices) {
+        double maxRelativeError = 0.0;
+        for (int i = 0; i < NUM_BENCH_PATHS; i++) {
+            maxRelativeError = std::max(maxRelativeError, std::abs(finalPrices[i] - referencePrices[i]) / referencePrices[i]);
+        }
+        return maxRelativeError;
+    };
+
+    const double baselineSeconds = timeBestOf([&]() {
+        for (int i = 0; i < NUM_BENCH_PATHS; i++) {
+            referencePrices[i] = std::get<0>(simulatePath(option, randomNormals[i].data(), NUM_BENCH_STEPS, DT, nullptr));
+        }
+    });
+
+    std::cout << NUM_BENCH_PATHS << " paths x " << NUM_BENCH_STEPS << " steps, best of " << NUM_REPEATS << " runs" << std::endl;
+    std::cout << std::left << std::setw(16) << "kernel" << std::right << std::setw(13) << "time" << std::setw(23) << "per step"
+              << std::setw(10) << "speedup" << std::setw(14) << "max rel err" << std::endl;
+    outputTiming("simulatePath", baselineSeconds, baselineSeconds, 0.0);
+
+    for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::Avx2, KernelIsa::Avx512 }) {
+        if (!isKernelIsaSupported(isa)) {
+            std::cout << std::left << std::setw(16) << getKernelIsaName(isa) << "not supported by this CPU" << std::endl;
+            continue;
+        }
+        const LogPathKernel advanceLogPaths = getLogPathKernel(isa);
+        std::vector<double> finalPrices(NUM_BENCH_PATHS);
+        const double seconds = timeBestOf([&]() {
+            for (int batch = 0; batch < numBatches; batch++) {
+                double logPrices[PATH_BATCH_SIZE];
+                double antiLogPrices[PATH_BATCH_SIZE];
+                std::fill_n(logPrices, PATH_BATCH_SIZE, std::log(option.spotPrice));
+                std::fill_n(antiLogPrices, PATH_BATCH_SIZE, std::log(option.spotPrice));
+                advanceLogPaths(batchNormals.data() + std::size_t (batch) * NUM_BENCH_STEPS * PATH_BATCH_SIZE, NUM_BENCH_STEPS, constants, logPrices, antiLogPrices);
+                for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                    finalPrices[batch * PATH_BATCH_SIZE + lane] = std::exp(logPrices[lane]);
+                }
+            }
+        });
+
+        outputTiming(getKernelIsaName(isa), seconds, baselineSeconds, calculateMaxRelativeError(finalPrices));
+    }
+
+    // Single-precision kernels step float log returns, which are added to the double log spot price at the end
+    for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::Avx2 }) {
+        if (!isKernelIsaSupported(isa)) {
+            continue;
+        }
+        const SingleLogPathKernel advanceLogReturns = getSingleLogPathKernel(isa);
+        std::vector<double> finalPrices(NUM_BENCH_PATHS);
+        const double seconds = timeBestOf([&]() {
+            for (int batch = 0; batch < numBatches; batch++) {
+                float logReturns[PATH_BATCH_SIZE] = {};
+                float antiLogReturns[PATH_BATCH_SIZE] = {};
+                advanceLogReturns(singleBatchNormals.data() + std::size_t (batch) * NUM_BENCH_STEPS * PATH_BATCH_SIZE, NUM_BENCH_STEPS, singleConstants, logReturns, antiLogReturns);
+                for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                    finalPrices[batch * PATH_BATCH_SIZE + lane] = option.spotPrice * std::exp(double (logReturns[lane]));
+                }
+            }
+        });
+        outputTiming(std::string(getKernelIsaName(isa)) + " float", seconds, baselineSeconds, calculateMaxRelativeError(finalPrices));
+    }
+
+    return 0;
+}
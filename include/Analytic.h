@@ -0,0 +1,12 @@
+#pragma once
+
+#include "OptionTypes.h"
+
+double normalCdf(double x);
+
+// Closed-form Black-Scholes price of a European call or put
+double calculateBlackScholesPrice(const OptionParams& params);
+
+// Closed-form price of a call or put on the geometric average of the prices at stepDt, 2 stepDt, ..., numSteps stepDt,
+// which is lognormal under GBM
+double calculateGeometricAsianPrice(const OptionParams& params, int numSteps, double stepDt);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "OptionTypes.h"
+#include "Random.h"
+
+// Reads one option per line as spotPrice,strikePrice,timeToMaturity,riskFreeRate,volatility,optionType, using the same
+// units as the command line (rates and volatilities as percentages). A header line and blank lines are skipped.
+std::vector<OptionParams> readPortfolioFile(const std::filesystem::path& inputPath);
+
+// Stored normals are kept in a cache up to this size; when a new grid would overflow it, the cache starts again empty
+constexpr std::size_t NORMALS_CACHE_BYTES = std::size_t (256) << 20;
+
+// Normals kept between calls to priceBatch, keyed by step counts, so that a long-running process draws each grid's
+// normals once. A cache must always be used with the same simulation settings, and from one thread at a time.
+struct NormalsCache {
+    std::map<std::pair<int, int>, std::shared_ptr<const RandomNormals>> entries;
+    std::size_t bytes = 0;
+};
+
+// Checks one portfolio row and converts it to an option; location names the row in error messages
+OptionParams parsePortfolioRow(const std::vector<std::string>& fields, const std::string& location);
+
+// Prices every option in one process. Options with the same step count share a single set of random normals, and the
+// options within each group are priced concurrently. With a cache, the normals are reused across calls.
+std::vector<OptionResult> priceBatch(const std::vector<OptionParams>& options, const SimulationSettings& settings, NormalsCache* normalsCache = nullptr);
+
+// The columns written for each priced option
+constexpr const char* BATCH_RESULT_HEADER = "spotPrice,strikePrice,timeToMaturity,riskFreeRate,volatility,optionType,payoffStyle,"
+ "barrierType,barrierLevel,optionValue,standardError,lowerBound,upperBound,delta,gamma,vega,rho,theta,deltaStandardError,"
+ "gammaStandardError,vegaStandardError,rhoStandardError,thetaStandardError,varianceReductionFactor,numPaths,elapsedSeconds";
+
+void writeBatchResultRow(std::ostream& output, const OptionParams& option, const OptionResult& result);
+
+void writeBatchResults(const std::filesystem::path& outputPath, const std::vector<OptionParams>& options, const std::vector<OptionResult>& results);
+
+int runBatchPricing(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, const SimulationSettings& settings);
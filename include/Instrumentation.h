@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "OptionTypes.h"
+
+struct PhaseClock {
+    std::chrono::steady_clock::time_point wallStart;
+    std::clock_t cpuStart;
+};
+
+PhaseClock startPhaseClock();
+
+// Records the wall and CPU time since the clock was started
+void stopPhaseClock(const PhaseClock& clock, PhaseStatistics& statistics);
+
+// Adds statistics to the phase of the same name, appending the phase the first time it is seen
+void addPhaseStatistics(std::vector<PhaseStatistics>& phases, const PhaseStatistics& statistics);
+
+// Writes the result's headline numbers and phase statistics as one JSON object
+void writeRunStatisticsJson(const std::filesystem::path& outputPath, const OptionResult& result);
+
+// Writes the "phases" member of a statistics JSON object, with no trailing comma
+void writePhaseStatisticsJson(std::ostream& output, const std::vector<PhaseStatistics>& phases);
+
+// Prints how much of a job is done under logText from its own thread, sampling a counter the workers bump, so that
+// progress reporting never writes to the console from the simulation loop. Nothing is printed if logText is empty.
+class ProgressReporter {
+public:
+    ProgressReporter(std::string logText, long long totalWork);
+    ~ProgressReporter();
+
+    void addCompletedWork(long long work) {
+        completedWork.fetch_add(work, std::memory_order_relaxed);
+    }
+
+    // Stops sampling and prints the final 100%
+    void finish();
+
+private:
+    std::string logText;
+    long long totalWork;
+    std::atomic<long long> completedWork { 0 };
+    std::mutex mutex;
+    std::condition_variable stopped;
+    bool finished = false;
+    std::thread samplingThread;
+
+    void sampleProgress();
+};
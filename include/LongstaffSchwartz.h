@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "OptionTypes.h"
+
+// Paths whose regression sums are added up together. Blocks are summed in a fixed order, so the fitted exercise
+// policy does not depend on how many threads produced them.
+constexpr int LSM_REGRESSION_BLOCK_SIZE = 4096;
+constexpr int MAX_BASIS_DEGREE = 8;
+
+// The pricing pass draws its paths from Philox streams this far past the regression's, so the two sets are independent
+constexpr std::uint64_t LSM_PRICING_PATH_OFFSET = std::uint64_t (1) << 32;
+
+// Exercise dates k T / numDates for k = 1, ..., numDates, the last being maturity. American options use every working
+// day, so they are priced as Bermudan options with daily exercise.
+std::vector<double> createExerciseDates(const OptionParams& params, const EarlyExercise& earlyExercise);
+
+int getNumBasisFunctions(const EarlyExercise& earlyExercise);
+
+// Writes the basis functions at x = price / strike: 1, x, ..., x^degree for monomials, or 1 and the weighted Laguerre
+// polynomials exp(-x / 2) L_n(x) for n < degree, as Longstaff and Schwartz (2001) used
+void evaluateBasis(const EarlyExercise& earlyExercise, double scaledPrice, double* values);
+
+// The fitted continuation value at every exercise date before maturity. A date with fewer in-the-money paths than
+// basis functions cannot be fitted, and the option is simply held there.
+struct ExercisePolicy {
+    std::vector<double> dates;
+    int numBasisFunctions;
+    std::vector<double> coefficients; // numBasisFunctions per date
+    std::vector<char> isFitted;
+};
+
+// Fits the policy by regressing, at each date from the last back to the first, the discounted cash flows of the
+// in-the-money paths on the basis. Paths are built backwards from their terminal values with a Brownian bridge, so
+// only the current date's Brownian motion and each path's cash flow are stored: 16 bytes a path, whatever the number
+// of dates.
+ExercisePolicy estimateExercisePolicy(const OptionParams& params, const SimulationSettings& settings, PhaseStatistics& phase);
+
+// Prices an American or Bermudan call or put under GBM: the policy is fitted on one set of paths and then followed on
+// a second, independent set, which makes the price a low-biased estimate with an honest standard error. The Greeks
+// hold the fitted policy fixed, which by the envelope theorem changes the value by only second-order amounts.
+OptionResult runLongstaffSchwartzSimulation(const OptionParams& params, const SimulationSettings& settings, std::string logText);
+
+// Throws std::runtime_error if early exercise is combined with something the Longstaff-Schwartz engine does not
+// support (other models and rate curves, quasi-random normals, control variates, importance sampling, adaptive runs)
+void validateEarlyExercise(const SimulationSettings& settings);
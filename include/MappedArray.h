@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+// A little-endian float64 array in C order, stored as a .npy file that is mapped straight into memory. The simulation
+// writes its values in place, with no formatting, and numpy can map the same file back with np.load(mmap_mode="r").
+// The header is padded so the data starts 64 bytes in, keeping it aligned. Writes reach the file once the array is
+// destroyed, and the file is always the full size, so values that are never written read back as zero.
+class MappedArray {
+public:
+    // Creates or truncates the file at path with the given shape, or throws std::runtime_error
+    MappedArray(const std::filesystem::path& path, const std::vector<std::size_t>& shape);
+    ~MappedArray();
+    MappedArray(const MappedArray&) = delete;
+    MappedArray& operator=(const MappedArray&) = delete;
+
+    double* data() const;
+    std::size_t size() const;
+
+private:
+    void* mapping;
+    std::size_t mappedBytes;
+    std::size_t headerBytes;
+    std::size_t numValues;
+    #ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+    #endif
+};
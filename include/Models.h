@@ -0,0 +1,57 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include "MonteCarlo.h"
+#include "OptionTypes.h"
+
+// Greeks under the model backends are finite differences against paths that share every normal with the base run
+constexpr double MODEL_SPOT_PRICE_JUMP_FRACTION = 0.01;
+constexpr double MODEL_VOLATILITY_JUMP = 0.01;
+constexpr double MODEL_RISK_FREE_RATE_JUMP = 0.001;
+
+// Nodes per time of the local volatility grid, evenly spaced in log spot price between the table's first and last
+constexpr int LOCAL_VOLATILITY_GRID_POINTS = 256;
+
+// Andersen's (2008) switching level between the QE scheme's quadratic and exponential variance draws
+constexpr double QE_SWITCHING_THRESHOLD = 1.5;
+
+// Whether the settings need the model engine rather than the flat GBM kernels
+inline bool usesModelEngine(const SimulationSettings& settings) {
+    return settings.model.type != ModelType::BlackScholes || !settings.model.rateCurve.times.empty();
+}
+
+// Integral of the short rate from 0 to time, so that exp(-R) is the discount factor; flatRate applies without a curve
+double calculateIntegratedRate(const RateCurve& rateCurve, double flatRate, double time);
+
+// The local volatility table resampled once per simulated step: row k holds sigma(k stepDt, S) at evenly spaced log
+// spot prices, so a path step finds its volatility with one multiply and one linear interpolation, without searching.
+// volatilityShift moves the whole surface, for vega.
+struct LocalVolatilityGrid {
+    double firstLogPrice;
+    double inverseSpacing;
+    std::vector<double> volatilities; // (numSteps + 1) rows of LOCAL_VOLATILITY_GRID_POINTS
+};
+
+std::shared_ptr<const LocalVolatilityGrid> createLocalVolatilityGrid(const LocalVolatilityTable& table, int numSteps, double stepDt);
+
+// Each step of the model engine covers at most daysPerStep working days and ends exactly at maturity
+TimeGrid createModelTimeGrid(const OptionParams& params, int daysPerStep);
+
+// Throws std::runtime_error if a model's parameters are out of range, or if the settings ask the model engine for
+// something only the flat GBM kernels support (quasi-random normals, control variates, importance sampling and
+// adaptive path counts)
+void validateModelSettings(const SimulationSettings& settings);
+
+// Prices under settings.model with settings.numSimulations paths, each averaged with its antithetic twin unless that
+// is switched off. Every model is a small struct with its own per-path state that the path kernel is instantiated
+// on, so each one compiles to a specialised loop, and GBM with a flat rate never comes here at all.
+OptionResult runModelSimulation(const OptionParams& params, const SimulationSettings& settings, std::string logText);
+
+// Reads a header row of spot prices (after one leading label) and then one row per time: time followed by the local
+// volatility at each spot price, as a percentage
+LocalVolatilityTable readLocalVolatilityFile(const std::filesystem::path& inputPath);
+
+// Reads time,zeroRate rows, with the zero rates as percentages
+RateCurve readRateCurveFile(const std::filesystem::path& inputPath);
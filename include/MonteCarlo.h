@@ -1,39 +1,127 @@
 #pragma once
 
 #include <filesystem>
+#include <string>
+#include <tuple>
 #include <vector>
 #include "OptionTypes.h"
+#include "PathKernels.h"
+#include "Random.h"
+#include "Statistics.h"
+#include "VarianceReduction.h"
 
-constexpr int NUM_SIMULATIONS = 100000;
-constexpr int NUM_GRAPHED_PATHS = 100;
 constexpr int NUM_YEARLY_WORKING_DAYS = 252;
 constexpr int NUM_YEARLY_DAYS = 365;
 constexpr double DT = 1.0 / NUM_YEARLY_WORKING_DAYS;
-constexpr double VOLATILITY_JUMP = 0.01;
-constexpr double RISK_FREE_RATE_JUMP = 0.001;
 constexpr double TIME_TO_MATURITY_JUMP = 1.0 / 365;
+constexpr int ADAPTIVE_CHUNK_SIZE = 16384;
 constexpr double CONFIDENCE_BOUND_FACTOR = 1.95996;
 
-std::vector<std::vector<double>> generateRandomNormals(int numSimulations, int numSteps);
-
-std::tuple<double, double> simulatePath(const OptionParams& params, const std::vector<double>& randomNormals, std::string& graphData, bool graphPath);
+// Final prices of a path and its antithetic twin. When pathPrices is not null, the path's numSteps + 1 prices, starting
+// with the spot price, are written to it.
+std::tuple<double, double> simulatePath(const OptionParams& params, const double* randomNormals, int numSteps, double dt, double* pathPrices);
 
 double calculatePayoff(const OptionParams& params, std::tuple<double, double> simulatedPrices);
 
-std::vector<double> simulatePayoffs(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, bool graphPaths, std::string logText);
+// Undiscounted call or put payoff on a single price
+double calculateVanillaPayoff(const OptionParams& params, double price);
 
-double calculateStandardError(const std::vector<double>& payoffs, double averagePayoff);
+// Discounted payoff of a single final price, without the antithetic average
+double calculateDiscountedPayoff(const OptionParams& params, double finalPrice);
 
-std::tuple<double,double> calculateConfidenceInterval(double averagePayoff, double standardError);
+// Derivative of the undiscounted payoff with respect to the final price
+double calculatePayoffSlope(const OptionParams& params, double finalPrice);
+
+int calculateNumSteps(const OptionParams& params);
+
+std::vector<double> simulatePayoffs(const OptionParams& params, const RandomNormals& randomNormals, bool graphPaths, std::string logText, int numThreads);
+
+// The steps walked by the fused pricing pass: numSteps steps of stepDt to maturity, then numExtensionSteps steps of
+// extensionDt on to the theta-bumped maturity. Path-independent payoffs use the exact terminal grid, a single step
+// straight to maturity, since a GBM terminal price can be sampled exactly from one normal. Path-dependent ones step
+// daily, except barriers, which may take settings.barrierStepDays days per step.
+struct TimeGrid {
+    int numSteps;
+    double stepDt;
+    int numExtensionSteps;
+    double extensionDt;
+    bool isTerminal;
+};
+
+// Covers the same working days as the daily grid in steps of up to daysPerStep days
+TimeGrid createSteppedTimeGrid(const OptionParams& params, int daysPerStep);
+
+TimeGrid createTerminalTimeGrid(const OptionParams& params);
+
+TimeGrid createTimeGrid(const OptionParams& params, const SimulationSettings& settings);
+
+int getNumGridSteps(const TimeGrid& grid);
+
+// Pseudorandom or quasi-random normals for every step of the grid, as chosen by the settings
+RandomNormals createGridNormals(const TimeGrid& grid, const SimulationSettings& settings);
 
-std::tuple<double, double> calculateDeltaAndGamma(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice);
+// Per-path samples of the discounted payoff and of every Greek estimator, produced by a single walk over each path.
+// Delta, vega and rho are pathwise derivatives of the payoff; gamma applies the likelihood ratio method to the pathwise
+// delta, so it stays smooth even though the payoff's slope jumps at the strike. Only the first step's normal depends
+// on the spot price once the rest of the path is fixed, so path-dependent payoffs take their likelihood ratio from it,
+// while terminal payoffs use the whole path. Theta is a finite difference against the same path continued for
+// TIME_TO_MATURITY_JUMP more, which for path-dependent payoffs adds one last observation.
+struct FusedPayoffSamples {
+    std::vector<double> base;
+    std::vector<double> delta;
+    std::vector<double> gamma;
+    std::vector<double> vega;
+    std::vector<double> rho;
+    std::vector<double> theta;
+    std::vector<double> crude; // One plain leg per path, as the baseline for the variance reduction factor
+    std::vector<double> terminalPriceControl; // Only filled when the matching control variate is enabled
+    std::vector<double> blackScholesControl;
+    std::vector<double> geometricAsianControl;
+    PhaseStatistics phase;
+};
 
-double calculateVega(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice);
+PathConstants calculatePathConstants(const OptionParams& params, double dt);
 
-double calculateRho(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice);
+FusedPayoffSamples simulateFusedPayoffs(const OptionParams& params, const TimeGrid& grid, const RandomNormals& randomNormals, bool graphPaths, std::string logText, const SimulationSettings& settings);
+
+// Control variates enabled by the samples, with their expectations over the simulated time grid
+std::vector<ControlVariate> createControlVariates(const OptionParams& params, const TimeGrid& grid, const FusedPayoffSamples& samples);
+
+// Running statistics of every estimator a pricing run reports, which chunks of paths can be folded into one at a time
+struct PricingStatistics {
+    RunningStatistics payoff;
+    RunningStatistics crude;
+    RunningStatistics delta;
+    RunningStatistics gamma;
+    RunningStatistics vega;
+    RunningStatistics rho;
+    RunningStatistics theta;
+};
+
+// Folds a chunk of per-path samples into statistics. Pseudorandom paths are independent and enter one by one;
+// quasi-random paths are only independent across replicates, so each replicate enters as its mean.
+void accumulateSamples(RunningStatistics& statistics, const std::vector<double>& samples, const RandomNormals& randomNormals);
+
+// payoffSamples replaces samples.base, so the price can carry control variate adjustments that the Greeks do not
+void accumulatePricingStatistics(PricingStatistics& statistics, const FusedPayoffSamples& samples, const std::vector<double>& payoffSamples, const RandomNormals& randomNormals);
+
+// Combines two sets of statistics as if their paths had been accumulated into one
+void mergePricingStatistics(PricingStatistics& statistics, const PricingStatistics& other);
+
+OptionResult createOptionResult(const PricingStatistics& statistics, int numPaths, double elapsedSeconds);
+
+double calculateStandardError(const std::vector<double>& payoffs);
+
+std::tuple<double,double> calculateConfidenceInterval(double averagePayoff, double standardError);
 
-double calculateTheta(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice);
+OptionResult runMonteCarloSimulation(const OptionParams& params, const TimeGrid& grid, const RandomNormals& randomNormals, bool graphPaths, std::string logText, const SimulationSettings& settings);
 
-Greeks calculateGreeks(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice);
+// Prices in chunks of ADAPTIVE_CHUNK_SIZE streamed paths until settings.targetStandardError is met, the time budget runs
+// out or settings.maxSimulations paths have been used. Control variate coefficients come from the first (pilot) chunk.
+// With quasi-random normals each chunk is one scrambled replicate, and the standard error comes from the chunk means,
+// so the tolerance cannot stop the run before NUM_QMC_REPLICATES chunks.
+OptionResult runAdaptiveMonteCarloSimulation(const OptionParams& params, const TimeGrid& grid, bool graphPaths, std::string logText, const SimulationSettings& settings);
 
-OptionResult runMonteCarloSimulation(const OptionParams& params);
\ No newline at end of file
+// Runs under the model engine when the settings choose another model or a rate curve, otherwise adaptively when the
+// settings ask for it, and otherwise with settings.numSimulations paths
+OptionResult runMonteCarloSimulation(const OptionParams& params, const SimulationSettings& settings);
\ No newline at end of file
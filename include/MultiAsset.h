@@ -0,0 +1,72 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "OptionTypes.h"
+
+// Paths simulated together by the multi-asset engine. Every asset's row of the batch is reused against each row of the
+// correlation factor, so the batch is wider than a single-asset one while staying within L1 for tens of assets.
+constexpr int MULTI_ASSET_BATCH_SIZE = 16;
+constexpr int MAX_CACHED_CORRELATION_FACTORS = 64;
+
+enum class MultiAssetPayoff { Basket, BestOf, WorstOf };
+
+// A call or put on several correlated GBM underlyings. Baskets pay on the weighted sum of the terminal prices, so a
+// spread is a two-asset basket with weights 1 and -1; best-of and worst-of options pay on the highest or lowest one.
+struct MultiAssetParams {
+    std::vector<double> spotPrices;
+    std::vector<double> volatilities;
+    std::vector<double> weights; // Only read by baskets
+    std::vector<double> correlations; // numAssets x numAssets, row-major
+    double strikePrice;
+    double timeToMaturity; // Measured in years
+    double riskFreeRate;
+    OptionType optionType;
+    MultiAssetPayoff payoff;
+};
+
+// Price and per-asset pathwise deltas and vegas, each with its standard error
+struct MultiAssetResult {
+    double averagePayoff;
+    double standardError;
+    std::tuple<double, double> confidenceInterval;
+    std::vector<double> deltas;
+    std::vector<double> deltaStandardErrors;
+    std::vector<double> vegas;
+    std::vector<double> vegaStandardErrors;
+    double varianceReductionFactor;
+    int numPaths;
+    double elapsedSeconds;
+};
+
+// Lower-triangular Cholesky factor L of a correlation matrix (L L^T = C), row-major with the upper triangle zeroed
+struct CorrelationFactor {
+    int numAssets;
+    std::vector<double> lower;
+};
+
+// Factorises a correlation matrix, or returns the factor cached the last time the same matrix was seen, so repricing
+// a book on one set of correlations factorises it once. Throws std::runtime_error unless the matrix is symmetric with a
+// unit diagonal and positive semidefinite; perfectly correlated assets simply share a factor.
+std::shared_ptr<const CorrelationFactor> getCorrelationFactor(const std::vector<double>& correlations, int numAssets);
+
+// Correlates a batch of independent normals, stored as one row of MULTI_ASSET_BATCH_SIZE lanes per asset, into
+// increments[asset row] = sum over j <= asset of L[asset][j] * normals[row j]
+void correlateNormals(const CorrelationFactor& factor, const double* normals, double* increments);
+
+// Prices with settings.numSimulations antithetic pairs, stepping daily only when settings.forceSteppedPaths is set, as
+// the terminal prices can be sampled exactly. Only the per-path estimates are stored, so memory grows with assets x
+// paths and never with the number of steps. Path i draws its normals from its own Philox stream, step by step and asset
+// by asset, so results do not depend on the thread count. Throws std::runtime_error for settings the engine does not
+// honour, which is everything but the thread count, seed, path count, --stream, --stepped and --no-antithetic.
+MultiAssetResult runMultiAssetSimulation(const MultiAssetParams& params, const SimulationSettings& settings, std::string logText);
+
+// Reads strikePrice,timeToMaturity,riskFreeRate,optionType,payoff on the first line and then one line per asset:
+// spotPrice,volatility,weight followed by that asset's row of the correlation matrix. Rates and volatilities are
+// percentages, as on the command line; lines that do not start with a number are skipped as headers.
+MultiAssetParams readMultiAssetFile(const std::filesystem::path& inputPath);
+
+int runMultiAssetPricing(const std::filesystem::path& inputPath, const SimulationSettings& settings);
@@ -1,7 +1,32 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
 enum class OptionType { Call, Put };
 
+// What the call or put is written on: the terminal price, the average or extreme of the daily prices, or the terminal
+// price of a path that must (knock-in) or must not (knock-out) touch a barrier
+enum class PayoffStyle { European, ArithmeticAsian, GeometricAsian, Lookback, Barrier };
+
+enum class BarrierType { UpAndOut, UpAndIn, DownAndOut, DownAndIn };
+
+// Whether the payoff depends on more of the path than its terminal price
+inline bool isPathDependent(PayoffStyle payoffStyle) {
+    switch (payoffStyle) {
+        case PayoffStyle::European:
+            return false;
+        case PayoffStyle::ArithmeticAsian:
+        case PayoffStyle::GeometricAsian:
+        case PayoffStyle::Lookback:
+        case PayoffStyle::Barrier:
+            return true;
+    }
+    return true;
+}
+
 struct OptionParams {
     double spotPrice;
     double strikePrice;
@@ -9,6 +34,9 @@ struct OptionParams {
     double riskFreeRate;
     double volatility;
     OptionType optionType;
+    PayoffStyle payoffStyle = PayoffStyle::European;
+    BarrierType barrierType = BarrierType::UpAndOut; // Only read by barrier options
+    double barrierLevel = 0.0;
 };
 
 struct Greeks {
@@ -19,9 +47,162 @@ struct Greeks {
     double theta;
 };
 
+// Wall and CPU time, work done and memory used by one phase of a pricing run
+struct PhaseStatistics {
+    std::string name;
+    double wallSeconds = 0.0;
+    double cpuSeconds = 0.0; // Process CPU time, summed over every thread
+    long long paths = 0;
+    long long steps = 0; // Path steps walked, counting a path and its antithetic twin once
+    long long randomDraws = 0;
+    long long bytesAllocated = 0;
+};
+
 struct OptionResult {
     double averagePayoff;
     double standardError;
     std::tuple<double, double> confidenceInterval;
     Greeks greeks;
+    Greeks greekStandardErrors;
+    double varianceReductionFactor; // Variance of the crude estimator over the variance of the reported one
+    int numPaths;
+    double elapsedSeconds;
+    std::vector<PhaseStatistics> phases;
+};
+
+constexpr int NUM_SIMULATIONS = 100000;
+constexpr int NUM_GRAPHED_PATHS = 100;
+constexpr int MAX_ADAPTIVE_SIMULATIONS = 100000000;
+
+// Variance reduction techniques applied on top of the crude estimator; each one can be switched on independently
+struct VarianceReduction {
+    bool antithetic = true; // Average every path with its mirror image
+    bool terminalPriceControl = false; // Discounted terminal price, whose expectation is the spot price
+    bool blackScholesControl = false; // Vanilla payoff with its Black-Scholes price as the expectation
+    bool importanceSampling = false; // Drift out of the money paths towards the strike and reweight by the likelihood ratio
+    bool geometricAsianControl = false; // Geometric average payoff with its closed-form price as the expectation
+};
+
+// Dynamics of the underlying. Black-Scholes is the flat-volatility GBM given by the option itself; the others replace
+// its volatility with a stochastic or state-dependent one.
+enum class ModelType { BlackScholes, Heston, Sabr, LocalVolatility };
+
+// Heston (1993): dS = r S dt + sqrt(v) S dW1 and dv = meanReversion (longRunVariance - v) dt + volatilityOfVariance
+// sqrt(v) dW2, with correlation between W1 and W2
+struct HestonParams {
+    double initialVariance;
+    double meanReversion;
+    double longRunVariance;
+    double volatilityOfVariance;
+    double correlation;
+};
+
+// SABR (Hagan et al., 2002) on the forward to maturity: dF = alpha F^beta dW1 and dalpha = volatilityOfVolatility
+// alpha dW2, with correlation between W1 and W2
+struct SabrParams {
+    double alpha;
+    double beta;
+    double volatilityOfVolatility;
+    double correlation;
+};
+
+// Local volatility sigma(t, S) tabulated at each time and spot price, as volatilities[timeIndex * spotPrices.size() +
+// spotIndex]. Between the nodes it is interpolated linearly, and beyond them held flat.
+struct LocalVolatilityTable {
+    std::vector<double> times;
+    std::vector<double> spotPrices;
+    std::vector<double> volatilities;
+};
+
+// Continuously compounded zero rates at increasing times. The integrated rate z(t) t is interpolated linearly, which
+// makes forward rates flat between the nodes, and the zero rate is held flat beyond the last node.
+struct RateCurve {
+    std::vector<double> times;
+    std::vector<double> zeroRates;
 };
+
+struct ModelSettings {
+    ModelType type = ModelType::BlackScholes;
+    HestonParams heston = {};
+    SabrParams sabr = {};
+    LocalVolatilityTable localVolatility;
+    RateCurve rateCurve; // Discounts and drifts every path instead of the option's flat rate when not empty
+};
+
+// European options can only be exercised at maturity, American ones on any day before it and Bermudan ones on a set
+// of evenly spaced dates
+enum class ExerciseStyle { European, American, Bermudan };
+
+// Functions of the price that the Longstaff-Schwartz regression fits the continuation value with
+enum class RegressionBasis { Monomial, Laguerre };
+
+struct EarlyExercise {
+    ExerciseStyle style = ExerciseStyle::European;
+    int numExerciseDates = 0; // Bermudan only; American options can be exercised on every working day
+    RegressionBasis basis = RegressionBasis::Laguerre;
+    int basisDegree = 3;
+};
+
+// Market shifts to revalue an option under: every spot price shift is combined with every volatility shift
+struct ScenarioGrid {
+    std::vector<double> spotPriceShifts; // Relative, so each scenario's spot price is spotPrice * (1 + shift)
+    std::vector<double> volatilityShifts; // Absolute, added to the volatility
+};
+
+// How far the volatility and rate may move from those a contract's paths were simulated with before the paths are
+// simulated again, as the likelihood ratio weights grow noisier the further they go. The spot price has no threshold:
+// rescaling the cached paths gives the same price and Greeks, theta included, as simulating them again with the same
+// seed would, up to rounding.
+struct RepricingThresholds {
+    double volatility = 0.02;
+    double riskFreeRate = 0.01;
+};
+
+// Splits a run's paths across processes. A worker prices shard shardIndex of numShards and writes its statistics to
+// outputPath; a coordinator starts numWorkers local workers, passing them workerFlags, and merges what they write.
+struct ShardSettings {
+    int shardIndex = 0;
+    int numShards = 0; // 0 when this process is not a worker
+    std::string outputPath;
+    int numWorkers = 0; // 0 when this process is not a coordinator
+    std::string executablePath;
+    std::vector<std::string> workerFlags; // This process's own flags, less --workers
+};
+
+struct SimulationSettings {
+    int numThreads = 0; // 0 uses every available hardware thread
+    std::uint64_t seed = 0;
+    bool streamNormals = false; // Regenerate each path's normals on demand instead of storing them all
+    bool forceSteppedPaths = false; // Step through every day even when the payoff only needs the terminal price
+    int barrierStepDays = 1; // Days per step for barrier options, which stay continuously monitored on any grid
+    bool quasiRandom = false; // Scrambled Sobol points with Brownian bridge construction instead of pseudorandom draws
+    bool singlePrecision = false; // Store normals and step path-independent GBM paths in float; payoffs stay double
+    int numSimulations = NUM_SIMULATIONS;
+    VarianceReduction varianceReduction;
+    double targetStandardError = 0.0; // Keep adding paths until the standard error falls to this; 0 disables
+    double timeBudgetSeconds = 0.0; // Stop adding paths once this much wall-clock time has passed; 0 disables
+    int maxSimulations = MAX_ADAPTIVE_SIMULATIONS; // Path cap for adaptive runs, which ignore numSimulations
+    bool computeGreeks = true; // Price only when false; the Greeks and their standard errors are then left at zero
+    bool outputStatistics = false; // Print each phase's timings and counters after the results
+    std::string statisticsJsonPath; // Also write the phase statistics here as JSON when not empty
+    int numGraphedPaths = NUM_GRAPHED_PATHS; // Paths written to output/paths.npy and plotted; 0 skips the graph
+    bool dumpPayoffs = false; // Also write every path's discounted payoff to output/payoffs.npy
+    ModelSettings model;
+    EarlyExercise earlyExercise;
+    ScenarioGrid scenarioGrid; // Revalue over this grid instead of pricing once when it is not empty
+    RepricingThresholds repricingThresholds; // For the pricing server's repricing cache
+    ShardSettings shard;
+};
+
+inline bool hasScenarioGrid(const SimulationSettings& settings) {
+    return !settings.scenarioGrid.spotPriceShifts.empty() || !settings.scenarioGrid.volatilityShifts.empty();
+}
+
+inline bool isSharded(const SimulationSettings& settings) {
+    return settings.shard.numShards > 0 || settings.shard.numWorkers > 0;
+}
+
+// Adaptive runs add paths in chunks until a target standard error or a time budget is reached
+inline bool isAdaptive(const SimulationSettings& settings) {
+    return settings.targetStandardError > 0.0 || settings.timeBudgetSeconds > 0.0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+inline int resolveThreadCount(int requestedThreads) {
+    if (requestedThreads > 0) {
+        return requestedThreads;
+    }
+    const unsigned hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? int (hardwareThreads) : 1;
+}
+
+// Splits [begin, end) into one contiguous range per worker and calls function(workerIndex, rangeBegin, rangeEnd)
+// on each. The calling thread runs worker 0, and the first exception thrown by any worker is rethrown here.
+template <typename Function>
+void parallelFor(int begin, int end, int numThreads, Function function) {
+    const int numItems = end - begin;
+    if (numItems <= 0) {
+        return;
+    }
+    const int numWorkers = std::max(1, std::min(resolveThreadCount(numThreads), numItems));
+    if (numWorkers == 1) {
+        function(0, begin, end);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(numWorkers);
+    auto runWorker = [&](int worker) {
+        const int rangeBegin = begin + int (static_cast<long long>(numItems) * worker / numWorkers);
+        const int rangeEnd = begin + int (static_cast<long long>(numItems) * (worker + 1) / numWorkers);
+        try {
+            function(worker, rangeBegin, rangeEnd);
+        }
+        catch (...) {
+            errors[worker] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(numWorkers - 1);
+    for (int worker = 1; worker < numWorkers; worker++) {
+        workers.emplace_back(runWorker, worker);
+    }
+    runWorker(0);
+    for (std::thread& workerThread : workers) {
+        workerThread.join();
+    }
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
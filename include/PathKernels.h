@@ -0,0 +1,43 @@
+#pragma once
+
+// Number of paths advanced together by a path kernel: one AVX-512 register, or two AVX2 registers, of doubles
+constexpr int PATH_BATCH_SIZE = 8;
+
+// Per-step log drift and diffusion of a GBM path, hoisted out of the step loop
+struct PathConstants {
+    double drift;
+    double diffusion;
+};
+
+enum class KernelIsa { Scalar, Avx2, Avx512 };
+
+// Advances a batch of PATH_BATCH_SIZE paths and their antithetic twins by numSteps steps in log space. The batch is
+// stored as structure-of-arrays: normals[step * PATH_BATCH_SIZE + lane], and one log price per lane. Every kernel
+// performs the same adds and multiplies in the same order, so results are bit-identical whichever one is selected.
+using LogPathKernel = void (*)(const double* normals, int numSteps, PathConstants constants, double* logPrices, double* antiLogPrices);
+
+// PathConstants rounded to float
+struct SinglePathConstants {
+    float drift;
+    float diffusion;
+};
+
+// The single-precision kernels take float normals and advance float log returns, which start at zero rather than at
+// the log spot price so that their rounding stays relative to the small moves of the path itself. A batch fits one
+// AVX2 register of floats, so the AVX-512 selection uses the AVX2 kernel too.
+using SingleLogPathKernel = void (*)(const float* normals, int numSteps, SinglePathConstants constants, float* logReturns, float* antiLogReturns);
+
+KernelIsa detectKernelIsa();
+
+bool isKernelIsaSupported(KernelIsa isa);
+
+const char* getKernelIsaName(KernelIsa isa);
+
+LogPathKernel getLogPathKernel(KernelIsa isa);
+
+// The fastest kernel supported by the running CPU, picked once on first use
+LogPathKernel getLogPathKernel();
+
+SingleLogPathKernel getSingleLogPathKernel(KernelIsa isa);
+
+SingleLogPathKernel getSingleLogPathKernel();
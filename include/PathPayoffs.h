@@ -0,0 +1,87 @@
+#pragma once
+
+#include "OptionTypes.h"
+#include "PathKernels.h"
+
+// Per-option values read by every step of a path-dependent payoff, hoisted out of the step loop
+struct PayoffConstants {
+    PayoffStyle payoffStyle;
+    bool tracksGeometricAverage; // Also set for other payoffs when the geometric Asian control variate needs it
+    double volatility;
+    double logBarrier;
+    double barrierSide; // 1 for up barriers and -1 for down ones, so barrierSide * (logBarrier - logPrice) > 0 is safe
+    bool knockIn;
+    bool tracksMaximum; // Lookback calls pay on the running maximum, puts on the running minimum
+};
+
+PayoffConstants createPayoffConstants(const OptionParams& params, bool tracksGeometricAverage);
+
+// Running state of one leg of a path, so that path-dependent payoffs never store the path itself. Next to each running
+// statistic are its pathwise derivatives with respect to the volatility and the rate. Averages and extremes need none
+// for the log spot price, as every price on the path scales with the spot, but the barrier survival probability does.
+// The grid prices after the start are the observations: the start is neither averaged nor a lookback's extreme.
+struct PathState {
+    double logPrice;
+    double brownianMotion; // W(t) of this leg, including any importance sampling shift
+    double time;
+    int numObservations;
+
+    double sumPrices; // Arithmetic average
+    double sumPriceVegas;
+    double sumPriceRhos;
+
+    double sumLogPrices; // Geometric average
+    double sumVegas;
+    double sumTimes;
+
+    double extremePrice; // Maximum for calls, minimum for puts
+    double extremeVega;
+    double extremeRho;
+
+    // Probability that the continuous path has not yet touched the barrier, given the prices on the grid
+    double survival;
+    double survivalDelta; // With respect to the log spot price
+    double survivalVega;
+    double survivalRho;
+
+    // The spot price is itself the first point of the barrier's first bridge, so gamma also needs the survival from the
+    // second step on and the first crossing probability's derivatives with respect to the spot alone (holding the rest
+    // of the path fixed) and then to the whole path
+    double remainingSurvival;
+    double remainingSurvivalDelta;
+    double firstCrossingSpotDerivative;
+    double firstCrossingSpotCurvature;
+};
+
+PathState createPathState(const PayoffConstants& payoff, double logSpotPrice);
+
+// Advances a batch of PATH_BATCH_SIZE legs and their antithetic twins by numSteps steps of dt, reading the same
+// step-major normals as a LogPathKernel. Each leg's W moves by sqrt(dt) * normal + brownianDrift, where brownianDrift
+// carries any importance sampling shift. Barriers are monitored continuously: between two grid prices on the safe
+// side the path survives with the Brownian bridge probability 1 - exp(-2 d0 d1 / (sigma^2 dt)), where d0 and d1 are
+// the log distances to the barrier, so a coarse grid prices the same barrier as a fine one. antiStates may be null.
+void advancePathStates(const double* normals, int numSteps, PathConstants constants, double brownianDrift, double dt, const PayoffConstants& payoff, PathState* states, PathState* antiStates);
+
+// Moves a leg simulated by another model to logPrice after a step of dt whose log return has variance stepVariance,
+// which the barrier's Brownian bridge uses in place of sigma^2 dt. Only the payoff is tracked: the pathwise
+// derivatives in the state assume GBM and are not meaningful for such legs.
+void observeModelPrice(PathState& state, const PayoffConstants& payoff, double logPrice, double stepVariance, double dt);
+
+// Undiscounted payoff of one leg and its pathwise derivatives with respect to the log spot price, the volatility and
+// the rate (ignoring discounting). spotCurvature is the part of the second log spot derivative that comes from the
+// spot being a point on the path rather than from the first step's distribution; only barriers have one.
+struct PayoffSensitivities {
+    double payoff;
+    double logSpotPrice;
+    double volatility;
+    double rate;
+    double spotCurvature;
+};
+
+// The European payoff of a final price, given the leg's Brownian motion W(t) at the simulated time t
+PayoffSensitivities evaluateTerminalPayoff(const OptionParams& params, double finalPrice, double brownianMotion, double simulatedTime);
+
+PayoffSensitivities evaluatePathPayoff(const OptionParams& params, const PayoffConstants& payoff, const PathState& state);
+
+// Undiscounted call or put payoff on the geometric average of the leg's observations
+double calculateGeometricAveragePayoff(const OptionParams& params, const PathState& state);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct QuasiRandomSource;
+
+// Philox4x32-10 (Salmon et al., 2011). Every output block is a pure function of (key, counter), so a
+// path's random normals depend only on the seed and the path index, never on which thread drew them.
+struct PhiloxBlock {
+    std::uint32_t words[4];
+};
+
+PhiloxBlock philox4x32(std::uint64_t key, std::uint64_t pathIndex, std::uint64_t blockIndex);
+
+std::uint64_t generateSeed();
+
+// Acklam's rational approximation, polished with one Halley step to close to double precision
+double inverseNormalCdf(double probability);
+
+void generatePathNormals(std::uint64_t seed, std::uint64_t pathIndex, int firstStep, int numSteps, double* normals);
+
+std::vector<std::vector<double>> generateRandomNormals(int numSimulations, int numSteps, std::uint64_t seed, int numThreads);
+
+// The normals shared by a pricing run and all of its Greek bumps. In streaming mode values is left empty and each
+// path's normals are regenerated whenever they are needed, so memory stays flat. Paths come from their Philox
+// streams, or from scrambled Sobol points when quasiRandom is set. Streamed path i is global path firstPath + i, so a
+// run split into chunks draws the same numbers as one long run. Single-precision runs store the same normals, rounded
+// to float, in singleValues instead of values, which halves their memory.
+struct RandomNormals {
+    std::uint64_t seed;
+    int numSimulations;
+    int numSteps;
+    std::vector<std::vector<double>> values;
+    std::shared_ptr<const QuasiRandomSource> quasiRandom;
+    int firstPath = 0;
+    std::vector<std::vector<float>> singleValues;
+};
+
+RandomNormals createRandomNormals(int numSimulations, int numSteps, std::uint64_t seed, bool streamed, int numThreads, bool singlePrecision);
+
+// Sobol normals whose first numBridgeSteps steps are built with a Brownian bridge
+RandomNormals createQuasiRandomNormals(int numSimulations, int numBridgeSteps, int numSteps, std::uint64_t seed, bool streamed, int numThreads, bool singlePrecision);
+
+bool isStreamed(const RandomNormals& randomNormals);
+
+std::size_t getStoredNormalBytes(const RandomNormals& randomNormals);
+
+// Returns the first numSteps normals of a path. Stored double rows that are long enough are returned in place;
+// anything else is written to buffer, with steps past the stored ones drawn from the path's own stream.
+const double* getPathNormals(const RandomNormals& randomNormals, int pathIndex, int numSteps, std::vector<double>& buffer);
+
+// The first numSteps normals of a path straight from single-precision storage, or null when they are not all stored
+const float* getStoredSinglePathNormals(const RandomNormals& randomNormals, int pathIndex, int numSteps);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include "OptionTypes.h"
+
+// Cached contracts and results are dropped all at once when either map would grow past these
+constexpr int REPRICING_CACHE_MAX_CONTRACTS = 64;
+constexpr int REPRICING_CACHE_MAX_RESULTS = 4096;
+
+// How each call to repriceOption was answered
+struct RepricingCounts {
+    long long resultHits = 0;
+    long long spotRescales = 0;
+    long long reweightings = 0;
+    long long resimulations = 0;
+};
+
+// The terminal draws of one contract's paths, with the market they were simulated in. Each path keeps its standard
+// normal z, the normal of its extension step on to the theta-bumped maturity, and its growth factor
+// exp((r - sigma^2 / 2) T + sigma sqrt(T) z); the antithetic path's growth factor follows from it without another exp.
+struct CachedPaths {
+    double spotPrice;
+    double volatility;
+    double riskFreeRate;
+    std::vector<double> normals;
+    std::vector<double> extensionNormals;
+    std::vector<double> growthFactors;
+};
+
+// Contract terms: strike, maturity, option type
+using ContractKey = std::tuple<double, double, OptionType>;
+
+// Contract terms followed by spot price, volatility and risk-free rate
+using ResultKey = std::tuple<double, double, OptionType, double, double, double>;
+
+// Results and paths kept between calls to repriceOption. Like NormalsCache, a cache must always be used with the same
+// simulation settings; unlike it, it may be shared between threads.
+struct RepricingCache {
+    RepricingThresholds thresholds;
+    RepricingCounts counts;
+    std::mutex mutex;
+    std::map<ContractKey, std::shared_ptr<const CachedPaths>> contracts;
+    std::map<ResultKey, OptionResult> results;
+};
+
+// Whether repriceOption can reuse earlier work for this option: European calls and puts on the terminal grid under
+// flat-rate GBM, with plain or antithetic double-precision pseudorandom paths of a fixed count, since the cached draws
+// are kept in double. Any other option is simply priced.
+bool isIncrementallyRepriceable(const OptionParams& params, const SimulationSettings& settings);
+
+// Prices the option like priceBatch, reusing as much earlier work as it can. A repeated request returns
+// its earlier result. Otherwise, a contract with cached paths is repriced from them when the market is within the
+// thresholds: the terminal prices scale with the spot price, and a volatility or rate move reweights each path by the
+// likelihood ratio of its terminal log price under the new and the cached parameters. Anything else is simulated
+// afresh, and its paths replace the contract's cached ones.
+OptionResult repriceOption(RepricingCache& cache, const OptionParams& params, const SimulationSettings& settings);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "OptionTypes.h"
+
+// Paths whose scenario statistics are summed together before the blocks are merged in order, so the results do not
+// depend on the thread count
+constexpr int SCENARIO_BLOCK_SIZE = 1024;
+
+// Prices and standard errors over a scenario grid, spot-major: node (i, j) is at i * numVolatilities + j
+struct ScenarioResults {
+    std::vector<double> spotPrices;
+    std::vector<double> volatilities;
+    std::vector<double> prices;
+    std::vector<double> standardErrors;
+    double elapsedSeconds;
+    PhaseStatistics phase;
+};
+
+// Revalues the option at every node of the grid in one parallel sweep over one set of paths, without Greeks. Each
+// path's Brownian motion is built once; each volatility turns it into log prices (r - sigma^2 / 2) t + sigma W(t)
+// relative to the spot; and as every price on a path scales with the spot price, each spot price reuses that path
+// by pricing the option with its strike divided by the same factor. Only barriers need a walk per spot price, since
+// the barrier itself does not move. Throws std::runtime_error for settings the sweep does not support (models, early
+// exercise, quasi-random normals, control variates, importance sampling and adaptive runs) or scenarios with a
+// non-positive spot price or negative volatility.
+ScenarioResults runScenarioGrid(const OptionParams& params, const ScenarioGrid& grid, const SimulationSettings& settings);
+
+void outputScenarioResults(const ScenarioResults& results);
+
+// Writes the grid's size, largest standard error and phase statistics as one JSON object
+void writeScenarioStatisticsJson(const std::filesystem::path& outputPath, const ScenarioResults& results);
+
+// Revalues the option over settings.scenarioGrid and prints the grid, and its phase statistics when the settings ask
+// for them, returning an exit code
+int runScenarioPricing(const OptionParams& params, const SimulationSettings& settings);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "OptionTypes.h"
+
+// Quotes that arrive while the pricer is busy, or within this long of the first one it sees, are priced as one batch
+constexpr int SERVER_BATCH_WINDOW_MICROSECONDS = 200;
+constexpr int SERVER_MAX_BATCH_SIZE = 1024;
+constexpr int SERVER_LISTEN_BACKLOG = 64;
+constexpr int SERVER_READ_BUFFER_SIZE = 1 << 16;
+// Far longer than any quote row; a client that sends more without a newline is answered with an error and cut off
+constexpr std::size_t SERVER_MAX_LINE_BYTES = 4096;
+
+// Keeps the engine running and prices quotes sent over localhost TCP, when address is a port number, or else over a
+// Unix domain socket at that path. Each connection is greeted with the batch results header; after that every line it
+// sends is a portfolio row (as in a -b file) and gets back either the matching results row or "ERROR,<reason>", in
+// the order sent. A line longer than SERVER_MAX_LINE_BYTES gets an error and closes the connection. European quotes on
+// the terminal grid are priced with repriceOption, so a repeated quote or a small market move is answered from the
+// contract's cached paths. Other quotes from all connections are coalesced and priced together with priceBatch, so
+// those on the same step grid share one set of random normals, and the normals are cached between batches. A line
+// reading SHUTDOWN stops the server once the quotes before it are answered. Returns an exit code.
+int runPricingServer(const std::string& address, const SimulationSettings& settings);
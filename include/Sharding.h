@@ -0,0 +1,52 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "MonteCarlo.h"
+#include "OptionTypes.h"
+
+// A sharded run's paths are cut into blocks of this many, whatever the shard count, and each block's statistics are
+// kept apart until the coordinator merges them in block order, so the result does not depend on the shard layout
+constexpr int SHARD_BLOCK_SIZE = 65536;
+constexpr int MAX_LOCAL_WORKERS = 256;
+constexpr const char* SHARD_FILE_HEADER = "MonteCarloShard,1";
+
+// The statistics one worker sends back instead of its samples: a running count, mean and sum of squared deviations
+// per block for the price and every Greek estimator, which merge exactly like the samples they summarise
+struct ShardStatistics {
+    std::string run; // Every input the paths depend on, which all shards of one run must agree on
+    int shardIndex;
+    int numShards;
+    int numPaths; // Paths in the whole run, not just this shard
+    int firstBlock;
+    std::vector<PricingStatistics> blocks;
+    std::vector<PhaseStatistics> phases;
+};
+
+int getNumShardBlocks(int numPaths);
+
+std::string describeShardedRun(const OptionParams& params, const SimulationSettings& settings);
+
+// Prices the blocks of shard shardIndex of numShards: block b holds paths [b * SHARD_BLOCK_SIZE, (b + 1) *
+// SHARD_BLOCK_SIZE) of the run, drawn from their own Philox substreams, and shard k takes blocks [B k / N, B (k + 1) / N).
+// Throws std::runtime_error for settings whose estimates need every path at once (control variates, quasi-random
+// normals, adaptive runs, models and early exercise).
+ShardStatistics runShard(const OptionParams& params, int shardIndex, int numShards, const SimulationSettings& settings);
+
+// A text file with one line per block, each value written with 17 significant digits so it reads back exactly
+void writeShardFile(const std::filesystem::path& outputPath, const ShardStatistics& shard);
+
+ShardStatistics readShardFile(const std::filesystem::path& inputPath);
+
+// Checks that the shards come from one run and hold every block exactly once, then merges the blocks pairwise in block
+// order. elapsedSeconds is the run's wall time, which the shards cannot know.
+OptionResult mergeShards(const std::vector<ShardStatistics>& shards, double elapsedSeconds);
+
+// Prices as settings.shard asks: as a worker, writing its shard file, or as a coordinator, running that many workers
+// of this executable on optionArguments (the option as given on the command line) and printing the merged result.
+// Returns an exit code.
+int runShardedPricing(const OptionParams& params, const std::vector<std::string>& optionArguments, const SimulationSettings& settings);
+
+// Merges shard files written by workers on any machines and prints the result, returning an exit code
+int runShardMerge(const std::vector<std::filesystem::path>& inputPaths, const SimulationSettings& settings);
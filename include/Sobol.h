@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+constexpr int SOBOL_BITS = 32;
+constexpr int NUM_QMC_REPLICATES = 16;
+
+// Direction numbers for the first numDimensions Sobol dimensions, stored as numbers[dimension * SOBOL_BITS + bit].
+// Dimension 0 is the van der Corput sequence; the next dimensions use the primitive polynomials and initial numbers
+// of Joe & Kuo (2008), and beyond their table the polynomials are enumerated and the initial numbers drawn from a
+// fixed Philox stream (any odd m_k < 2^k gives a valid Sobol dimension).
+struct SobolDirections {
+    int numDimensions;
+    std::vector<std::uint32_t> numbers;
+};
+
+SobolDirections createSobolDirections(int numDimensions);
+
+std::uint32_t sobolPoint(const SobolDirections& directions, std::uint32_t index, int dimension);
+
+// Nested uniform (Owen) scrambling of a 32-bit Sobol coordinate via the hash of Laine & Karras (2011), as used by
+// Burley (2020). Each seed gives an independent randomisation that keeps the sequence's stratification.
+std::uint32_t owenScramble(std::uint32_t point, std::uint32_t seed);
+
+// Brownian bridge over numSteps equal steps. Dimension 0 sets the terminal value, then each further dimension fills in
+// the midpoint of the widest remaining gap, so the low (best distributed) Sobol dimensions carry most of the variance.
+struct BrownianBridge {
+    int numSteps;
+    std::vector<int> bridgeIndices;
+    std::vector<int> leftIndices;
+    std::vector<int> rightIndices;
+    std::vector<double> leftWeights;
+    std::vector<double> rightWeights;
+    std::vector<double> standardDeviations;
+};
+
+BrownianBridge createBrownianBridge(int numSteps);
+
+// Turns numSteps independent normals into the normalised increments (W(t_j+1) - W(t_j)) / sqrt(dt) of a bridged path
+void buildBridgedIncrements(const BrownianBridge& bridge, const double* normals, double* increments);
+
+// Everything needed to generate the scrambled Sobol normals of any path. Paths are split into numReplicates equal
+// blocks, each an independently scrambled copy of the same Sobol points, so the spread of the replicate means gives
+// an honest standard error.
+struct QuasiRandomSource {
+    std::uint64_t seed;
+    int numReplicates;
+    int pointsPerReplicate;
+    SobolDirections directions;
+    BrownianBridge bridge;
+};
+
+QuasiRandomSource createQuasiRandomSource(std::uint64_t seed, int numSimulations, int numBridgeSteps, int numDimensions);
+
+// Writes numSteps normals for a path. The first bridge.numSteps come from the Brownian bridge, the following ones are
+// plain Sobol dimensions, and any past the last dimension fall back to the path's pseudorandom stream.
+void generateQuasiRandomPathNormals(const QuasiRandomSource& source, int pathIndex, int numSteps, double* normals);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Streaming mean and variance (Welford, 1962), so samples can be summarised in one pass as they are produced
+struct RunningStatistics {
+    long long count = 0;
+    double mean = 0.0;
+    double sumSquaredDeviations = 0.0;
+};
+
+void addSample(RunningStatistics& statistics, double sample);
+
+// Combines two summaries as if their samples had been added to one (Chan et al., 1979)
+void mergeStatistics(RunningStatistics& statistics, const RunningStatistics& other);
+
+// Summarises blocks of samples one by one and merges the block summaries pairwise, so the rounding error of the mean
+// and variance grows with the logarithm of the sample count rather than with the count itself
+RunningStatistics summarise(const double* samples, std::size_t count);
+
+RunningStatistics summarise(const std::vector<double>& samples);
+
+double calculateSampleVariance(const RunningStatistics& statistics);
+
+// Standard error of the mean of the summarised samples
+double calculateStandardError(const RunningStatistics& statistics);
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "OptionTypes.h"
+
 constexpr int NUM_DECIMAL_PLACES_OUTPUT = 5;
 
 void outputHelp();
@@ -8,10 +13,34 @@ bool isPositiveDouble(const char* price);
 
 bool isNonNegativeDouble(const char* price);
 
+bool isPositiveInteger(const char* number);
+
+bool isNonNegativeInteger(const char* number);
+
 bool insensitiveEquals(std::string string1, std::string string2);
 
+// Splits a line on commas, trimming whitespace around each field
+std::vector<std::string> splitCsvLine(const std::string& line);
+
 bool isValidOptionType(const char* optionType);
 
+bool isValidPayoffStyle(const char* payoffStyle);
+
+bool isValidBarrierType(const char* barrierType);
+
+PayoffStyle getPayoffStyle(const std::string& payoffStyle);
+
+BarrierType getBarrierType(const std::string& barrierType);
+
+const char* getPayoffStyleName(PayoffStyle payoffStyle);
+
+const char* getBarrierTypeName(BarrierType barrierType);
+
+// Prints an error and returns false if the settings' control variates do not apply to the payoff style
+bool checkControlVariates(PayoffStyle payoffStyle, const SimulationSettings& settings);
+
+bool extractSimulationFlags(int argc, char* argv[], SimulationSettings& settings, std::vector<char*>& arguments);
+
 std::filesystem::path getRootDirectory();
 
 std::string buildPythonCommand(const std::filesystem::path& scriptPath);
@@ -22,4 +51,9 @@ std::string prepareForOutput(double number);
 
 void outputRow(std::string key, std::string value);
 
-void outputResults(OptionResult& params);
\ No newline at end of file
+void outputResults(OptionResult& params);
+
+void outputPhaseStatistics(const std::vector<PhaseStatistics>& phases);
+
+// Prints and/or writes the result's phase statistics as the settings ask; returns false if the JSON can't be written
+bool outputRunStatistics(const OptionResult& result, const SimulationSettings& settings);
\ No newline at end of file
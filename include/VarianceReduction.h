@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include "OptionTypes.h"
+
+// Per-path samples of a quantity whose expectation is known exactly, used to cancel noise in the payoff samples
+struct ControlVariate {
+    std::vector<double> samples;
+    double expectation;
+};
+
+// Throws std::runtime_error for a control that would be the priced payoff itself, which cancels all of its noise and
+// reports a zero standard error: the vanilla payoff of a European option, or the geometric average of a geometric
+// Asian option or of a European one's single terminal price. The geometric control is only kept for arithmetic Asians.
+void validateControlVariates(PayoffStyle payoffStyle, const VarianceReduction& varianceReduction);
+
+// Optimal (least-squares) coefficients of the payoffs on the controls. The means and co-moments are accumulated in a
+// single streaming pass, so the samples are read only once.
+std::vector<double> estimateControlVariateCoefficients(const std::vector<double>& payoffs, const std::vector<ControlVariate>& controls);
+
+// payoff - sum of coefficient * (control - expectation), path by path
+std::vector<double> applyControlVariates(const std::vector<double>& payoffs, const std::vector<ControlVariate>& controls, const std::vector<double>& coefficients);
+
+// Per-step shift added to every normal so that the median terminal price of an out-of-the-money option lands on its
+// strike. Returns 0 for options at or in the money at the forward, where a shift would only add variance.
+double calculateImportanceSamplingShift(const OptionParams& params, int numSteps, double stepDt);
+
+// Likelihood ratio of a path whose numSteps normals were each shifted by shift, given the sum of the unshifted normals
+double calculateImportanceWeight(double shift, double normalSum, int numSteps);
+
+// How many crude paths (no antithetics, controls or importance sampling) each simulated path is worth
+double calculateVarianceReductionFactor(double crudeStandardError, double standardError);
@@ -3,13 +3,14 @@ import numpy as np
 from pathlib import Path
 
 rootDirectory = Path(__file__).parent.parent
-dataFileName = rootDirectory / "output" / "graphData.csv"
-data = np.loadtxt(dataFileName, delimiter=",")
+dataFileName = rootDirectory / "output" / "paths.npy"
+# One row per path, mapped straight from the file the simulation wrote rather than read into memory
+data = np.load(dataFileName, mmap_mode="r")
 timeSteps = data.shape[1]
 time = np.arange(timeSteps)
 
-for path in data:
-    plt.plot(time, path, alpha=0.3)
+# Fade the lines as there are more of them, so thousands of paths still show where they concentrate
+plt.plot(time, data.T, alpha=min(0.3, 30.0 / len(data)), linewidth=0.8)
 
 plt.gca().set_xlim([0,timeSteps-1])
 plt.xlabel("Days")
@@ -17,4 +18,4 @@ plt.ylabel("Simulated Security Price")
 plt.title("Monte Carlo Simulated Price Paths")
 graphFileName = rootDirectory / "output" / "graph.png"
 plt.savefig(graphFileName, bbox_inches="tight")
-plt.show()
\ No newline at end of file
+plt.show()
@@ -0,0 +1,49 @@
+#include <cmath>
+#include "Analytic.h"
+
+double normalCdf(double x) {
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+double calculateBlackScholesPrice(const OptionParams& params) {
+    const double discountFactor = std::exp(-params.riskFreeRate * params.timeToMaturity);
+    const double forwardPrice = params.spotPrice / discountFactor;
+    const double totalDeviation = params.volatility * std::sqrt(params.timeToMaturity);
+
+    // With no volatility left the option is worth its discounted intrinsic value at the forward
+    if (totalDeviation <= 0.0) {
+        const double intrinsicValue = params.optionType == OptionType::Call
+         ? forwardPrice - params.strikePrice : params.strikePrice - forwardPrice;
+        return discountFactor * (intrinsicValue > 0.0 ? intrinsicValue : 0.0);
+    }
+
+    const double d1 = (std::log(forwardPrice / params.strikePrice) + totalDeviation * totalDeviation / 2.0) / totalDeviation;
+    const double d2 = d1 - totalDeviation;
+    if (params.optionType == OptionType::Call) {
+        return discountFactor * (forwardPrice * normalCdf(d1) - params.strikePrice * normalCdf(d2));
+    }
+    return discountFactor * (params.strikePrice * normalCdf(-d2) - forwardPrice * normalCdf(-d1));
+}
+
+double calculateGeometricAsianPrice(const OptionParams& params, int numSteps, double stepDt) {
+    // The log of the average is normal, with the mean of the observation times and the average covariance of W over them
+    const double discountFactor = std::exp(-params.riskFreeRate * params.timeToMaturity);
+    const double meanTime = stepDt * (numSteps + 1) / 2.0;
+    const double averageVariance = params.volatility * params.volatility * stepDt * (numSteps + 1) * (2.0 * numSteps + 1) / (6.0 * numSteps);
+    const double logMean = std::log(params.spotPrice) + (params.riskFreeRate - params.volatility * params.volatility / 2.0) * meanTime;
+    const double forwardAverage = std::exp(logMean + averageVariance / 2.0);
+    const double totalDeviation = std::sqrt(averageVariance);
+
+    if (totalDeviation <= 0.0) {
+        const double intrinsicValue = params.optionType == OptionType::Call
+         ? forwardAverage - params.strikePrice : params.strikePrice - forwardAverage;
+        return discountFactor * (intrinsicValue > 0.0 ? intrinsicValue : 0.0);
+    }
+
+    const double d1 = (std::log(forwardAverage / params.strikePrice) + averageVariance / 2.0) / totalDeviation;
+    const double d2 = d1 - totalDeviation;
+    if (params.optionType == OptionType::Call) {
+        return discountFactor * (forwardAverage * normalCdf(d1) - params.strikePrice * normalCdf(d2));
+    }
+    return discountFactor * (params.strikePrice * normalCdf(-d2) - forwardAverage * normalCdf(-d1));
+}
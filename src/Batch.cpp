@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "Batch.h"
+#include "LongstaffSchwartz.h"
+#include "Models.h"
+#include "MonteCarlo.h"
+#include "Parallel.h"
+#include "Utils.h"
+
+namespace {
+    constexpr int NUM_PORTFOLIO_COLUMNS = 6;
+    constexpr int NUM_PAYOFF_STYLE_COLUMNS = 7;
+    constexpr int NUM_BARRIER_COLUMNS = 9;
+
+    std::string describeLine(int lineNumber) {
+        return "line " + std::to_string(lineNumber) + " of the portfolio file";
+    }
+
+    // Draws the normals for a grid, or takes them from the cache when one is given and already holds that grid
+    std::shared_ptr<const RandomNormals> getGridNormals(const TimeGrid& grid, const SimulationSettings& settings, NormalsCache* normalsCache) {
+        if (normalsCache == nullptr) {
+            return std::make_shared<const RandomNormals>(createGridNormals(grid, settings));
+        }
+
+        const std::pair<int, int> stepCounts = { grid.numSteps, getNumGridSteps(grid) };
+        const auto cached = normalsCache->entries.find(stepCounts);
+        if (cached != normalsCache->entries.end()) {
+            return cached->second;
+        }
+        const std::shared_ptr<const RandomNormals> randomNormals = std::make_shared<const RandomNormals>(createGridNormals(grid, settings));
+        const std::size_t bytes = getStoredNormalBytes(*randomNormals);
+        if (bytes > NORMALS_CACHE_BYTES) {
+            return randomNormals;
+        }
+        if (normalsCache->bytes + bytes > NORMALS_CACHE_BYTES) {
+            normalsCache->entries.clear();
+            normalsCache->bytes = 0;
+        }
+        normalsCache->entries[stepCounts] = randomNormals;
+        normalsCache->bytes += bytes;
+        return randomNormals;
+    }
+}
+
+OptionParams parsePortfolioRow(const std::vector<std::string>& fields, const std::string& location) {
+    const int numColumns = int (fields.size());
+    if (numColumns != NUM_PORTFOLIO_COLUMNS && numColumns != NUM_PAYOFF_STYLE_COLUMNS && numColumns != NUM_BARRIER_COLUMNS) {
+        throw std::runtime_error(location + " must have " + std::to_string(NUM_PORTFOLIO_COLUMNS) + ", "
+         + std::to_string(NUM_PAYOFF_STYLE_COLUMNS) + " or " + std::to_string(NUM_BARRIER_COLUMNS) + " columns");
+    }
+    else if (!isPositiveDouble(fields[0].c_str())) {
+        throw std::runtime_error("the spot price on " + location + " must be a positive double");
+    }
+    else if (!isPositiveDouble(fields[1].c_str())) {
+        throw std::runtime_error("the strike price on " + location + " must be a positive double");
+    }
+    else if (!isPositiveDouble(fields[2].c_str())) {
+        throw std::runtime_error("the time to maturity on " + location + " must be a positive double");
+    }
+    else if (!isNonNegativeDouble(fields[3].c_str())) {
+        throw std::runtime_error("the risk-free rate on " + location + " must be a non-negative double");
+    }
+    else if (!isNonNegativeDouble(fields[4].c_str())) {
+        throw std::runtime_error("the volatility on " + location + " must be a non-negative double");
+    }
+    else if (!isValidOptionType(fields[5].c_str())) {
+        throw std::runtime_error("the option type on " + location + " must be either \"Call\" or \"Put\"");
+    }
+    else if (numColumns > NUM_PORTFOLIO_COLUMNS && !isValidPayoffStyle(fields[6].c_str())) {
+        throw std::runtime_error("the payoff style on " + location + " must be European, Asian, GeometricAsian, Lookback or Barrier");
+    }
+    else if (numColumns > NUM_PORTFOLIO_COLUMNS && (getPayoffStyle(fields[6]) == PayoffStyle::Barrier) != (numColumns == NUM_BARRIER_COLUMNS)) {
+        throw std::runtime_error(location + " must give a barrier type and level for barrier options, and only for them");
+    }
+    else if (numColumns == NUM_BARRIER_COLUMNS && !isValidBarrierType(fields[7].c_str())) {
+        throw std::runtime_error("the barrier type on " + location + " must be UpAndOut, UpAndIn, DownAndOut or DownAndIn");
+    }
+    else if (numColumns == NUM_BARRIER_COLUMNS && !isPositiveDouble(fields[8].c_str())) {
+        throw std::runtime_error("the barrier level on " + location + " must be a positive double");
+    }
+
+    const OptionType optionType = insensitiveEquals(fields[5], "Call") ? OptionType::Call : OptionType::Put;
+    OptionParams option = { std::stod(fields[0]), std::stod(fields[1]), std::stod(fields[2]), std::stod(fields[3]) / 100.0, std::stod(fields[4]) / 100.0, optionType };
+    if (numColumns > NUM_PORTFOLIO_COLUMNS) {
+        option.payoffStyle = getPayoffStyle(fields[6]);
+    }
+    if (numColumns == NUM_BARRIER_COLUMNS) {
+        option.barrierType = getBarrierType(fields[7]);
+        option.barrierLevel = std::stod(fields[8]);
+    }
+    return option;
+}
+
+std::vector<OptionParams> readPortfolioFile(const std::filesystem::path& inputPath) {
+    std::ifstream inputFile(inputPath);
+    if (!inputFile) {
+        throw std::runtime_error("could not open " + inputPath.string());
+    }
+
+    std::vector<OptionParams> options;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(inputFile, line)) {
+        lineNumber++;
+        const std::vector<std::string> fields = splitCsvLine(line);
+        if (fields.empty() || (fields.size() == 1 && fields[0].empty())) {
+            continue;
+        }
+        if (lineNumber == 1 && !isNonNegativeDouble(fields[0].c_str())) {
+            continue;
+        }
+
+        options.push_back(parsePortfolioRow(fields, describeLine(lineNumber)));
+    }
+
+    return options;
+}
+
+std::vector<OptionResult> priceBatch(const std::vector<OptionParams>& options, const SimulationSettings& settings, NormalsCache* normalsCache) {
+    // Quasi-random normals depend on where the Brownian bridge ends, so options are grouped by both step counts
+    std::map<std::pair<int, int>, std::vector<int>> optionsByNumSteps;
+    for (int i = 0; i < int (options.size()); i++) {
+        const TimeGrid grid = createTimeGrid(options[i], settings);
+        optionsByNumSteps[{ grid.numSteps, getNumGridSteps(grid) }].push_back(i);
+    }
+
+    const int numThreads = resolveThreadCount(settings.numThreads);
+    std::vector<OptionResult> results(options.size());
+    for (const auto& [stepCounts, optionIndices] : optionsByNumSteps) {
+        // Adaptive runs, the model engine and early exercise stream their own normals, so only fixed-size European GBM runs
+        // share one set per group
+        const bool exercisesEarly = settings.earlyExercise.style != ExerciseStyle::European;
+        const bool sharesNormals = !isAdaptive(settings) && !usesModelEngine(settings) && !exercisesEarly;
+        const std::shared_ptr<const RandomNormals> groupNormals = sharesNormals
+         ? getGridNormals(createTimeGrid(options[optionIndices[0]], settings), settings, normalsCache) : std::make_shared<const RandomNormals>();
+        const RandomNormals& randomNormals = *groupNormals;
+
+        // Spread the threads over the options first; any left over go to the paths of each option
+        const int groupSize = int (optionIndices.size());
+        const int numOptionWorkers = std::min(numThreads, groupSize);
+        SimulationSettings optionSettings = settings;
+        optionSettings.numThreads = std::max(1, numThreads / numOptionWorkers);
+        parallelFor(0, groupSize, numOptionWorkers, [&](int, int firstOption, int lastOption) {
+            for (int i = firstOption; i < lastOption; i++) {
+                const int optionIndex = optionIndices[i];
+                const OptionParams& option = options[optionIndex];
+                const TimeGrid grid = createTimeGrid(option, settings);
+                if (exercisesEarly) {
+                    results[optionIndex] = runLongstaffSchwartzSimulation(option, optionSettings, "");
+                }
+                else if (usesModelEngine(settings)) {
+                    results[optionIndex] = runModelSimulation(option, optionSettings, "");
+                }
+                else {
+                    results[optionIndex] = isAdaptive(settings)
+                     ? runAdaptiveMonteCarloSimulation(option, grid, false, "", optionSettings)
+                     : runMonteCarloSimulation(option, grid, randomNormals, false, "", optionSettings);
+                }
+            }
+        });
+    }
+
+    return results;
+}
+
+void writeBatchResults(const std::filesystem::path& outputPath, const std::vector<OptionParams>& options, const std::vector<OptionResult>& results) {
+    std::ofstream outputFile(outputPath);
+    if (!outputFile) {
+        throw std::runtime_error("could not open " + outputPath.string() + " for writing");
+    }
+
+    outputFile << std::setprecision(std::numeric_limits<double>::digits10);
+    outputFile << BATCH_RESULT_HEADER << '\n';
+    for (std::size_t i = 0; i < options.size(); i++) {
+        writeBatchResultRow(outputFile, options[i], results[i]);
+    }
+}
+
+void writeBatchResultRow(std::ostream& output, const OptionParams& option, const OptionResult& result) {
+    output << option.spotPrice << ',' << option.strikePrice << ',' << option.timeToMaturity << ','
+           << option.riskFreeRate * 100.0 << ',' << option.volatility * 100.0 << ','
+           << (option.optionType == OptionType::Call ? "Call" : "Put") << ','
+           << getPayoffStyleName(option.payoffStyle) << ','
+           << (option.payoffStyle == PayoffStyle::Barrier ? getBarrierTypeName(option.barrierType) : "") << ','
+           << option.barrierLevel << ','
+           << result.averagePayoff << ',' << result.standardError << ','
+           << std::get<0>(result.confidenceInterval) << ',' << std::get<1>(result.confidenceInterval) << ','
+           << result.greeks.delta << ',' << result.greeks.gamma << ',' << result.greeks.vega << ','
+           << result.greeks.rho << ',' << result.greeks.theta << ','
+           << result.greekStandardErrors.delta << ',' << result.greekStandardErrors.gamma << ','
+           << result.greekStandardErrors.vega << ',' << result.greekStandardErrors.rho << ','
+           << result.greekStandardErrors.theta << ',' << result.varianceReductionFactor << ','
+           << result.numPaths << ',' << result.elapsedSeconds << '\n';
+}
+
+int runBatchPricing(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, const SimulationSettings& settings) {
+    try {
+        const std::vector<OptionParams> options = readPortfolioFile(inputPath);
+        std::cout << "Pricing " << options.size() << " options from " << inputPath.string() << std::endl;
+
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<OptionResult> results = priceBatch(options, settings);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        writeBatchResults(outputPath, options, results);
+
+        outputRow("Options priced", std::to_string(options.size()));
+        outputRow("Elapsed seconds", prepareForOutput(elapsed.count()));
+        outputRow("Throughput (options/sec)", prepareForOutput(options.size() / std::max(elapsed.count(), 1e-9)));
+        outputRow("Results written to", outputPath.string());
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include "Instrumentation.h"
+
+namespace {
+    constexpr std::chrono::milliseconds PROGRESS_SAMPLE_INTERVAL(100);
+}
+
+PhaseClock startPhaseClock() {
+    return { std::chrono::steady_clock::now(), std::clock() };
+}
+
+void stopPhaseClock(const PhaseClock& clock, PhaseStatistics& statistics) {
+    statistics.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock.wallStart).count();
+    statistics.cpuSeconds = double (std::clock() - clock.cpuStart) / CLOCKS_PER_SEC;
+}
+
+void addPhaseStatistics(std::vector<PhaseStatistics>& phases, const PhaseStatistics& statistics) {
+    for (PhaseStatistics& phase : phases) {
+        if (phase.name == statistics.name) {
+            phase.wallSeconds += statistics.wallSeconds;
+            phase.cpuSeconds += statistics.cpuSeconds;
+            phase.paths += statistics.paths;
+            phase.steps += statistics.steps;
+            phase.randomDraws += statistics.randomDraws;
+            phase.bytesAllocated += statistics.bytesAllocated;
+            return;
+        }
+    }
+    phases.push_back(statistics);
+}
+
+void writeRunStatisticsJson(const std::filesystem::path& outputPath, const OptionResult& result) {
+    std::ofstream outputFile(outputPath);
+    if (!outputFile) {
+        throw std::runtime_error("could not open " + outputPath.string() + " for writing");
+    }
+
+    outputFile << std::setprecision(std::numeric_limits<double>::digits10);
+    outputFile << "{\n"
+               << "  \"optionValue\": " << result.averagePayoff << ",\n"
+               << "  \"standardError\": " << result.standardError << ",\n"
+               << "  \"numPaths\": " << result.numPaths << ",\n"
+               << "  \"elapsedSeconds\": " << result.elapsedSeconds << ",\n";
+    writePhaseStatisticsJson(outputFile, result.phases);
+    outputFile << "}\n";
+}
+
+void writePhaseStatisticsJson(std::ostream& output, const std::vector<PhaseStatistics>& phases) {
+    output << "  \"phases\": [";
+    for (std::size_t i = 0; i < phases.size(); i++) {
+        const PhaseStatistics& phase = phases[i];
+        output << (i == 0 ? "\n" : ",\n")
+               << "    {\"name\": \"" << phase.name << "\", \"wallSeconds\": " << phase.wallSeconds
+               << ", \"cpuSeconds\": " << phase.cpuSeconds << ", \"paths\": " << phase.paths
+               << ", \"steps\": " << phase.steps << ", \"randomDraws\": " << phase.randomDraws
+               << ", \"bytesAllocated\": " << phase.bytesAllocated << "}";
+    }
+    output << "\n  ]\n";
+}
+
+ProgressReporter::ProgressReporter(std::string logText, long long totalWork) : logText(std::move(logText)), totalWork(totalWork) {
+    if (!this->logText.empty()) {
+        samplingThread = std::thread(&ProgressReporter::sampleProgress, this);
+    }
+}
+
+ProgressReporter::~ProgressReporter() {
+    finish();
+}
+
+void ProgressReporter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished) {
+            return;
+        }
+        finished = true;
+    }
+    stopped.notify_all();
+    if (samplingThread.joinable()) {
+        samplingThread.join();
+        std::cout << "\r" + logText + " (\033[32m100%\033[0m)" << std::endl;
+    }
+}
+
+void ProgressReporter::sampleProgress() {
+    int percentageComplete = -1;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopped.wait_for(lock, PROGRESS_SAMPLE_INTERVAL, [this]() { return finished; })) {
+        const long long completed = completedWork.load(std::memory_order_relaxed);
+        const int percentage = totalWork > 0 ? int (completed * 100 / totalWork) : 100;
+        if (percentage > percentageComplete) {
+            percentageComplete = percentage;
+            std::cout << "\r" + logText + " (\033[33m" + std::to_string(percentage) + "%\033[0m)" << std::flush;
+        }
+    }
+}
@@ -0,0 +1,388 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "Instrumentation.h"
+#include "LongstaffSchwartz.h"
+#include "Models.h"
+#include "MonteCarlo.h"
+#include "Parallel.h"
+#include "Random.h"
+
+namespace {
+    constexpr double PIVOT_TOLERANCE = 1e-12;
+
+    // Solves the symmetric normal equations by Cholesky factorisation, returning false if they are singular, as
+    // happens when every in-the-money path sits at nearly the same price
+    bool solveNormalEquations(std::vector<double> matrix, const std::vector<double>& rhs, int size, double* solution) {
+        for (int i = 0; i < size; i++) {
+            for (int j = 0; j <= i; j++) {
+                double sum = matrix[i * size + j];
+                for (int k = 0; k < j; k++) {
+                    sum -= matrix[i * size + k] * matrix[j * size + k];
+                }
+                if (i != j) {
+                    matrix[i * size + j] = sum / matrix[j * size + j];
+                }
+                else if (sum <= PIVOT_TOLERANCE * std::abs(matrix[i * size + i])) {
+                    return false;
+                }
+                else {
+                    matrix[i * size + i] = std::sqrt(sum);
+                }
+            }
+        }
+        for (int i = 0; i < size; i++) {
+            double sum = rhs[i];
+            for (int k = 0; k < i; k++) {
+                sum -= matrix[i * size + k] * solution[k];
+            }
+            solution[i] = sum / matrix[i * size + i];
+        }
+        for (int i = size - 1; i >= 0; i--) {
+            double sum = solution[i];
+            for (int k = i + 1; k < size; k++) {
+                sum -= matrix[k * size + i] * solution[k];
+            }
+            solution[i] = sum / matrix[i * size + i];
+        }
+        return true;
+    }
+
+    double calculateContinuationValue(const ExercisePolicy& policy, int date, const double* basis) {
+        const double* coefficients = policy.coefficients.data() + std::size_t (date) * policy.numBasisFunctions;
+        double continuationValue = 0.0;
+        for (int j = 0; j < policy.numBasisFunctions; j++) {
+            continuationValue += coefficients[j] * basis[j];
+        }
+        return continuationValue;
+    }
+
+    // Estimates from one leg of a path that follows the policy until it exercises or reaches maturity
+    struct ExerciseLegEstimates {
+        double payoff;
+        double delta;
+        double gamma;
+        double vega;
+        double rho;
+        double extendedPayoff; // For theta: the same leg with maturity TIME_TO_MATURITY_JUMP later
+    };
+}
+
+std::vector<double> createExerciseDates(const OptionParams& params, const EarlyExercise& earlyExercise) {
+    const int numDates = earlyExercise.style == ExerciseStyle::Bermudan
+     ? std::max(1, earlyExercise.numExerciseDates) : createModelTimeGrid(params, 1).numSteps;
+    std::vector<double> dates(numDates);
+    for (int date = 0; date < numDates; date++) {
+        dates[date] = params.timeToMaturity * (date + 1) / numDates;
+    }
+    return dates;
+}
+
+int getNumBasisFunctions(const EarlyExercise& earlyExercise) {
+    return earlyExercise.basisDegree + 1;
+}
+
+void evaluateBasis(const EarlyExercise& earlyExercise, double scaledPrice, double* values) {
+    values[0] = 1.0;
+    if (earlyExercise.basis == RegressionBasis::Monomial) {
+        for (int n = 1; n <= earlyExercise.basisDegree; n++) {
+            values[n] = values[n - 1] * scaledPrice;
+        }
+        return;
+    }
+
+    // (n + 1) L_{n+1}(x) = (2n + 1 - x) L_n(x) - n L_{n-1}(x), starting from L_0 = 1 and L_1 = 1 - x
+    const double weight = std::exp(-scaledPrice / 2.0);
+    double previous = 0.0;
+    double current = 1.0;
+    for (int n = 0; n < earlyExercise.basisDegree; n++) {
+        values[n + 1] = weight * current;
+        const double next = ((2 * n + 1 - scaledPrice) * current - n * previous) / (n + 1);
+        previous = current;
+        current = next;
+    }
+}
+
+ExercisePolicy estimateExercisePolicy(const OptionParams& params, const SimulationSettings& settings, PhaseStatistics& phase) {
+    const PhaseClock clock = startPhaseClock();
+    const EarlyExercise& earlyExercise = settings.earlyExercise;
+    ExercisePolicy policy;
+    policy.dates = createExerciseDates(params, earlyExercise);
+    policy.numBasisFunctions = getNumBasisFunctions(earlyExercise);
+    const int numDates = int (policy.dates.size());
+    const int numBasisFunctions = policy.numBasisFunctions;
+    policy.coefficients.assign(std::size_t (numDates) * numBasisFunctions, 0.0);
+    policy.isFitted.assign(numDates, 0);
+
+    const int numPaths = settings.numSimulations;
+    const int numBlocks = (numPaths + LSM_REGRESSION_BLOCK_SIZE - 1) / LSM_REGRESSION_BLOCK_SIZE;
+    const double drift = params.riskFreeRate - params.volatility * params.volatility / 2.0;
+    const double maturity = policy.dates.back();
+    auto calculatePrice = [&](double time, double brownianMotion) {
+        return params.spotPrice * std::exp(drift * time + params.volatility * brownianMotion);
+    };
+
+    // Each path's Brownian motion at the current date and its cash flow discounted to today
+    std::vector<double> brownianMotions(numPaths);
+    std::vector<double> cashFlows(numPaths);
+    parallelFor(0, numBlocks, settings.numThreads, [&](int, int firstBlock, int lastBlock) {
+        const int lastPath = std::min(lastBlock * LSM_REGRESSION_BLOCK_SIZE, numPaths);
+        for (int i = firstBlock * LSM_REGRESSION_BLOCK_SIZE; i < lastPath; i++) {
+            double normal;
+            generatePathNormals(settings.seed, std::uint64_t (i), numDates - 1, 1, &normal);
+            brownianMotions[i] = std::sqrt(maturity) * normal;
+            cashFlows[i] = calculateDiscountedPayoff(params, calculatePrice(maturity, brownianMotions[i]));
+        }
+    });
+
+    // Per block: the lower triangle of sum(phi phi^T), then sum(phi y), then the number of in-the-money paths
+    const int numSums = numBasisFunctions * numBasisFunctions + numBasisFunctions + 1;
+    std::vector<double> blockSums(std::size_t (numBlocks) * numSums);
+    std::vector<double> matrix(std::size_t (numBasisFunctions) * numBasisFunctions);
+    std::vector<double> rhs(numBasisFunctions);
+    for (int date = numDates - 2; date >= 0; date--) {
+        // Step back from the next date with the Brownian bridge W(t) | W(t') ~ N(t / t' W(t'), t (t' - t) / t')
+        const double time = policy.dates[date];
+        const double nextTime = policy.dates[date + 1];
+        const double bridgeWeight = time / nextTime;
+        const double bridgeDeviation = std::sqrt(time * (nextTime - time) / nextTime);
+        const double growthFactor = std::exp(params.riskFreeRate * time);
+
+        parallelFor(0, numBlocks, settings.numThreads, [&](int, int firstBlock, int lastBlock) {
+            double basis[MAX_BASIS_DEGREE + 1];
+            for (int block = firstBlock; block < lastBlock; block++) {
+                double* sums = blockSums.data() + std::size_t (block) * numSums;
+                std::fill(sums, sums + numSums, 0.0);
+                const int lastPath = std::min((block + 1) * LSM_REGRESSION_BLOCK_SIZE, numPaths);
+                for (int i = block * LSM_REGRESSION_BLOCK_SIZE; i < lastPath; i++) {
+                    double normal;
+                    generatePathNormals(settings.seed, std::uint64_t (i), date, 1, &normal);
+                    brownianMotions[i] = bridgeWeight * brownianMotions[i] + bridgeDeviation * normal;
+                    const double price = calculatePrice(time, brownianMotions[i]);
+                    if (calculateVanillaPayoff(params, price) <= 0.0) {
+                        continue;
+                    }
+                    evaluateBasis(earlyExercise, price / params.strikePrice, basis);
+                    const double continuationValue = cashFlows[i] * growthFactor;
+                    for (int a = 0; a < numBasisFunctions; a++) {
+                        for (int b = 0; b <= a; b++) {
+                            sums[a * numBasisFunctions + b] += basis[a] * basis[b];
+                        }
+                        sums[numBasisFunctions * numBasisFunctions + a] += basis[a] * continuationValue;
+                    }
+                    sums[numSums - 1] += 1.0;
+                }
+            }
+        });
+
+        std::fill(matrix.begin(), matrix.end(), 0.0);
+        std::fill(rhs.begin(), rhs.end(), 0.0);
+        double numInTheMoney = 0.0;
+        for (int block = 0; block < numBlocks; block++) {
+            const double* sums = blockSums.data() + std::size_t (block) * numSums;
+            for (int a = 0; a < numBasisFunctions; a++) {
+                for (int b = 0; b <= a; b++) {
+                    matrix[a * numBasisFunctions + b] += sums[a * numBasisFunctions + b];
+                }
+                rhs[a] += sums[numBasisFunctions * numBasisFunctions + a];
+            }
+            numInTheMoney += sums[numSums - 1];
+        }
+        for (int a = 0; a < numBasisFunctions; a++) {
+            for (int b = 0; b < a; b++) {
+                matrix[b * numBasisFunctions + a] = matrix[a * numBasisFunctions + b];
+            }
+        }
+        double* coefficients = policy.coefficients.data() + std::size_t (date) * numBasisFunctions;
+        policy.isFitted[date] = numInTheMoney >= numBasisFunctions && solveNormalEquations(matrix, rhs, numBasisFunctions, coefficients);
+        if (!policy.isFitted[date]) {
+            std::fill(coefficients, coefficients + numBasisFunctions, 0.0);
+            continue;
+        }
+
+        // Paths that exercise now replace their later cash flow with today's exercise value
+        const double discountFactor = 1.0 / growthFactor;
+        parallelFor(0, numBlocks, settings.numThreads, [&](int, int firstBlock, int lastBlock) {
+            double basis[MAX_BASIS_DEGREE + 1];
+            const int lastPath = std::min(lastBlock * LSM_REGRESSION_BLOCK_SIZE, numPaths);
+            for (int i = firstBlock * LSM_REGRESSION_BLOCK_SIZE; i < lastPath; i++) {
+                const double price = calculatePrice(time, brownianMotions[i]);
+                const double exerciseValue = calculateVanillaPayoff(params, price);
+                if (exerciseValue <= 0.0) {
+                    continue;
+                }
+                evaluateBasis(earlyExercise, price / params.strikePrice, basis);
+                if (exerciseValue >= calculateContinuationValue(policy, date, basis)) {
+                    cashFlows[i] = discountFactor * exerciseValue;
+                }
+            }
+        });
+    }
+
+    phase.paths = numPaths;
+    phase.steps = (long long) (numPaths) * numDates;
+    phase.randomDraws = (long long) (numPaths) * numDates;
+    phase.bytesAllocated = (long long) ((brownianMotions.capacity() + cashFlows.capacity() + blockSums.capacity()) * sizeof(double));
+    stopPhaseClock(clock, phase);
+    return policy;
+}
+
+OptionResult runLongstaffSchwartzSimulation(const OptionParams& params, const SimulationSettings& settings, std::string logText) {
+    if (isPathDependent(params.payoffStyle)) {
+        throw std::runtime_error("early exercise is only supported for vanilla calls and puts");
+    }
+    const auto startTime = std::chrono::steady_clock::now();
+    PhaseStatistics regressionPhase = { "regression" };
+    const ExercisePolicy policy = estimateExercisePolicy(params, settings, regressionPhase);
+
+    const PhaseClock clock = startPhaseClock();
+    const EarlyExercise& earlyExercise = settings.earlyExercise;
+    const int numDates = int (policy.dates.size());
+    const int numNormals = numDates + 1; // The last one extends the path for theta
+    const double logSpotPrice = std::log(params.spotPrice);
+    const double drift = params.riskFreeRate - params.volatility * params.volatility / 2.0;
+    const double maturity = policy.dates.back();
+    const double extendedMaturity = maturity + TIME_TO_MATURITY_JUMP;
+    const double firstVariance = params.volatility * params.volatility * policy.dates.front();
+
+    auto walkLeg = [&](const double* normals, double sign) {
+        double basis[MAX_BASIS_DEGREE + 1];
+        double brownianMotion = 0.0;
+        double firstBrownianMotion = 0.0;
+        double previousTime = 0.0;
+        int exerciseDate = numDates - 1;
+        for (int date = 0; date < numDates; date++) {
+            const double time = policy.dates[date];
+            brownianMotion += sign * std::sqrt(time - previousTime) * normals[date];
+            previousTime = time;
+            if (date == 0) {
+                firstBrownianMotion = brownianMotion;
+            }
+            if (date == numDates - 1 || !policy.isFitted[date]) {
+                continue;
+            }
+            const double price = std::exp(logSpotPrice + drift * time + params.volatility * brownianMotion);
+            const double exerciseValue = calculateVanillaPayoff(params, price);
+            if (exerciseValue <= 0.0) {
+                continue;
+            }
+            evaluateBasis(earlyExercise, price / params.strikePrice, basis);
+            if (exerciseValue >= calculateContinuationValue(policy, date, basis)) {
+                exerciseDate = date;
+                break;
+            }
+        }
+
+        // Pathwise derivatives of exp(-r tau) g(S(tau)) with the exercise time tau held fixed, and gamma from the
+        // likelihood ratio of the first date's price, which carries the spot into the rest of the path
+        const double exerciseTime = policy.dates[exerciseDate];
+        const double price = std::exp(logSpotPrice + drift * exerciseTime + params.volatility * brownianMotion);
+        const double discountFactor = std::exp(-params.riskFreeRate * exerciseTime);
+        const double slope = discountFactor * calculatePayoffSlope(params, price);
+        ExerciseLegEstimates leg;
+        leg.payoff = discountFactor * calculateVanillaPayoff(params, price);
+        leg.delta = slope * price / params.spotPrice;
+        leg.gamma = firstVariance > 0.0 ? leg.delta / params.spotPrice * (params.volatility * firstBrownianMotion / firstVariance - 1.0) : 0.0;
+        leg.vega = slope * price * (brownianMotion - params.volatility * exerciseTime);
+        leg.rho = slope * price * exerciseTime - exerciseTime * leg.payoff;
+
+        // Legs still held at maturity are held on to the later one; legs exercised earlier are unaffected by it
+        leg.extendedPayoff = leg.payoff;
+        if (exerciseDate == numDates - 1) {
+            const double extendedBrownianMotion = brownianMotion + sign * std::sqrt(TIME_TO_MATURITY_JUMP) * normals[numDates];
+            const double extendedPrice = std::exp(logSpotPrice + drift * extendedMaturity + params.volatility * extendedBrownianMotion);
+            leg.extendedPayoff = std::exp(-params.riskFreeRate * extendedMaturity) * calculateVanillaPayoff(params, extendedPrice);
+        }
+        return leg;
+    };
+
+    const int numSimulations = settings.numSimulations;
+    const bool antithetic = settings.varianceReduction.antithetic;
+    std::vector<double> payoffSamples(numSimulations);
+    std::vector<double> crudeSamples(numSimulations);
+    std::vector<double> deltaSamples, gammaSamples, vegaSamples, rhoSamples, thetaSamples;
+    if (settings.computeGreeks) {
+        for (std::vector<double>* estimates : { &deltaSamples, &gammaSamples, &vegaSamples, &rhoSamples, &thetaSamples }) {
+            estimates->resize(numSimulations);
+        }
+    }
+
+    const int numBlocks = (numSimulations + LSM_REGRESSION_BLOCK_SIZE - 1) / LSM_REGRESSION_BLOCK_SIZE;
+    ProgressReporter progress(logText, numSimulations);
+    parallelFor(0, numBlocks, settings.numThreads, [&](int, int firstBlock, int lastBlock) {
+        std::vector<double> normals(numNormals);
+        for (int block = firstBlock; block < lastBlock; block++) {
+            const int firstPath = block * LSM_REGRESSION_BLOCK_SIZE;
+            const int lastPath = std::min(firstPath + LSM_REGRESSION_BLOCK_SIZE, numSimulations);
+            for (int i = firstPath; i < lastPath; i++) {
+                generatePathNormals(settings.seed, LSM_PRICING_PATH_OFFSET + std::uint64_t (i), 0, numNormals, normals.data());
+                const ExerciseLegEstimates leg = walkLeg(normals.data(), 1.0);
+                const ExerciseLegEstimates antitheticLeg = antithetic ? walkLeg(normals.data(), -1.0) : leg;
+                auto combineLegs = [&](double estimate, double antitheticEstimate) {
+                    return antithetic ? 0.5 * (estimate + antitheticEstimate) : estimate;
+                };
+
+                payoffSamples[i] = combineLegs(leg.payoff, antitheticLeg.payoff);
+                crudeSamples[i] = leg.payoff;
+                if (settings.computeGreeks) {
+                    deltaSamples[i] = combineLegs(leg.delta, antitheticLeg.delta);
+                    gammaSamples[i] = combineLegs(leg.gamma, antitheticLeg.gamma);
+                    vegaSamples[i] = combineLegs(leg.vega, antitheticLeg.vega);
+                    rhoSamples[i] = combineLegs(leg.rho, antitheticLeg.rho);
+                    thetaSamples[i] = -(combineLegs(leg.extendedPayoff, antitheticLeg.extendedPayoff) - payoffSamples[i]) / TIME_TO_MATURITY_JUMP;
+                }
+            }
+            progress.addCompletedWork(lastPath - firstPath);
+        }
+    });
+    progress.finish();
+
+    PricingStatistics statistics;
+    statistics.payoff = summarise(payoffSamples);
+    statistics.crude = summarise(crudeSamples);
+    statistics.delta = summarise(deltaSamples);
+    statistics.gamma = summarise(gammaSamples);
+    statistics.vega = summarise(vegaSamples);
+    statistics.rho = summarise(rhoSamples);
+    statistics.theta = summarise(thetaSamples);
+
+    PhaseStatistics pricingPhase = { "path simulation" };
+    pricingPhase.paths = numSimulations;
+    pricingPhase.steps = (long long) (numSimulations) * numNormals;
+    pricingPhase.randomDraws = (long long) (numSimulations) * numNormals;
+    for (const std::vector<double>* estimates : { &payoffSamples, &crudeSamples, &deltaSamples, &gammaSamples, &vegaSamples, &rhoSamples, &thetaSamples }) {
+        pricingPhase.bytesAllocated += (long long) (estimates->capacity() * sizeof(double));
+    }
+    stopPhaseClock(clock, pricingPhase);
+
+    const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    OptionResult result = createOptionResult(statistics, numSimulations, elapsedSeconds);
+    result.phases = { regressionPhase, pricingPhase };
+    return result;
+}
+
+void validateEarlyExercise(const SimulationSettings& settings) {
+    const EarlyExercise& earlyExercise = settings.earlyExercise;
+    if (earlyExercise.style == ExerciseStyle::European) {
+        return;
+    }
+    if (earlyExercise.style == ExerciseStyle::Bermudan && earlyExercise.numExerciseDates < 1) {
+        throw std::runtime_error("Bermudan options need at least one exercise date");
+    }
+    else if (earlyExercise.basisDegree < 1 || earlyExercise.basisDegree > MAX_BASIS_DEGREE) {
+        throw std::runtime_error("the regression basis degree must be between 1 and " + std::to_string(MAX_BASIS_DEGREE));
+    }
+    else if (usesModelEngine(settings)) {
+        throw std::runtime_error("early exercise is only supported by the flat-rate Black-Scholes model");
+    }
+    else if (settings.quasiRandom || isAdaptive(settings)) {
+        throw std::runtime_error("early exercise does not support --qmc or adaptive path counts");
+    }
+
+    const VarianceReduction& varianceReduction = settings.varianceReduction;
+    if (varianceReduction.terminalPriceControl || varianceReduction.blackScholesControl || varianceReduction.geometricAsianControl
+     || varianceReduction.importanceSampling) {
+        throw std::runtime_error("early exercise does not support control variates or importance sampling");
+    }
+}
@@ -0,0 +1,117 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "MappedArray.h"
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+    constexpr char NPY_MAGIC[] = "\x93NUMPY";
+    constexpr std::size_t NPY_PREAMBLE_BYTES = 10; // Magic, version and header length
+    constexpr std::size_t NPY_ALIGNMENT = 64;
+
+    bool isLittleEndian() {
+        const std::uint16_t probe = 1;
+        unsigned char firstByte;
+        std::memcpy(&firstByte, &probe, 1);
+        return firstByte == 1;
+    }
+
+    // Version 1.0 header: the preamble, then a dict literal padded with spaces and ended by a newline, so that the
+    // whole header is a multiple of NPY_ALIGNMENT bytes
+    std::string createNpyHeader(const std::vector<std::size_t>& shape) {
+        std::string shapeText = "(";
+        for (std::size_t i = 0; i < shape.size(); i++) {
+            shapeText += (i > 0 ? ", " : "") + std::to_string(shape[i]);
+        }
+        shapeText += shape.size() == 1 ? ",)" : ")";
+
+        std::string dictionary = "{'descr': '<f8', 'fortran_order': False, 'shape': " + shapeText + ", }";
+        const std::size_t unpaddedBytes = NPY_PREAMBLE_BYTES + dictionary.size() + 1;
+        dictionary.append((NPY_ALIGNMENT - unpaddedBytes % NPY_ALIGNMENT) % NPY_ALIGNMENT, ' ');
+        dictionary += "\n";
+
+        const std::uint16_t dictionaryBytes = std::uint16_t (dictionary.size());
+        std::string header(NPY_MAGIC, 6);
+        header += '\x01';
+        header += '\x00';
+        header += char (dictionaryBytes & 0xFF);
+        header += char (dictionaryBytes >> 8);
+        return header + dictionary;
+    }
+}
+
+MappedArray::MappedArray(const std::filesystem::path& path, const std::vector<std::size_t>& shape) {
+    if (!isLittleEndian()) {
+        throw std::runtime_error("mapped .npy files are only written on little-endian machines");
+    }
+    numValues = 1;
+    for (std::size_t dimension : shape) {
+        numValues *= dimension;
+    }
+    const std::string header = createNpyHeader(shape);
+    headerBytes = header.size();
+    mappedBytes = headerBytes + numValues * sizeof(double);
+
+    #ifdef _WIN32
+        fileHandle = CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("could not create " + path.string());
+        }
+        LARGE_INTEGER fileSize;
+        fileSize.QuadPart = LONGLONG (mappedBytes);
+        mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READWRITE, DWORD (fileSize.HighPart), fileSize.LowPart, nullptr);
+        mapping = mappingHandle != nullptr ? MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, mappedBytes) : nullptr;
+        if (mapping == nullptr) {
+            if (mappingHandle != nullptr) {
+                CloseHandle(mappingHandle);
+            }
+            CloseHandle(fileHandle);
+            throw std::runtime_error("could not map " + path.string() + " into memory");
+        }
+    #else
+        const int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (file < 0) {
+            throw std::runtime_error("could not create " + path.string());
+        }
+        if (ftruncate(file, off_t (mappedBytes)) != 0) {
+            close(file);
+            throw std::runtime_error("could not size " + path.string());
+        }
+        mapping = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        // The mapping keeps the file open on its own
+        close(file);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("could not map " + path.string() + " into memory");
+        }
+    #endif
+    std::memcpy(mapping, header.data(), headerBytes);
+}
+
+MappedArray::~MappedArray() {
+    #ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+    #else
+        munmap(mapping, mappedBytes);
+    #endif
+}
+
+double* MappedArray::data() const {
+    return reinterpret_cast<double*>(static_cast<char*>(mapping) + headerBytes);
+}
+
+std::size_t MappedArray::size() const {
+    return numValues;
+}
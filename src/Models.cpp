@@ -0,0 +1,642 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include "Analytic.h"
+#include "Instrumentation.h"
+#include "Models.h"
+#include "Parallel.h"
+#include "PathPayoffs.h"
+#include "Random.h"
+#include "Utils.h"
+
+namespace {
+    // Every model walks the log of the discounted price X(t) = S(t) exp(-R(t)), which is a martingale, so rates never
+    // enter a model's step: the engine adds R(t) back whenever it needs the spot price itself. A model is a struct with
+    // a per-path State, StepConstants prepared once per step length, and an advance() that moves one path by one step
+    // and returns the variance of that step's log return, which a barrier's Brownian bridge needs.
+    struct BlackScholesModel {
+        static constexpr int NORMALS_PER_STEP = 1;
+        struct State {
+            double logPrice;
+        };
+        struct StepConstants {
+            double drift;
+            double diffusion;
+            double variance;
+        };
+        double volatility;
+
+        StepConstants prepareStep(double dt) const {
+            const double variance = volatility * volatility * dt;
+            return { -variance / 2.0, volatility * std::sqrt(dt), variance };
+        }
+
+        State createState(double logSpotPrice) const {
+            return { logSpotPrice };
+        }
+
+        double advance(State& state, const StepConstants& constants, int, double, double normal, double) const {
+            state.logPrice = (state.logPrice + constants.drift) + constants.diffusion * normal;
+            return constants.variance;
+        }
+    };
+
+    // Andersen's (2008) quadratic-exponential scheme: the next variance is drawn from a quadratic of a normal or from
+    // a mix of zero and an exponential, whichever matches its true mean and variance, and the log price from its law
+    // given both ends of the variance (with the central weights gamma1 = gamma2 = 1/2)
+    struct HestonModel {
+        static constexpr int NORMALS_PER_STEP = 2;
+        struct State {
+            double logPrice;
+            double variance;
+        };
+        struct StepConstants {
+            double dt;
+            double decay;
+            double initialVarianceWeight; // Variance of the next variance = initialVarianceWeight v + constantVarianceWeight
+            double constantVarianceWeight;
+            double k0;
+            double k1;
+            double k2;
+            double k3;
+            double k4;
+        };
+        HestonParams heston;
+
+        StepConstants prepareStep(double dt) const {
+            const double meanReversion = heston.meanReversion;
+            const double longRunVariance = heston.longRunVariance;
+            const double volatilityOfVariance = heston.volatilityOfVariance;
+            const double correlation = heston.correlation;
+            const double decay = std::exp(-meanReversion * dt);
+            const double squaredVolatility = volatilityOfVariance * volatilityOfVariance;
+            const double correlationRatio = correlation / volatilityOfVariance;
+            const double varianceWeight = 0.5 * dt * (meanReversion * correlationRatio - 0.5);
+
+            StepConstants constants;
+            constants.dt = dt;
+            constants.decay = decay;
+            constants.initialVarianceWeight = squaredVolatility * decay * (1.0 - decay) / meanReversion;
+            constants.constantVarianceWeight = longRunVariance * squaredVolatility * (1.0 - decay) * (1.0 - decay) / (2.0 * meanReversion);
+            constants.k0 = -correlationRatio * meanReversion * longRunVariance * dt;
+            constants.k1 = varianceWeight - correlationRatio;
+            constants.k2 = varianceWeight + correlationRatio;
+            constants.k3 = 0.5 * dt * (1.0 - correlation * correlation);
+            constants.k4 = constants.k3;
+            return constants;
+        }
+
+        State createState(double logSpotPrice) const {
+            return { logSpotPrice, heston.initialVariance };
+        }
+
+        double advance(State& state, const StepConstants& constants, int, double, double normal, double varianceNormal) const {
+            const double variance = state.variance;
+            const double mean = heston.longRunVariance + (variance - heston.longRunVariance) * constants.decay;
+            const double psi = (variance * constants.initialVarianceWeight + constants.constantVarianceWeight) / (mean * mean);
+
+            double nextVariance;
+            if (psi <= QE_SWITCHING_THRESHOLD) {
+                const double twoOverPsi = 2.0 / psi;
+                const double squaredB = twoOverPsi - 1.0 + std::sqrt(twoOverPsi) * std::sqrt(twoOverPsi - 1.0);
+                const double b = std::sqrt(squaredB);
+                nextVariance = mean / (1.0 + squaredB) * (b + varianceNormal) * (b + varianceNormal);
+            }
+            else {
+                const double zeroProbability = (psi - 1.0) / (psi + 1.0);
+                const double rate = (1.0 - zeroProbability) / mean;
+                // 1 - U from the upper tail directly, which keeps its precision for large normals
+                const double survival = normalCdf(-varianceNormal);
+                nextVariance = 1.0 - survival <= zeroProbability ? 0.0 : std::log((1.0 - zeroProbability) / survival) / rate;
+            }
+
+            const double conditionalVariance = std::max(0.0, constants.k3 * variance + constants.k4 * nextVariance);
+            state.logPrice += constants.k0 + constants.k1 * variance + constants.k2 * nextVariance + std::sqrt(conditionalVariance) * normal;
+            state.variance = nextVariance;
+            return 0.5 * (variance + nextVariance) * constants.dt;
+        }
+    };
+
+    // Log-Euler steps of the price with local volatility alpha X^(beta - 1), which keeps X positive and a martingale,
+    // and exact lognormal steps of alpha
+    struct SabrModel {
+        static constexpr int NORMALS_PER_STEP = 2;
+        struct State {
+            double logPrice;
+            double alpha;
+        };
+        struct StepConstants {
+            double dt;
+            double sqrtDt;
+            double alphaDrift;
+            double alphaDiffusion;
+        };
+        double initialAlpha; // For the discounted price: the forward's alpha times P(0, T)^(1 - beta)
+        double betaMinusOne;
+        double correlation;
+        double orthogonalCorrelation;
+        double volatilityOfVolatility;
+
+        StepConstants prepareStep(double dt) const {
+            return { dt, std::sqrt(dt), -volatilityOfVolatility * volatilityOfVolatility * dt / 2.0, volatilityOfVolatility * std::sqrt(dt) };
+        }
+
+        State createState(double logSpotPrice) const {
+            return { logSpotPrice, initialAlpha };
+        }
+
+        double advance(State& state, const StepConstants& constants, int, double, double normal, double volatilityNormal) const {
+            const double volatility = state.alpha * std::exp(betaMinusOne * state.logPrice);
+            const double variance = volatility * volatility * constants.dt;
+            state.logPrice += -variance / 2.0 + volatility * constants.sqrtDt * (correlation * volatilityNormal + orthogonalCorrelation * normal);
+            state.alpha *= std::exp(constants.alphaDrift + constants.alphaDiffusion * volatilityNormal);
+            return variance;
+        }
+    };
+
+    struct LocalVolatilityModel {
+        static constexpr int NORMALS_PER_STEP = 1;
+        struct State {
+            double logPrice;
+        };
+        struct StepConstants {
+            double dt;
+            double sqrtDt;
+        };
+        const LocalVolatilityGrid* grid;
+        double volatilityShift;
+
+        StepConstants prepareStep(double dt) const {
+            return { dt, std::sqrt(dt) };
+        }
+
+        State createState(double logSpotPrice) const {
+            return { logSpotPrice };
+        }
+
+        double advance(State& state, const StepConstants& constants, int step, double rateIntegral, double normal, double) const {
+            const double position = std::clamp((state.logPrice + rateIntegral - grid->firstLogPrice) * grid->inverseSpacing, 0.0, double (LOCAL_VOLATILITY_GRID_POINTS - 1));
+            const int node = std::min(int (position), LOCAL_VOLATILITY_GRID_POINTS - 2);
+            const double* row = grid->volatilities.data() + std::size_t (step) * LOCAL_VOLATILITY_GRID_POINTS;
+            const double volatility = std::max(0.0, row[node] + (position - node) * (row[node + 1] - row[node]) + volatilityShift);
+            const double variance = volatility * volatility * constants.dt;
+            state.logPrice += -variance / 2.0 + volatility * constants.sqrtDt * normal;
+            return variance;
+        }
+    };
+
+    HestonModel createHestonModel(const HestonParams& heston, double volatilityShift) {
+        // Vega moves the whole variance level: both the current and the long-run volatility
+        HestonModel model = { heston };
+        const double initialVolatility = std::sqrt(heston.initialVariance) + volatilityShift;
+        const double longRunVolatility = std::sqrt(heston.longRunVariance) + volatilityShift;
+        model.heston.initialVariance = initialVolatility * initialVolatility;
+        model.heston.longRunVariance = longRunVolatility * longRunVolatility;
+        return model;
+    }
+
+    SabrModel createSabrModel(const SabrParams& sabr, double spotPrice, double volatilityShift, double maturityRateIntegral) {
+        // alpha X^(beta - 1) is roughly the price's lognormal volatility, so vega shifts alpha by S0^(1 - beta) per unit
+        const double discountFactor = std::exp(-maturityRateIntegral);
+        const double alpha = sabr.alpha * std::pow(discountFactor, 1.0 - sabr.beta) + volatilityShift * std::pow(spotPrice, 1.0 - sabr.beta);
+        return { alpha, sabr.beta - 1.0, sabr.correlation, std::sqrt(1.0 - sabr.correlation * sabr.correlation), sabr.volatilityOfVolatility };
+    }
+
+    // Linear interpolation within the table and flat extrapolation beyond it, in both time and spot price
+    double interpolateLocalVolatility(const LocalVolatilityTable& table, double time, double spotPrice) {
+        auto locate = [](const std::vector<double>& nodes, double value, std::size_t& index, double& weight) {
+            index = 0;
+            weight = 0.0;
+            if (value <= nodes.front()) {
+                return;
+            }
+            if (value >= nodes.back()) {
+                index = nodes.size() - 1;
+                return;
+            }
+            index = std::size_t (std::upper_bound(nodes.begin(), nodes.end(), value) - nodes.begin()) - 1;
+            weight = (value - nodes[index]) / (nodes[index + 1] - nodes[index]);
+        };
+        std::size_t timeIndex, spotIndex;
+        double timeWeight, spotWeight;
+        locate(table.times, time, timeIndex, timeWeight);
+        locate(table.spotPrices, spotPrice, spotIndex, spotWeight);
+
+        const std::size_t numSpotPrices = table.spotPrices.size();
+        auto interpolateRow = [&](std::size_t row) {
+            const double* volatilities = table.volatilities.data() + row * numSpotPrices;
+            return spotWeight > 0.0 ? volatilities[spotIndex] + spotWeight * (volatilities[spotIndex + 1] - volatilities[spotIndex]) : volatilities[spotIndex];
+        };
+        return timeWeight > 0.0 ? interpolateRow(timeIndex) + timeWeight * (interpolateRow(timeIndex + 1) - interpolateRow(timeIndex)) : interpolateRow(timeIndex);
+    }
+
+    // One set of model parameters, rates and spot price to price under. The base run is one scenario; each Greek is a
+    // difference between two more that share every normal with it.
+    template <typename Model>
+    struct ModelScenario {
+        Model model;
+        typename Model::StepConstants stepConstants;
+        typename Model::StepConstants extensionConstants;
+        std::vector<double> integratedRates; // R(t) at every grid time, then at the theta-extended maturity
+        double logSpotPrice;
+    };
+
+    constexpr int BASE_SCENARIO = 0;
+    constexpr int SPOT_PRICE_UP_SCENARIO = 1;
+    constexpr int SPOT_PRICE_DOWN_SCENARIO = 2;
+    constexpr int VOLATILITY_UP_SCENARIO = 3;
+    constexpr int VOLATILITY_DOWN_SCENARIO = 4;
+    constexpr int RATE_UP_SCENARIO = 5;
+    constexpr int RATE_DOWN_SCENARIO = 6;
+
+    // Discounted payoffs of one leg of every path in a batch of PATH_BATCH_SIZE, and of the same legs continued to the
+    // theta-extended maturity when extendedPayoffs is not null. The normals are step-major, NORMALS_PER_STEP rows of
+    // PATH_BATCH_SIZE per step; sign is -1 for the antithetic legs.
+    template <typename Model>
+    void priceModelLegs(const OptionParams& params, const PayoffConstants& payoff, const TimeGrid& grid, const ModelScenario<Model>& scenario, const double* batchNormals, double sign, double* payoffs, double* extendedPayoffs) {
+        const bool tracksPath = isPathDependent(params.payoffStyle);
+        typename Model::State states[PATH_BATCH_SIZE];
+        PathState pathStates[PATH_BATCH_SIZE];
+        std::fill_n(states, PATH_BATCH_SIZE, scenario.model.createState(scenario.logSpotPrice));
+        if (tracksPath) {
+            std::fill_n(pathStates, PATH_BATCH_SIZE, createPathState(payoff, scenario.logSpotPrice));
+        }
+
+        auto advanceStep = [&](int step, const typename Model::StepConstants& constants, double dt) {
+            const double* normals = batchNormals + std::size_t (step) * Model::NORMALS_PER_STEP * PATH_BATCH_SIZE;
+            const double* secondNormals = normals + (Model::NORMALS_PER_STEP - 1) * PATH_BATCH_SIZE;
+            const double rateIntegral = scenario.integratedRates[step];
+            const double nextRateIntegral = scenario.integratedRates[step + 1];
+            for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                const double stepVariance = scenario.model.advance(states[lane], constants, step, rateIntegral, sign * normals[lane], sign * secondNormals[lane]);
+                if (tracksPath) {
+                    observeModelPrice(pathStates[lane], payoff, states[lane].logPrice + nextRateIntegral, stepVariance, dt);
+                }
+            }
+        };
+        auto evaluatePayoffs = [&](double rateIntegral, double* output) {
+            for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                const double legPayoff = tracksPath
+                 ? evaluatePathPayoff(params, payoff, pathStates[lane]).payoff : calculateVanillaPayoff(params, std::exp(states[lane].logPrice + rateIntegral));
+                output[lane] = std::exp(-rateIntegral) * legPayoff;
+            }
+        };
+
+        for (int step = 0; step < grid.numSteps; step++) {
+            advanceStep(step, scenario.stepConstants, grid.stepDt);
+        }
+        evaluatePayoffs(scenario.integratedRates[grid.numSteps], payoffs);
+        if (extendedPayoffs != nullptr) {
+            advanceStep(grid.numSteps, scenario.extensionConstants, grid.extensionDt);
+            evaluatePayoffs(scenario.integratedRates[grid.numSteps + 1], extendedPayoffs);
+        }
+    }
+
+    // createModel(volatilityShift, maturityRateIntegral) builds the model of a scenario
+    template <typename Model, typename CreateModel>
+    OptionResult simulateModel(const OptionParams& params, const SimulationSettings& settings, const TimeGrid& grid, const std::string& logText, CreateModel createModel) {
+        const auto startTime = std::chrono::steady_clock::now();
+        const PhaseClock clock = startPhaseClock();
+        const bool computeGreeks = settings.computeGreeks;
+        const bool antithetic = settings.varianceReduction.antithetic;
+        const RateCurve& rateCurve = settings.model.rateCurve;
+
+        auto createScenario = [&](double spotPriceFactor, double volatilityShift, double rateShift) {
+            ModelScenario<Model> scenario;
+            for (int step = 0; step <= grid.numSteps; step++) {
+                const double time = step * grid.stepDt;
+                scenario.integratedRates.push_back(calculateIntegratedRate(rateCurve, params.riskFreeRate, time) + rateShift * time);
+            }
+            const double extendedTime = grid.numSteps * grid.stepDt + grid.extensionDt;
+            scenario.integratedRates.push_back(calculateIntegratedRate(rateCurve, params.riskFreeRate, extendedTime) + rateShift * extendedTime);
+            scenario.model = createModel(volatilityShift, scenario.integratedRates[grid.numSteps]);
+            scenario.stepConstants = scenario.model.prepareStep(grid.stepDt);
+            scenario.extensionConstants = scenario.model.prepareStep(grid.extensionDt);
+            scenario.logSpotPrice = std::log(params.spotPrice * spotPriceFactor);
+            return scenario;
+        };
+        std::vector<ModelScenario<Model>> scenarios = { createScenario(1.0, 0.0, 0.0) };
+        if (computeGreeks) {
+            scenarios.push_back(createScenario(1.0 + MODEL_SPOT_PRICE_JUMP_FRACTION, 0.0, 0.0));
+            scenarios.push_back(createScenario(1.0 - MODEL_SPOT_PRICE_JUMP_FRACTION, 0.0, 0.0));
+            scenarios.push_back(createScenario(1.0, MODEL_VOLATILITY_JUMP, 0.0));
+            scenarios.push_back(createScenario(1.0, -MODEL_VOLATILITY_JUMP, 0.0));
+            scenarios.push_back(createScenario(1.0, 0.0, MODEL_RISK_FREE_RATE_JUMP));
+            scenarios.push_back(createScenario(1.0, 0.0, -MODEL_RISK_FREE_RATE_JUMP));
+        }
+        const int numScenarios = int (scenarios.size());
+        const PayoffConstants payoff = createPayoffConstants(params, false);
+
+        const int numSimulations = settings.numSimulations;
+        std::vector<std::vector<double>> scenarioSamples(numScenarios, std::vector<double>(numSimulations));
+        std::vector<double> extendedSamples(computeGreeks ? numSimulations : 0);
+        std::vector<double> crudeSamples(numSimulations);
+
+        // Every scenario reads the same normals, including the theta extension's
+        const int numNormals = (grid.numSteps + 1) * Model::NORMALS_PER_STEP;
+        const int numBatches = (numSimulations + PATH_BATCH_SIZE - 1) / PATH_BATCH_SIZE;
+        ProgressReporter progress(logText, numSimulations);
+        parallelFor(0, numBatches, settings.numThreads, [&](int, int firstBatch, int lastBatch) {
+            std::vector<double> pathNormals(numNormals);
+            std::vector<double> batchNormals(std::size_t (numNormals) * PATH_BATCH_SIZE);
+            for (int batch = firstBatch; batch < lastBatch; batch++) {
+                const int firstPath = batch * PATH_BATCH_SIZE;
+                const int lastPath = std::min(firstPath + PATH_BATCH_SIZE, numSimulations);
+                std::fill(batchNormals.begin(), batchNormals.end(), 0.0);
+                for (int i = firstPath; i < lastPath; i++) {
+                    generatePathNormals(settings.seed, std::uint64_t (i), 0, numNormals, pathNormals.data());
+                    for (int j = 0; j < numNormals; j++) {
+                        batchNormals[std::size_t (j) * PATH_BATCH_SIZE + (i - firstPath)] = pathNormals[j];
+                    }
+                }
+
+                for (int scenario = 0; scenario < numScenarios; scenario++) {
+                    double payoffs[PATH_BATCH_SIZE], antitheticPayoffs[PATH_BATCH_SIZE];
+                    double extendedPayoffs[PATH_BATCH_SIZE], antitheticExtendedPayoffs[PATH_BATCH_SIZE];
+                    const bool extends = computeGreeks && scenario == BASE_SCENARIO;
+                    priceModelLegs(params, payoff, grid, scenarios[scenario], batchNormals.data(), 1.0, payoffs, extends ? extendedPayoffs : nullptr);
+                    if (antithetic) {
+                        priceModelLegs(params, payoff, grid, scenarios[scenario], batchNormals.data(), -1.0, antitheticPayoffs, extends ? antitheticExtendedPayoffs : nullptr);
+                    }
+                    for (int i = firstPath; i < lastPath; i++) {
+                        const int lane = i - firstPath;
+                        scenarioSamples[scenario][i] = antithetic ? 0.5 * (payoffs[lane] + antitheticPayoffs[lane]) : payoffs[lane];
+                        if (scenario == BASE_SCENARIO) {
+                            crudeSamples[i] = payoffs[lane];
+                        }
+                        if (extends) {
+                            extendedSamples[i] = antithetic ? 0.5 * (extendedPayoffs[lane] + antitheticExtendedPayoffs[lane]) : extendedPayoffs[lane];
+                        }
+                    }
+                }
+                progress.addCompletedWork(lastPath - firstPath);
+            }
+        });
+        progress.finish();
+
+        PricingStatistics statistics;
+        const std::vector<double>& baseSamples = scenarioSamples[BASE_SCENARIO];
+        statistics.payoff = summarise(baseSamples);
+        statistics.crude = summarise(crudeSamples);
+        if (computeGreeks) {
+            const double spotPriceJump = MODEL_SPOT_PRICE_JUMP_FRACTION * params.spotPrice;
+            auto summariseDifference = [&](auto estimate) {
+                RunningStatistics differenceStatistics;
+                for (int i = 0; i < numSimulations; i++) {
+                    addSample(differenceStatistics, estimate(i));
+                }
+                return differenceStatistics;
+            };
+            const std::vector<double>& spotPriceUp = scenarioSamples[SPOT_PRICE_UP_SCENARIO];
+            const std::vector<double>& spotPriceDown = scenarioSamples[SPOT_PRICE_DOWN_SCENARIO];
+            statistics.delta = summariseDifference([&](int i) { return (spotPriceUp[i] - spotPriceDown[i]) / (2.0 * spotPriceJump); });
+            statistics.gamma = summariseDifference([&](int i) {
+                return (spotPriceUp[i] - 2.0 * baseSamples[i] + spotPriceDown[i]) / (spotPriceJump * spotPriceJump);
+            });
+            statistics.vega = summariseDifference([&](int i) {
+                return (scenarioSamples[VOLATILITY_UP_SCENARIO][i] - scenarioSamples[VOLATILITY_DOWN_SCENARIO][i]) / (2.0 * MODEL_VOLATILITY_JUMP);
+            });
+            statistics.rho = summariseDifference([&](int i) {
+                return (scenarioSamples[RATE_UP_SCENARIO][i] - scenarioSamples[RATE_DOWN_SCENARIO][i]) / (2.0 * MODEL_RISK_FREE_RATE_JUMP);
+            });
+            statistics.theta = summariseDifference([&](int i) { return -(extendedSamples[i] - baseSamples[i]) / TIME_TO_MATURITY_JUMP; });
+        }
+
+        PhaseStatistics phase = { "path simulation" };
+        phase.paths = numSimulations;
+        phase.steps = (long long) (numSimulations) * (grid.numSteps * numScenarios + (computeGreeks ? 1 : 0));
+        phase.randomDraws = (long long) (numSimulations) * numNormals;
+        phase.bytesAllocated = (long long) ((numScenarios + 2) * std::size_t (numSimulations) * sizeof(double));
+        stopPhaseClock(clock, phase);
+
+        const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        OptionResult result = createOptionResult(statistics, numSimulations, elapsedSeconds);
+        result.phases = { phase };
+        return result;
+    }
+
+    std::string describeLine(int lineNumber, const std::filesystem::path& inputPath) {
+        return "line " + std::to_string(lineNumber) + " of " + inputPath.string();
+    }
+
+    bool isIncreasing(const std::vector<double>& values) {
+        return std::adjacent_find(values.begin(), values.end(), std::greater_equal<double>()) == values.end();
+    }
+}
+
+double calculateIntegratedRate(const RateCurve& rateCurve, double flatRate, double time) {
+    if (rateCurve.times.empty()) {
+        return flatRate * time;
+    }
+    const std::vector<double>& times = rateCurve.times;
+    const std::vector<double>& zeroRates = rateCurve.zeroRates;
+    if (time >= times.back()) {
+        return zeroRates.back() * time;
+    }
+    // R(t) = z(t) t is linear between the nodes, starting from R(0) = 0
+    const std::size_t next = std::size_t (std::upper_bound(times.begin(), times.end(), time) - times.begin());
+    const double previousTime = next == 0 ? 0.0 : times[next - 1];
+    const double previousIntegral = next == 0 ? 0.0 : zeroRates[next - 1] * previousTime;
+    const double nextIntegral = zeroRates[next] * times[next];
+    return previousIntegral + (nextIntegral - previousIntegral) * (time - previousTime) / (times[next] - previousTime);
+}
+
+std::shared_ptr<const LocalVolatilityGrid> createLocalVolatilityGrid(const LocalVolatilityTable& table, int numSteps, double stepDt) {
+    LocalVolatilityGrid grid;
+    grid.firstLogPrice = std::log(table.spotPrices.front());
+    const double spacing = (std::log(table.spotPrices.back()) - grid.firstLogPrice) / (LOCAL_VOLATILITY_GRID_POINTS - 1);
+    grid.inverseSpacing = spacing > 0.0 ? 1.0 / spacing : 0.0;
+    grid.volatilities.resize(std::size_t (numSteps + 1) * LOCAL_VOLATILITY_GRID_POINTS);
+    for (int step = 0; step <= numSteps; step++) {
+        for (int node = 0; node < LOCAL_VOLATILITY_GRID_POINTS; node++) {
+            const double spotPrice = std::exp(grid.firstLogPrice + node * spacing);
+            grid.volatilities[std::size_t (step) * LOCAL_VOLATILITY_GRID_POINTS + node] = interpolateLocalVolatility(table, step * stepDt, spotPrice);
+        }
+    }
+    return std::make_shared<const LocalVolatilityGrid>(std::move(grid));
+}
+
+TimeGrid createModelTimeGrid(const OptionParams& params, int daysPerStep) {
+    const double numDays = params.timeToMaturity * NUM_YEARLY_WORKING_DAYS;
+    const int numSteps = std::max(1, int (std::ceil(numDays / std::max(daysPerStep, 1) - 1e-9)));
+    return { numSteps, params.timeToMaturity / numSteps, 1, TIME_TO_MATURITY_JUMP, false };
+}
+
+void validateModelSettings(const SimulationSettings& settings) {
+    const ModelSettings& model = settings.model;
+    if (model.type == ModelType::Heston) {
+        const HestonParams& heston = model.heston;
+        if (heston.initialVariance < 0.0 || heston.longRunVariance <= 0.0) {
+            throw std::runtime_error("the Heston initial variance must be non-negative and its long-run variance positive");
+        }
+        else if (heston.meanReversion <= 0.0 || heston.volatilityOfVariance <= 0.0) {
+            throw std::runtime_error("the Heston mean reversion and volatility of variance must be positive");
+        }
+        else if (std::abs(heston.correlation) > 1.0) {
+            throw std::runtime_error("the Heston correlation must be between -1 and 1");
+        }
+    }
+    else if (model.type == ModelType::Sabr) {
+        const SabrParams& sabr = model.sabr;
+        if (sabr.alpha <= 0.0 || sabr.volatilityOfVolatility < 0.0) {
+            throw std::runtime_error("the SABR alpha must be positive and its volatility of volatility non-negative");
+        }
+        else if (sabr.beta < 0.0 || sabr.beta > 1.0) {
+            throw std::runtime_error("the SABR beta must be between 0 and 1");
+        }
+        else if (std::abs(sabr.correlation) > 1.0) {
+            throw std::runtime_error("the SABR correlation must be between -1 and 1");
+        }
+    }
+    else if (model.type == ModelType::LocalVolatility) {
+        const LocalVolatilityTable& table = model.localVolatility;
+        if (table.times.empty() || table.spotPrices.empty() || table.volatilities.size() != table.times.size() * table.spotPrices.size()) {
+            throw std::runtime_error("the local volatility table must have a volatility for every time and spot price");
+        }
+        else if (!isIncreasing(table.times) || table.times.front() < 0.0 || !isIncreasing(table.spotPrices) || table.spotPrices.front() <= 0.0) {
+            throw std::runtime_error("the local volatility table's times and spot prices must be increasing and positive");
+        }
+        else if (*std::min_element(table.volatilities.begin(), table.volatilities.end()) < 0.0) {
+            throw std::runtime_error("the local volatilities must be non-negative");
+        }
+    }
+
+    const RateCurve& rateCurve = model.rateCurve;
+    if (rateCurve.times.size() != rateCurve.zeroRates.size() || (!rateCurve.times.empty() && (!isIncreasing(rateCurve.times) || rateCurve.times.front() <= 0.0))) {
+        throw std::runtime_error("the rate curve's times must be positive and increasing, with one rate each");
+    }
+
+    if (usesModelEngine(settings)) {
+        const VarianceReduction& varianceReduction = settings.varianceReduction;
+        if (settings.quasiRandom) {
+            throw std::runtime_error("--qmc is only supported by the flat-rate Black-Scholes model");
+        }
+        else if (varianceReduction.terminalPriceControl || varianceReduction.blackScholesControl || varianceReduction.geometricAsianControl) {
+            throw std::runtime_error("control variates are only supported by the flat-rate Black-Scholes model");
+        }
+        else if (varianceReduction.importanceSampling) {
+            throw std::runtime_error("--importance-sampling is only supported by the flat-rate Black-Scholes model");
+        }
+        else if (isAdaptive(settings)) {
+            throw std::runtime_error("adaptive path counts are only supported by the flat-rate Black-Scholes model");
+        }
+    }
+}
+
+OptionResult runModelSimulation(const OptionParams& params, const SimulationSettings& settings, std::string logText) {
+    const ModelSettings& model = settings.model;
+    const TimeGrid grid = createModelTimeGrid(params, params.payoffStyle == PayoffStyle::Barrier ? settings.barrierStepDays : 1);
+    switch (model.type) {
+        case ModelType::BlackScholes:
+            break;
+        case ModelType::Heston:
+            return simulateModel<HestonModel>(params, settings, grid, logText, [&](double volatilityShift, double) {
+                return createHestonModel(model.heston, volatilityShift);
+            });
+        case ModelType::Sabr:
+            return simulateModel<SabrModel>(params, settings, grid, logText, [&](double volatilityShift, double maturityRateIntegral) {
+                return createSabrModel(model.sabr, params.spotPrice, volatilityShift, maturityRateIntegral);
+            });
+        case ModelType::LocalVolatility: {
+            // Shared by every scenario, since vega shifts the surface rather than rebuilding it
+            const std::shared_ptr<const LocalVolatilityGrid> localVolatilityGrid = createLocalVolatilityGrid(model.localVolatility, grid.numSteps, grid.stepDt);
+            return simulateModel<LocalVolatilityModel>(params, settings, grid, logText, [&](double volatilityShift, double) {
+                return LocalVolatilityModel { localVolatilityGrid.get(), volatilityShift };
+            });
+        }
+    }
+    return simulateModel<BlackScholesModel>(params, settings, grid, logText, [&](double volatilityShift, double) {
+        return BlackScholesModel { params.volatility + volatilityShift };
+    });
+}
+
+LocalVolatilityTable readLocalVolatilityFile(const std::filesystem::path& inputPath) {
+    std::ifstream inputFile(inputPath);
+    if (!inputFile) {
+        throw std::runtime_error("could not open " + inputPath.string());
+    }
+
+    LocalVolatilityTable table;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(inputFile, line)) {
+        lineNumber++;
+        const std::vector<std::string> fields = splitCsvLine(line);
+        if (fields.empty() || (fields.size() == 1 && fields[0].empty())) {
+            continue;
+        }
+
+        if (table.spotPrices.empty()) {
+            for (std::size_t j = 1; j < fields.size(); j++) {
+                if (!isPositiveDouble(fields[j].c_str())) {
+                    throw std::runtime_error("the spot prices on " + describeLine(lineNumber, inputPath) + " must be positive doubles");
+                }
+                table.spotPrices.push_back(std::stod(fields[j]));
+            }
+            if (table.spotPrices.empty()) {
+                throw std::runtime_error(describeLine(lineNumber, inputPath) + " must list the spot prices of the table");
+            }
+            continue;
+        }
+
+        if (fields.size() != table.spotPrices.size() + 1) {
+            throw std::runtime_error(describeLine(lineNumber, inputPath) + " must have a time and one volatility per spot price");
+        }
+        for (const std::string& field : fields) {
+            if (!isNonNegativeDouble(field.c_str())) {
+                throw std::runtime_error("the time and volatilities on " + describeLine(lineNumber, inputPath) + " must be non-negative doubles");
+            }
+        }
+        table.times.push_back(std::stod(fields[0]));
+        for (std::size_t j = 1; j < fields.size(); j++) {
+            table.volatilities.push_back(std::stod(fields[j]) / 100.0);
+        }
+    }
+
+    if (table.times.empty()) {
+        throw std::runtime_error(inputPath.string() + " must have at least one row of local volatilities");
+    }
+    return table;
+}
+
+RateCurve readRateCurveFile(const std::filesystem::path& inputPath) {
+    std::ifstream inputFile(inputPath);
+    if (!inputFile) {
+        throw std::runtime_error("could not open " + inputPath.string());
+    }
+
+    RateCurve rateCurve;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(inputFile, line)) {
+        lineNumber++;
+        const std::vector<std::string> fields = splitCsvLine(line);
+        if (fields.empty() || (fields.size() == 1 && fields[0].empty())) {
+            continue;
+        }
+        if (lineNumber == 1 && !isNonNegativeDouble(fields[0].c_str())) {
+            continue;
+        }
+
+        if (fields.size() != 2) {
+            throw std::runtime_error(describeLine(lineNumber, inputPath) + " must be time,zeroRate");
+        }
+        else if (!isPositiveDouble(fields[0].c_str())) {
+            throw std::runtime_error("the time on " + describeLine(lineNumber, inputPath) + " must be a positive double");
+        }
+        else if (!isNonNegativeDouble(fields[1].c_str())) {
+            throw std::runtime_error("the zero rate on " + describeLine(lineNumber, inputPath) + " must be a non-negative double");
+        }
+        rateCurve.times.push_back(std::stod(fields[0]));
+        rateCurve.zeroRates.push_back(std::stod(fields[1]) / 100.0);
+    }
+
+    if (rateCurve.times.empty()) {
+        throw std::runtime_error(inputPath.string() + " must have at least one zero rate");
+    }
+    return rateCurve;
+}
@@ -1,47 +1,41 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
-#include <numeric>
-#include <random>
+#include <memory>
 #include <string>
+#include "Analytic.h"
+#include "Instrumentation.h"
+#include "LongstaffSchwartz.h"
+#include "MappedArray.h"
+#include "Models.h"
 #include "MonteCarlo.h"
+#include "Parallel.h"
+#include "PathPayoffs.h"
+#include "Sobol.h"
+#include "PathKernels.h"
 #include "Utils.h"
+#include "VarianceReduction.h"
 
-std::vector<std::vector<double>> generateRandomNormals(int numSimulations, int numSteps) {
-    std::vector<std::vector<double>> randomNormals(numSimulations, std::vector<double>(numSteps));
-    
-    // Initialising our random variable generator
-    const unsigned seed = unsigned int (std::chrono::system_clock::now().time_since_epoch().count());
-    std::default_random_engine generator(seed);
-    std::normal_distribution<double> distribution(0.0, 1.0);
-    
-    // We use the same random variables for our Greeks calculations
-    for (int i = 0; i < numSimulations; i++) {
-        for (int j = 0; j < numSteps; j++) {
-            const double Z = distribution(generator); // Z ~ N(0,1)
-            randomNormals[i][j] = Z;
-        }
-    }
-
-    return randomNormals;
-}
-
-std::tuple<double, double> simulatePath(const OptionParams& params, const std::vector<double>& randomNormals, std::string& graphData, bool graphPath) {
+std::tuple<double, double> simulatePath(const OptionParams& params, const double* randomNormals, int numSteps, double dt, double* pathPrices) {
     double price, antiPrice;
     price = antiPrice = params.spotPrice;
 
-    for (double Z : randomNormals) {
-        if (graphPath) {
-            graphData += std::to_string(price) + ",";
+    for (int j = 0; j < numSteps; j++) {
+        const double Z = randomNormals[j];
+        if (pathPrices != nullptr) {
+            pathPrices[j] = price;
         }
         price *= exp((params.riskFreeRate - (pow(params.volatility, 2) / 2.0))
-         * DT + params.volatility * sqrt(DT) * Z);
+         * dt + params.volatility * sqrt(dt) * Z);
         antiPrice *= exp((params.riskFreeRate - (pow(params.volatility, 2) / 2.0))
-         * DT + params.volatility * sqrt(DT) * -Z);
+         * dt + params.volatility * sqrt(dt) * -Z);
     }
 
-    if (graphPath) {
-        graphData += std::to_string(price) + "\n";
+    if (pathPrices != nullptr) {
+        pathPrices[numSteps] = price;
     }
 
     return std::make_tuple(price, antiPrice);
@@ -71,135 +65,667 @@ double calculatePayoff(const OptionParams& params, std::tuple<double, double> si
     return 0.5 * (payoff + antitheticPayoff);
 }
 
-std::vector<double> simulatePayoffs(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, bool graphPaths, std::string logText) {
-    int numSimulations = int (randomNormals.size());
-    std::vector<double> payoffSamples(numSimulations);
-    std::string graphData = "";
-    int percentageComplete = 0;
-
-    for (int i = 0; i < numSimulations; i++) {
-        if (percentageComplete < (int) (i) * 100 / numSimulations) {
-            percentageComplete = (i) * 100 / numSimulations;
-            std::cout << "\r" + logText + " (\033[33m" + std::to_string(percentageComplete) + "%\033[0m)";
-        }
-        std::tuple<double, double> finalPrices = simulatePath(params, randomNormals[i], graphData, i < NUM_GRAPHED_PATHS && graphPaths);
-        payoffSamples[i] = calculatePayoff(params, finalPrices);
+double calculatePayoffSlope(const OptionParams& params, double finalPrice) {
+    switch (params.optionType) {
+        case OptionType::Call:
+            return finalPrice > params.strikePrice ? 1.0 : 0.0;
+        case OptionType::Put:
+            return finalPrice < params.strikePrice ? -1.0 : 0.0;
     }
-    std::cout << "\r" + logText + " (\033[32m100%\033[0m)";
-    std::cout << std::endl;
+    return 0.0;
+}
 
-    if (graphPaths) {
-        std::filesystem::path outputDirectory = getRootDirectory() / "output";
-        std::filesystem::create_directories(outputDirectory);
-        std::filesystem::path graphDataFileName = outputDirectory / "graphData.csv";
-        std::ofstream graphDataFile(graphDataFileName);
-        graphDataFile << graphData;
-        graphDataFile.close();
-        runGraphPlotter();
+double calculateVanillaPayoff(const OptionParams& params, double price) {
+    switch (params.optionType) {
+        case OptionType::Call:
+            return price - params.strikePrice > 0.0 ? price - params.strikePrice : 0.0;
+        case OptionType::Put:
+            return params.strikePrice - price > 0.0 ? params.strikePrice - price : 0.0;
     }
+    return 0.0;
+}
 
-    return payoffSamples;
+double calculateDiscountedPayoff(const OptionParams& params, double finalPrice) {
+    return std::exp(-params.riskFreeRate * params.timeToMaturity) * calculateVanillaPayoff(params, finalPrice);
+}
+
+int calculateNumSteps(const OptionParams& params) {
+    return int (params.timeToMaturity * NUM_YEARLY_WORKING_DAYS);
 }
 
-double calculateStandardError(const std::vector<double>& payoffs, double averagePayoff) {
-    double squareSum = 0.0;
-    for (double payoff : payoffs) {
-        squareSum += (payoff - averagePayoff) * (payoff - averagePayoff);
+TimeGrid createSteppedTimeGrid(const OptionParams& params, int daysPerStep) {
+    const int numDays = calculateNumSteps(params);
+    // A calendar day is shorter than a working-day step and would usually round away, so theta's extra day is one
+    // step of its own rather than a whole number of DT steps
+    if (daysPerStep <= 1 || numDays == 0) {
+        return { numDays, DT, 1, TIME_TO_MATURITY_JUMP, false };
     }
-    const double sampleVariance = squareSum / (NUM_SIMULATIONS - 1);
-    const double estimatorVariance = sampleVariance / NUM_SIMULATIONS;
-    return sqrt(estimatorVariance);
+    const int numSteps = (numDays + daysPerStep - 1) / daysPerStep;
+    return { numSteps, numDays * DT / numSteps, 1, TIME_TO_MATURITY_JUMP, false };
 }
 
-std::tuple<double,double> calculateConfidenceInterval(double averagePayoff, double standardError) {
-    const double lowerBound = averagePayoff - (standardError * CONFIDENCE_BOUND_FACTOR);
-    const double upperBound = averagePayoff + (standardError * CONFIDENCE_BOUND_FACTOR);
-    return std::make_tuple(lowerBound, upperBound);
+TimeGrid createTerminalTimeGrid(const OptionParams& params) {
+    return { 1, params.timeToMaturity, 1, TIME_TO_MATURITY_JUMP, true };
 }
 
-std::tuple<double, double> calculateDeltaAndGamma(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice) {
-    const double spotPriceJump = params.spotPrice * 0.001;
-    OptionParams spotPriceUpOption = params;
-    spotPriceUpOption.spotPrice = params.spotPrice + spotPriceJump;
-    std::vector<double> spotPriceUpPayoffSamples = simulatePayoffs(spotPriceUpOption, randomNormals, false, "Calculating delta");
-    double averageSpotPriceUpPayoff = std::accumulate(spotPriceUpPayoffSamples.begin(), spotPriceUpPayoffSamples.end(), 0.0) / spotPriceUpPayoffSamples.size();
-    double delta = (averageSpotPriceUpPayoff - optionPrice) / spotPriceJump;
+TimeGrid createTimeGrid(const OptionParams& params, const SimulationSettings& settings) {
+    if (params.payoffStyle == PayoffStyle::Barrier) {
+        return createSteppedTimeGrid(params, settings.barrierStepDays);
+    }
+    if (settings.forceSteppedPaths || isPathDependent(params.payoffStyle)) {
+        return createSteppedTimeGrid(params, 1);
+    }
+    return createTerminalTimeGrid(params);
+}
 
-    OptionParams spotPriceDownOption = params;
-    spotPriceDownOption.spotPrice = params.spotPrice - spotPriceJump;
-    std::vector<double> spotPriceDownPayoffSamples = simulatePayoffs(spotPriceDownOption, randomNormals, false, "Calculating gamma");
-    double averageSpotPriceDownPayoff = std::accumulate(spotPriceDownPayoffSamples.begin(), spotPriceDownPayoffSamples.end(), 0.0) / spotPriceDownPayoffSamples.size();
-    double gamma = (averageSpotPriceUpPayoff - (2 * optionPrice) + averageSpotPriceDownPayoff) / pow(spotPriceJump, 2);
+int getNumGridSteps(const TimeGrid& grid) {
+    return grid.numSteps + grid.numExtensionSteps;
+}
 
-    return std::make_tuple(delta, gamma);
+RandomNormals createGridNormals(const TimeGrid& grid, const SimulationSettings& settings) {
+    if (settings.quasiRandom) {
+        return createQuasiRandomNormals(settings.numSimulations, grid.numSteps, getNumGridSteps(grid), settings.seed, settings.streamNormals, settings.numThreads, settings.singlePrecision);
+    }
+    return createRandomNormals(settings.numSimulations, getNumGridSteps(grid), settings.seed, settings.streamNormals, settings.numThreads, settings.singlePrecision);
 }
 
-double calculateVega(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice) {
-    OptionParams volatilityUpOption = params;
-    volatilityUpOption.volatility = params.volatility + VOLATILITY_JUMP;
-    std::vector<double> volatilityUpPayoffSamples = simulatePayoffs(volatilityUpOption, randomNormals, false, "Calculating vega ");
-    double averageVolatilityUpPayoff = std::accumulate(volatilityUpPayoffSamples.begin(), volatilityUpPayoffSamples.end(), 0.0) / volatilityUpPayoffSamples.size();
-    double vega = (averageVolatilityUpPayoff - optionPrice) / VOLATILITY_JUMP;
+namespace {
+    std::filesystem::path createOutputDirectory() {
+        const std::filesystem::path outputDirectory = getRootDirectory() / "output";
+        std::filesystem::create_directories(outputDirectory);
+        return outputDirectory;
+    }
+
+    // Maps output/paths.npy for the first numPaths paths of a run, numColumns prices each, which the workers then
+    // write in place. Returns null when no paths are graphed or the file cannot be written; like the plotter, a
+    // missing graph does not stop the pricing.
+    std::unique_ptr<MappedArray> createGraphFile(int numPaths, int numColumns) {
+        if (numPaths <= 0) {
+            return nullptr;
+        }
+        try {
+            const std::vector<std::size_t> shape = { std::size_t (numPaths), std::size_t (numColumns) };
+            return std::make_unique<MappedArray>(createOutputDirectory() / "paths.npy", shape);
+        }
+        catch (const std::exception& error) {
+            std::cerr << "Error: " << error.what() << "." << std::endl;
+            return nullptr;
+        }
+    }
+
+    void writePayoffFile(const std::vector<double>& payoffSamples) {
+        try {
+            MappedArray payoffFile(createOutputDirectory() / "payoffs.npy", { payoffSamples.size() });
+            std::copy(payoffSamples.begin(), payoffSamples.end(), payoffFile.data());
+        }
+        catch (const std::exception& error) {
+            std::cerr << "Error: " << error.what() << "." << std::endl;
+        }
+    }
+
+    double* getGraphedPathPrices(const std::unique_ptr<MappedArray>& graphFile, int numColumns, int pathIndex) {
+        const bool isGraphed = graphFile != nullptr && std::size_t (pathIndex + 1) * numColumns <= graphFile->size();
+        return isGraphed ? graphFile->data() + std::size_t (pathIndex) * numColumns : nullptr;
+    }
+
+    // Unmaps the graph file, so that every price is in it, before the plotter reads it
+    void finishGraphFile(std::unique_ptr<MappedArray>& graphFile) {
+        if (graphFile != nullptr) {
+            graphFile.reset();
+            runGraphPlotter();
+        }
+    }
+
+    // Scratch space and counters owned by a single worker thread
+    struct WorkerBuffers {
+        std::vector<double> pathNormals;
+        std::vector<double> batchNormals;
+        std::vector<float> singleBatchNormals;
+        long long randomDraws = 0;
+    };
+
+    // Totals over the workers of one simulateAllPaths call
+    struct WorkerTotals {
+        long long randomDraws;
+        long long bytesAllocated;
+    };
+
+    // Calls batchFunction(firstPath, lastPath, buffers) on consecutive batches of up to batchSize paths across the worker
+    // threads. Progress is reported under logText, unless it is empty.
+    template <typename BatchFunction>
+    WorkerTotals simulateAllPaths(int numSimulations, int batchSize, const std::string& logText, int numThreads, BatchFunction batchFunction) {
+        const int numBatches = (numSimulations + batchSize - 1) / batchSize;
+        const int numWorkers = std::min(resolveThreadCount(numThreads), std::max(numBatches, 1));
+        std::vector<WorkerBuffers> workerBuffers(numWorkers);
+        ProgressReporter progress(logText, numSimulations);
+
+        parallelFor(0, numBatches, numWorkers, [&](int worker, int firstBatch, int lastBatch) {
+            for (int batch = firstBatch; batch < lastBatch; batch++) {
+                const int firstPath = batch * batchSize;
+                const int lastPath = std::min(firstPath + batchSize, numSimulations);
+                batchFunction(firstPath, lastPath, workerBuffers[worker]);
+                progress.addCompletedWork(lastPath - firstPath);
+            }
+        });
+        progress.finish();
+
+        WorkerTotals totals = { 0, 0 };
+        for (const WorkerBuffers& buffers : workerBuffers) {
+            totals.randomDraws += buffers.randomDraws;
+            totals.bytesAllocated += (long long) ((buffers.pathNormals.capacity() + buffers.batchNormals.capacity()) * sizeof(double)
+             + buffers.singleBatchNormals.capacity() * sizeof(float));
+        }
+        return totals;
+    }
+
+    // Exact terminal sampling never visits the days in between, so a graphed path is filled in with a Brownian bridge
+    // pinned to its sampled terminal normal. The bridge's normals come from further along the path's own stream, and
+    // its numDays + 1 prices are written to pathPrices. Returns how many normals the bridge drew.
+    int writeBridgedGraphPath(const OptionParams& params, double terminalNormal, const RandomNormals& randomNormals, int pathIndex, int firstFreeStep, double* pathPrices) {
+        const int numDays = std::max(1, calculateNumSteps(params));
+        const double dt = params.timeToMaturity / numDays;
+        const double terminalBrownian = std::sqrt(params.timeToMaturity) * terminalNormal;
+        std::vector<double> bridgeNormals(numDays);
+        generatePathNormals(randomNormals.seed, std::uint64_t (pathIndex), firstFreeStep, numDays, bridgeNormals.data());
+
+        double brownian = 0.0;
+        pathPrices[0] = params.spotPrice;
+        for (int k = 1; k <= numDays; k++) {
+            const double remainingTime = params.timeToMaturity - (k - 1) * dt;
+            if (k == numDays) {
+                brownian = terminalBrownian;
+            }
+            else {
+                brownian += (terminalBrownian - brownian) * dt / remainingTime
+                 + std::sqrt(dt * (remainingTime - dt) / remainingTime) * bridgeNormals[k - 1];
+            }
+            const double time = k * dt;
+            pathPrices[k] = params.spotPrice * std::exp((params.riskFreeRate - (params.volatility * params.volatility / 2.0)) * time
+             + params.volatility * brownian);
+        }
+        return numDays;
+    }
+
+    // Discounted payoff of one leg of a path and its Greek estimators, from the leg's undiscounted payoff and its
+    // pathwise derivatives. With S(t) = S0 exp((r - sigma^2 / 2) t + sigma W(t)):
+    //   dS/dS0 = S / S0,  dS/dsigma = S (W - sigma t),  dS/dr = S t
+    // and gamma differentiates the pathwise delta by the likelihood ratio of the price at the end of the step that
+    // carries the spot into the path. scoreBrownianMotion is W at that time, scoreTime, so the score is W / (S0 sigma t).
+    // Payoffs that also see the spot itself, as a barrier's first bridge does, add their spotCurvature.
+    struct LegEstimates {
+        double payoff;
+        double delta;
+        double gamma;
+        double vega;
+        double rho;
+    };
+
+    LegEstimates estimateLeg(const OptionParams& params, const PayoffSensitivities& sensitivities, double scoreBrownianMotion, double scoreTime) {
+        const double discountFactor = std::exp(-params.riskFreeRate * params.timeToMaturity);
+        const double payoff = discountFactor * sensitivities.payoff;
+        const double variance = params.volatility * params.volatility * scoreTime;
 
-    return vega;
+        const double delta = discountFactor * sensitivities.logSpotPrice / params.spotPrice;
+        const double gamma = (variance > 0.0 ? delta / params.spotPrice * (params.volatility * scoreBrownianMotion / variance - 1.0) : 0.0)
+         + discountFactor * sensitivities.spotCurvature / (params.spotPrice * params.spotPrice);
+        const double vega = discountFactor * sensitivities.volatility;
+        const double rho = discountFactor * sensitivities.rate - params.timeToMaturity * payoff;
+        return { payoff, delta, gamma, vega, rho };
+    }
 }
 
-double calculateRho(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice) {
-    OptionParams riskFreeRateUpOption = params;
-    riskFreeRateUpOption.riskFreeRate = params.riskFreeRate + RISK_FREE_RATE_JUMP;
-    std::vector<double> riskFreeRateUpPayoffSamples = simulatePayoffs(riskFreeRateUpOption, randomNormals, false, "Calculating rho  ");
-    double averageRiskFreeRateUpPayoff = std::accumulate(riskFreeRateUpPayoffSamples.begin(), riskFreeRateUpPayoffSamples.end(), 0.0) / riskFreeRateUpPayoffSamples.size();
-    double rho = (averageRiskFreeRateUpPayoff - optionPrice) / RISK_FREE_RATE_JUMP;
+std::vector<double> simulatePayoffs(const OptionParams& params, const RandomNormals& randomNormals, bool graphPaths, std::string logText, int numThreads) {
+    const int numSteps = calculateNumSteps(params);
+    std::vector<double> payoffSamples(randomNormals.numSimulations);
+    std::unique_ptr<MappedArray> graphFile = createGraphFile(graphPaths ? std::min(NUM_GRAPHED_PATHS, randomNormals.numSimulations) : 0, numSteps + 1);
+
+    simulateAllPaths(randomNormals.numSimulations, 1, logText, numThreads, [&](int i, int, WorkerBuffers& buffers) {
+        const double* pathNormals = getPathNormals(randomNormals, i, numSteps, buffers.pathNormals);
+        std::tuple<double, double> finalPrices = simulatePath(params, pathNormals, numSteps, DT, getGraphedPathPrices(graphFile, numSteps + 1, i));
+        payoffSamples[i] = calculatePayoff(params, finalPrices);
+    });
+    finishGraphFile(graphFile);
+
+    return payoffSamples;
+}
 
-    return rho;
+PathConstants calculatePathConstants(const OptionParams& params, double dt) {
+    const double drift = (params.riskFreeRate - (params.volatility * params.volatility / 2.0)) * dt;
+    const double diffusion = params.volatility * std::sqrt(dt);
+    return { drift, diffusion };
 }
 
-double calculateTheta(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice) {
+FusedPayoffSamples simulateFusedPayoffs(const OptionParams& params, const TimeGrid& grid, const RandomNormals& randomNormals, bool graphPaths, std::string logText, const SimulationSettings& settings) {
     OptionParams timeToMaturityUpOption = params;
     timeToMaturityUpOption.timeToMaturity = params.timeToMaturity + TIME_TO_MATURITY_JUMP;
 
-    const int numSteps = int (randomNormals[0].size());
-    const int increasedNumSteps = int (NUM_YEARLY_WORKING_DAYS * timeToMaturityUpOption.timeToMaturity);
+    const VarianceReduction& varianceReduction = settings.varianceReduction;
+    validateControlVariates(params.payoffStyle, varianceReduction);
+    const int numSteps = grid.numSteps;
+    const int increasedNumSteps = getNumGridSteps(grid);
+    const double simulatedTime = numSteps * grid.stepDt;
+    const double shift = varianceReduction.importanceSampling ? calculateImportanceSamplingShift(params, numSteps, grid.stepDt) : 0.0;
+
+    // Importance sampling shifts every normal up to maturity by the same amount, which is just extra drift
+    const PathConstants unshifted = calculatePathConstants(params, grid.stepDt);
+    PathConstants base = unshifted;
+    base.drift += base.diffusion * shift;
+    const PathConstants baseExtension = calculatePathConstants(params, grid.extensionDt);
+    const LogPathKernel advanceLogPaths = getLogPathKernel();
+
+    // Path-dependent payoffs, and the geometric average control, need running state at every step rather than only
+    // the terminal price
+    const bool walksPathStates = isPathDependent(params.payoffStyle) || varianceReduction.geometricAsianControl;
 
-    std::vector<std::vector<double>> extraRandomNormals = generateRandomNormals(NUM_SIMULATIONS, increasedNumSteps - numSteps);
-    std::vector<std::vector<double>> randomNormalsExtended(NUM_SIMULATIONS, std::vector<double>(increasedNumSteps));
-    for (int i = 0; i < NUM_SIMULATIONS; i++) {
-        for (int j = 0; j < increasedNumSteps; j++) {
-            if (j < numSteps) {
-                randomNormalsExtended[i][j] = randomNormals[i][j];
+    // Running state stays in double, so only the log price kernels step in single precision
+    const bool singlePrecision = settings.singlePrecision && !walksPathStates;
+    const SinglePathConstants singleBase = { float (base.drift), float (base.diffusion) };
+    const SinglePathConstants singleBaseExtension = { float (baseExtension.drift), float (baseExtension.diffusion) };
+    const SingleLogPathKernel advanceLogReturns = getSingleLogPathKernel();
+    const PayoffConstants payoff = createPayoffConstants(params, varianceReduction.geometricAsianControl);
+    const bool scoresFirstStep = isPathDependent(params.payoffStyle);
+
+    const double logSpotPrice = std::log(params.spotPrice);
+    const double totalShift = numSteps * base.diffusion * shift;
+    const double sqrtStepDt = std::sqrt(grid.stepDt);
+    const double discountFactor = std::exp(-params.riskFreeRate * params.timeToMaturity);
+    const double timeToMaturityUpDiscountFactor = std::exp(-params.riskFreeRate * timeToMaturityUpOption.timeToMaturity);
+
+    const PhaseClock clock = startPhaseClock();
+    const int numSimulations = randomNormals.numSimulations;
+    FusedPayoffSamples samples;
+    samples.base.resize(numSimulations);
+    samples.crude.resize(numSimulations);
+    if (settings.computeGreeks) {
+        for (std::vector<double>* estimates : { &samples.delta, &samples.gamma, &samples.vega, &samples.rho, &samples.theta }) {
+            estimates->resize(numSimulations);
+        }
+    }
+    if (varianceReduction.terminalPriceControl) {
+        samples.terminalPriceControl.resize(numSimulations);
+    }
+    if (varianceReduction.blackScholesControl) {
+        samples.blackScholesControl.resize(numSimulations);
+    }
+    if (varianceReduction.geometricAsianControl) {
+        samples.geometricAsianControl.resize(numSimulations);
+    }
+
+    // Graphed paths on the terminal grid are bridged through every day in between
+    const int numGraphColumns = (grid.isTerminal ? std::max(1, calculateNumSteps(params)) : numSteps) + 1;
+    std::unique_ptr<MappedArray> graphFile = createGraphFile(graphPaths ? std::min(settings.numGraphedPaths, numSimulations) : 0, numGraphColumns);
+
+    const bool drawsNormals = isStreamed(randomNormals);
+    const WorkerTotals totals = simulateAllPaths(numSimulations, PATH_BATCH_SIZE, logText, settings.numThreads, [&](int firstPath, int lastPath, WorkerBuffers& buffers) {
+        // Lay the batch out step-major so each kernel step reads one contiguous row of PATH_BATCH_SIZE normals.
+        // Lanes past the last path stay zero and are never read back. Single-precision runs round the normals as they
+        // lay them out, and sum the rounded ones, so stored and streamed normals give the same paths.
+        if (singlePrecision) {
+            buffers.singleBatchNormals.assign(std::size_t (increasedNumSteps) * PATH_BATCH_SIZE, 0.0f);
+        }
+        else {
+            buffers.batchNormals.assign(std::size_t (increasedNumSteps) * PATH_BATCH_SIZE, 0.0);
+        }
+        double normalSums[PATH_BATCH_SIZE] = {};
+        for (int i = firstPath; i < lastPath; i++) {
+            // Single-precision rows are read as they are stored, except for graphed paths, which are drawn in double
+            double* pathPrices = getGraphedPathPrices(graphFile, numGraphColumns, i);
+            const float* singleNormals = singlePrecision && pathPrices == nullptr ? getStoredSinglePathNormals(randomNormals, i, increasedNumSteps) : nullptr;
+            const double* pathNormals = singleNormals == nullptr ? getPathNormals(randomNormals, i, increasedNumSteps, buffers.pathNormals) : nullptr;
+            buffers.randomDraws += drawsNormals ? increasedNumSteps : 0;
+            const int lane = i - firstPath;
+            for (int j = 0; j < increasedNumSteps; j++) {
+                const std::size_t index = std::size_t (j) * PATH_BATCH_SIZE + lane;
+                if (singleNormals != nullptr) {
+                    buffers.singleBatchNormals[index] = singleNormals[j];
+                }
+                else if (singlePrecision) {
+                    buffers.singleBatchNormals[index] = float (pathNormals[j]);
+                }
+                else {
+                    buffers.batchNormals[index] = pathNormals[j];
+                }
+            }
+            for (int j = 0; j < numSteps; j++) {
+                const std::size_t index = std::size_t (j) * PATH_BATCH_SIZE + lane;
+                normalSums[lane] += singlePrecision ? double (buffers.singleBatchNormals[index]) : buffers.batchNormals[index];
+            }
+            if (pathPrices != nullptr && grid.isTerminal) {
+                buffers.randomDraws += writeBridgedGraphPath(params, pathNormals[0], randomNormals, i, increasedNumSteps, pathPrices);
+            }
+            else if (pathPrices != nullptr) {
+                simulatePath(params, pathNormals, numSteps, grid.stepDt, pathPrices);
+            }
+        }
+
+        double logPrices[2][PATH_BATCH_SIZE];
+        double antiLogPrices[2][PATH_BATCH_SIZE];
+        PathState states[2][PATH_BATCH_SIZE];
+        PathState antiStates[2][PATH_BATCH_SIZE];
+        PathState crudeStates[PATH_BATCH_SIZE];
+        const std::size_t extensionOffset = std::size_t (numSteps) * PATH_BATCH_SIZE;
+        if (walksPathStates) {
+            std::fill(&states[0][0], &states[0][0] + PATH_BATCH_SIZE, createPathState(payoff, logSpotPrice));
+            std::copy_n(states[0], PATH_BATCH_SIZE, antiStates[0]);
+            std::copy_n(states[0], PATH_BATCH_SIZE, crudeStates);
+            advancePathStates(buffers.batchNormals.data(), numSteps, base, sqrtStepDt * shift, grid.stepDt, payoff, states[0], antiStates[0]);
+            if (settings.computeGreeks) {
+                std::copy_n(states[0], PATH_BATCH_SIZE, states[1]);
+                std::copy_n(antiStates[0], PATH_BATCH_SIZE, antiStates[1]);
+                advancePathStates(buffers.batchNormals.data() + extensionOffset, increasedNumSteps - numSteps, baseExtension, 0.0, grid.extensionDt, payoff, states[1], antiStates[1]);
+            }
+            // The crude estimator needs the unshifted path, which only differs when importance sampling is on
+            if (shift != 0.0) {
+                advancePathStates(buffers.batchNormals.data(), numSteps, unshifted, 0.0, grid.stepDt, payoff, crudeStates, nullptr);
+            }
+            for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                logPrices[0][lane] = states[0][lane].logPrice;
+                antiLogPrices[0][lane] = antiStates[0][lane].logPrice;
+            }
+        }
+        else if (singlePrecision) {
+            // Float log returns from the spot price, added to the double log spot price once at the end
+            float logReturns[2][PATH_BATCH_SIZE] = {};
+            float antiLogReturns[2][PATH_BATCH_SIZE] = {};
+            advanceLogReturns(buffers.singleBatchNormals.data(), numSteps, singleBase, logReturns[0], antiLogReturns[0]);
+            if (settings.computeGreeks) {
+                std::copy_n(logReturns[0], PATH_BATCH_SIZE, logReturns[1]);
+                std::copy_n(antiLogReturns[0], PATH_BATCH_SIZE, antiLogReturns[1]);
+                advanceLogReturns(buffers.singleBatchNormals.data() + extensionOffset, increasedNumSteps - numSteps, singleBaseExtension, logReturns[1], antiLogReturns[1]);
+            }
+            for (int leg = 0; leg < 2; leg++) {
+                for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                    logPrices[leg][lane] = logSpotPrice + logReturns[leg][lane];
+                    antiLogPrices[leg][lane] = logSpotPrice + antiLogReturns[leg][lane];
+                }
+            }
+        }
+        else {
+            std::fill(&logPrices[0][0], &logPrices[0][0] + 2 * PATH_BATCH_SIZE, logSpotPrice);
+            std::fill(&antiLogPrices[0][0], &antiLogPrices[0][0] + 2 * PATH_BATCH_SIZE, logSpotPrice);
+            advanceLogPaths(buffers.batchNormals.data(), numSteps, base, logPrices[0], antiLogPrices[0]);
+
+            // Theta carries the base state on along the same path for the extra steps of the longer maturity
+            if (settings.computeGreeks) {
+                std::copy_n(logPrices[0], PATH_BATCH_SIZE, logPrices[1]);
+                std::copy_n(antiLogPrices[0], PATH_BATCH_SIZE, antiLogPrices[1]);
+                advanceLogPaths(buffers.batchNormals.data() + extensionOffset, increasedNumSteps - numSteps, baseExtension, logPrices[1], antiLogPrices[1]);
+            }
+        }
+
+        for (int i = firstPath; i < lastPath; i++) {
+            const int lane = i - firstPath;
+            const double weight = shift != 0.0 ? calculateImportanceWeight(shift, normalSums[lane], numSteps) : 1.0;
+            const double antiWeight = shift != 0.0 ? calculateImportanceWeight(shift, -normalSums[lane], numSteps) : 1.0;
+
+            // Weighted estimate of the path, averaged with its antithetic twin when antithetic variates are on
+            auto combineLegs = [&](double estimate, double antitheticEstimate) {
+                return varianceReduction.antithetic ? 0.5 * (weight * estimate + antiWeight * antitheticEstimate) : weight * estimate;
+            };
+
+            const double finalPrice = std::exp(logPrices[0][lane]);
+            const double finalAntitheticPrice = std::exp(antiLogPrices[0][lane]);
+            const double brownianMotion = sqrtStepDt * (normalSums[lane] + numSteps * shift);
+            const double antitheticBrownianMotion = sqrtStepDt * (numSteps * shift - normalSums[lane]);
+            const PayoffSensitivities legPayoff = walksPathStates
+             ? evaluatePathPayoff(params, payoff, states[0][lane]) : evaluateTerminalPayoff(params, finalPrice, brownianMotion, simulatedTime);
+            const PayoffSensitivities antitheticLegPayoff = walksPathStates
+             ? evaluatePathPayoff(params, payoff, antiStates[0][lane]) : evaluateTerminalPayoff(params, finalAntitheticPrice, antitheticBrownianMotion, simulatedTime);
+
+            if (!settings.computeGreeks) {
+                samples.base[i] = combineLegs(discountFactor * legPayoff.payoff, discountFactor * antitheticLegPayoff.payoff);
+            }
+            else {
+                // Path-dependent payoffs score the first step; the first normal is the path's first row of the batch,
+                // which single-precision runs never fill as they only step path-independent payoffs
+                const double firstNormal = scoresFirstStep ? buffers.batchNormals[lane] : 0.0;
+                const LegEstimates leg = scoresFirstStep
+                 ? estimateLeg(params, legPayoff, sqrtStepDt * (firstNormal + shift), grid.stepDt) : estimateLeg(params, legPayoff, brownianMotion, simulatedTime);
+                const LegEstimates antitheticLeg = scoresFirstStep
+                 ? estimateLeg(params, antitheticLegPayoff, sqrtStepDt * (shift - firstNormal), grid.stepDt) : estimateLeg(params, antitheticLegPayoff, antitheticBrownianMotion, simulatedTime);
+
+                samples.base[i] = combineLegs(leg.payoff, antitheticLeg.payoff);
+                samples.delta[i] = combineLegs(leg.delta, antitheticLeg.delta);
+                samples.gamma[i] = combineLegs(leg.gamma, antitheticLeg.gamma);
+                samples.vega[i] = combineLegs(leg.vega, antitheticLeg.vega);
+                samples.rho[i] = combineLegs(leg.rho, antitheticLeg.rho);
+                const double timeToMaturityUpPayoff = walksPathStates
+                 ? combineLegs(timeToMaturityUpDiscountFactor * evaluatePathPayoff(timeToMaturityUpOption, payoff, states[1][lane]).payoff,
+                    timeToMaturityUpDiscountFactor * evaluatePathPayoff(timeToMaturityUpOption, payoff, antiStates[1][lane]).payoff)
+                 : combineLegs(calculateDiscountedPayoff(timeToMaturityUpOption, std::exp(logPrices[1][lane])),
+                    calculateDiscountedPayoff(timeToMaturityUpOption, std::exp(antiLogPrices[1][lane])));
+                samples.theta[i] = -(timeToMaturityUpPayoff - samples.base[i]) / TIME_TO_MATURITY_JUMP;
+            }
+
+            // The crude estimator uses the first leg alone, without its importance sampling shift
+            if (!walksPathStates) {
+                samples.crude[i] = calculateDiscountedPayoff(params, std::exp(logPrices[0][lane] - totalShift));
             }
             else {
-                randomNormalsExtended[i][j] = extraRandomNormals[i][j - numSteps];
+                samples.crude[i] = discountFactor * (shift != 0.0 ? evaluatePathPayoff(params, payoff, crudeStates[lane]).payoff : legPayoff.payoff);
+            }
+            if (varianceReduction.terminalPriceControl) {
+                samples.terminalPriceControl[i] = combineLegs(discountFactor * finalPrice, discountFactor * finalAntitheticPrice);
+            }
+            if (varianceReduction.blackScholesControl) {
+                samples.blackScholesControl[i] = combineLegs(calculateDiscountedPayoff(params, finalPrice), calculateDiscountedPayoff(params, finalAntitheticPrice));
+            }
+            if (varianceReduction.geometricAsianControl) {
+                samples.geometricAsianControl[i] = combineLegs(discountFactor * calculateGeometricAveragePayoff(params, states[0][lane]),
+                 discountFactor * calculateGeometricAveragePayoff(params, antiStates[0][lane]));
             }
         }
+    });
+
+    finishGraphFile(graphFile);
+
+    // Base pricing and every Greek share this one walk, so it is a single phase
+    samples.phase.name = "path simulation";
+    samples.phase.paths = numSimulations;
+    samples.phase.steps = (long long) (numSimulations) * (settings.computeGreeks ? increasedNumSteps : numSteps);
+    samples.phase.randomDraws = totals.randomDraws;
+    samples.phase.bytesAllocated = totals.bytesAllocated;
+    for (const std::vector<double>* estimates : { &samples.base, &samples.delta, &samples.gamma, &samples.vega, &samples.rho,
+     &samples.theta, &samples.crude, &samples.terminalPriceControl, &samples.blackScholesControl, &samples.geometricAsianControl }) {
+        samples.phase.bytesAllocated += (long long) (estimates->capacity() * sizeof(double));
     }
+    stopPhaseClock(clock, samples.phase);
+
+    return samples;
+}
 
-    std::vector<double> timeToMaturityUpPayoffSamples = simulatePayoffs(timeToMaturityUpOption, randomNormalsExtended, false, "Calculating theta");
-    double averageTimeToMaturityUpPayoff = std::accumulate(timeToMaturityUpPayoffSamples.begin(), timeToMaturityUpPayoffSamples.end(), 0.0) / timeToMaturityUpPayoffSamples.size();
-    double theta = -(averageTimeToMaturityUpPayoff - optionPrice) / TIME_TO_MATURITY_JUMP;
+std::vector<ControlVariate> createControlVariates(const OptionParams& params, const TimeGrid& grid, const FusedPayoffSamples& samples) {
+    // The grid reaches numSteps * stepDt, which the daily grid can leave slightly short of the maturity; the payoffs
+    // are still discounted over the full maturity
+    const double simulatedTime = grid.numSteps * grid.stepDt;
+    const double extraDiscountFactor = std::exp(-params.riskFreeRate * (params.timeToMaturity - simulatedTime));
+    std::vector<ControlVariate> controls;
 
-    return theta;
+    if (!samples.terminalPriceControl.empty()) {
+        controls.push_back({ samples.terminalPriceControl, params.spotPrice * extraDiscountFactor });
+    }
+    if (!samples.blackScholesControl.empty()) {
+        OptionParams simulatedOption = params;
+        simulatedOption.timeToMaturity = simulatedTime;
+        controls.push_back({ samples.blackScholesControl, calculateBlackScholesPrice(simulatedOption) * extraDiscountFactor });
+    }
+    if (!samples.geometricAsianControl.empty()) {
+        controls.push_back({ samples.geometricAsianControl, calculateGeometricAsianPrice(params, grid.numSteps, grid.stepDt) });
+    }
+    return controls;
 }
 
-Greeks calculateGreeks(const OptionParams& params, const std::vector<std::vector<double>>& randomNormals, double optionPrice) {
-    double delta;
-    double gamma;
-    std::tie(delta, gamma) = calculateDeltaAndGamma(params, randomNormals, optionPrice);
-    const double vega = calculateVega(params, randomNormals, optionPrice);
-    const double rho = calculateRho(params, randomNormals, optionPrice);
-    const double theta = calculateTheta(params, randomNormals, optionPrice);
-    return { delta, gamma, vega, rho, theta };
+void accumulateSamples(RunningStatistics& statistics, const std::vector<double>& samples, const RandomNormals& randomNormals) {
+    if (!randomNormals.quasiRandom) {
+        mergeStatistics(statistics, summarise(samples));
+        return;
+    }
+    const std::size_t pointsPerReplicate = std::size_t (randomNormals.quasiRandom->pointsPerReplicate);
+    for (std::size_t first = 0; first < samples.size(); first += pointsPerReplicate) {
+        const std::size_t last = std::min(first + pointsPerReplicate, samples.size());
+        addSample(statistics, summarise(samples.data() + first, last - first).mean);
+    }
 }
 
-OptionResult runMonteCarloSimulation(const OptionParams& params) {
-    const int numSteps = int (params.timeToMaturity * NUM_YEARLY_WORKING_DAYS);
-    std::vector<std::vector<double>> randomNormals = generateRandomNormals(NUM_SIMULATIONS, numSteps);
-    std::vector<double> payoffSamples = simulatePayoffs(params, randomNormals, true, "Simulating paths ");
+void accumulatePricingStatistics(PricingStatistics& statistics, const FusedPayoffSamples& samples, const std::vector<double>& payoffSamples, const RandomNormals& randomNormals) {
+    accumulateSamples(statistics.payoff, payoffSamples, randomNormals);
+    accumulateSamples(statistics.delta, samples.delta, randomNormals);
+    accumulateSamples(statistics.gamma, samples.gamma, randomNormals);
+    accumulateSamples(statistics.vega, samples.vega, randomNormals);
+    accumulateSamples(statistics.rho, samples.rho, randomNormals);
+    accumulateSamples(statistics.theta, samples.theta, randomNormals);
+
+    // The crude estimator stands for plain Monte Carlo, so it is always summarised path by path
+    mergeStatistics(statistics.crude, summarise(samples.crude));
+}
 
-    const double averagePayoff = std::accumulate(payoffSamples.begin(), payoffSamples.end(), 0.0) / payoffSamples.size();
-    const double standardError = calculateStandardError(payoffSamples, averagePayoff);
+void mergePricingStatistics(PricingStatistics& statistics, const PricingStatistics& other) {
+    mergeStatistics(statistics.payoff, other.payoff);
+    mergeStatistics(statistics.crude, other.crude);
+    mergeStatistics(statistics.delta, other.delta);
+    mergeStatistics(statistics.gamma, other.gamma);
+    mergeStatistics(statistics.vega, other.vega);
+    mergeStatistics(statistics.rho, other.rho);
+    mergeStatistics(statistics.theta, other.theta);
+}
+
+OptionResult createOptionResult(const PricingStatistics& statistics, int numPaths, double elapsedSeconds) {
+    const double averagePayoff = statistics.payoff.mean;
+    const double standardError = calculateStandardError(statistics.payoff);
     const std::tuple<double, double> confidenceInterval = calculateConfidenceInterval(averagePayoff, standardError);
-    const Greeks greeks = calculateGreeks(params, randomNormals, averagePayoff);
+    const Greeks greeks = { statistics.delta.mean, statistics.gamma.mean, statistics.vega.mean, statistics.rho.mean, statistics.theta.mean };
+    const Greeks greekStandardErrors = { calculateStandardError(statistics.delta), calculateStandardError(statistics.gamma),
+     calculateStandardError(statistics.vega), calculateStandardError(statistics.rho), calculateStandardError(statistics.theta) };
+    const double varianceReductionFactor = calculateVarianceReductionFactor(calculateStandardError(statistics.crude), standardError);
+
+    return { averagePayoff, standardError, confidenceInterval, greeks, greekStandardErrors, varianceReductionFactor, numPaths, elapsedSeconds, {} };
+}
+
+double calculateStandardError(const std::vector<double>& payoffs) {
+    return calculateStandardError(summarise(payoffs));
+}
+
+std::tuple<double,double> calculateConfidenceInterval(double averagePayoff, double standardError) {
+    const double lowerBound = averagePayoff - (standardError * CONFIDENCE_BOUND_FACTOR);
+    const double upperBound = averagePayoff + (standardError * CONFIDENCE_BOUND_FACTOR);
+    return std::make_tuple(lowerBound, upperBound);
+}
+
+OptionResult runMonteCarloSimulation(const OptionParams& params, const TimeGrid& grid, const RandomNormals& randomNormals, bool graphPaths, std::string logText, const SimulationSettings& settings) {
+    const auto startTime = std::chrono::steady_clock::now();
+    const FusedPayoffSamples samples = simulateFusedPayoffs(params, grid, randomNormals, graphPaths, logText, settings);
+
+    // Control variates only sharpen the price; the Greek estimators are left as they are
+    const PhaseClock clock = startPhaseClock();
+    const std::vector<ControlVariate> controls = createControlVariates(params, grid, samples);
+    const std::vector<double> payoffSamples = controls.empty()
+     ? samples.base : applyControlVariates(samples.base, controls, estimateControlVariateCoefficients(samples.base, controls));
+
+    PricingStatistics statistics;
+    accumulatePricingStatistics(statistics, samples, payoffSamples, randomNormals);
+    PhaseStatistics estimatorPhase = { "estimators" };
+    estimatorPhase.paths = randomNormals.numSimulations;
+    estimatorPhase.bytesAllocated = controls.empty() ? 0 : (long long) (payoffSamples.capacity() * sizeof(double));
+    stopPhaseClock(clock, estimatorPhase);
+
+    const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    OptionResult result = createOptionResult(statistics, randomNormals.numSimulations, elapsedSeconds);
+    result.phases = { samples.phase, estimatorPhase };
+
+    // Runs that graph their paths are the ones run from the command line, which may also keep the payoffs
+    if (graphPaths && settings.dumpPayoffs) {
+        writePayoffFile(payoffSamples);
+    }
+    return result;
+}
+
+OptionResult runAdaptiveMonteCarloSimulation(const OptionParams& params, const TimeGrid& grid, bool graphPaths, std::string logText, const SimulationSettings& settings) {
+    const auto startTime = std::chrono::steady_clock::now();
+    const int chunkSize = std::min(ADAPTIVE_CHUNK_SIZE, settings.maxSimulations);
+
+    // Streamed normals cost nothing to set up, so every chunk is a window onto one long run
+    RandomNormals randomNormals = settings.quasiRandom
+     ? createQuasiRandomNormals(chunkSize * NUM_QMC_REPLICATES, grid.numSteps, getNumGridSteps(grid), settings.seed, true, settings.numThreads, false)
+     : createRandomNormals(chunkSize, getNumGridSteps(grid), settings.seed, true, settings.numThreads, false);
+    randomNormals.numSimulations = chunkSize;
+
+    PricingStatistics statistics;
+    std::vector<PhaseStatistics> phases;
+    std::vector<double> coefficients;
+    int numChunks = 0;
+    double elapsedSeconds = 0.0;
+    bool finished = false;
+
+    while (!finished) {
+        randomNormals.firstPath = numChunks * chunkSize;
+        const FusedPayoffSamples samples = simulateFusedPayoffs(params, grid, randomNormals, graphPaths && numChunks == 0, "", settings);
+
+        addPhaseStatistics(phases, samples.phase);
+
+        const PhaseClock clock = startPhaseClock();
+        const std::vector<ControlVariate> controls = createControlVariates(params, grid, samples);
+        if (numChunks == 0 && !controls.empty()) {
+            coefficients = estimateControlVariateCoefficients(samples.base, controls);
+        }
+        const std::vector<double> payoffSamples = controls.empty() ? samples.base : applyControlVariates(samples.base, controls, coefficients);
+        accumulatePricingStatistics(statistics, samples, payoffSamples, randomNormals);
+        PhaseStatistics estimatorPhase = { "estimators" };
+        estimatorPhase.paths = chunkSize;
+        estimatorPhase.bytesAllocated = controls.empty() ? 0 : (long long) (payoffSamples.capacity() * sizeof(double));
+        stopPhaseClock(clock, estimatorPhase);
+        addPhaseStatistics(phases, estimatorPhase);
+        numChunks++;
+
+        // A quasi-random chunk is a single replicate, and the spread of a handful of replicate means is too noisy to
+        // stop on, so the tolerance is only tested once there are as many replicates as a fixed-size run uses
+        const double standardError = calculateStandardError(statistics.payoff);
+        elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        const long long minSamples = settings.quasiRandom ? NUM_QMC_REPLICATES : 2;
+        const bool converged = settings.targetStandardError > 0.0 && statistics.payoff.count >= minSamples && standardError <= settings.targetStandardError;
+
+        // Stop early rather than start a chunk that would overrun the budget
+        const double chunkSeconds = elapsedSeconds / numChunks;
+        const bool outOfTime = settings.timeBudgetSeconds > 0.0 && elapsedSeconds + chunkSeconds > settings.timeBudgetSeconds;
+        const bool outOfPaths = (long long) (numChunks + 1) * chunkSize > settings.maxSimulations;
+        finished = converged || outOfTime || outOfPaths;
+
+        if (!logText.empty()) {
+            const std::string colour = finished ? "\033[32m" : "\033[33m";
+            std::cout << "\r" + logText + " (" + colour + std::to_string(numChunks * chunkSize) + " paths\033[0m)" << std::flush;
+        }
+    }
+    if (!logText.empty()) {
+        std::cout << std::endl;
+    }
+
+    OptionResult result = createOptionResult(statistics, numChunks * chunkSize, elapsedSeconds);
+    result.phases = phases;
+    return result;
+}
+
+OptionResult runMonteCarloSimulation(const OptionParams& params, const SimulationSettings& settings) {
+    if (settings.earlyExercise.style != ExerciseStyle::European) {
+        return runLongstaffSchwartzSimulation(params, settings, "Simulating paths ");
+    }
+    if (usesModelEngine(settings)) {
+        return runModelSimulation(params, settings, "Simulating paths ");
+    }
+    const TimeGrid grid = createTimeGrid(params, settings);
+    if (isAdaptive(settings)) {
+        return runAdaptiveMonteCarloSimulation(params, grid, true, "Simulating paths ", settings);
+    }
+    const PhaseClock clock = startPhaseClock();
+    const RandomNormals randomNormals = createGridNormals(grid, settings);
+    PhaseStatistics normalPhase = { "normal generation" };
+    normalPhase.paths = randomNormals.numSimulations;
+    if (!isStreamed(randomNormals)) {
+        normalPhase.randomDraws = (long long) (randomNormals.numSimulations) * randomNormals.numSteps;
+        normalPhase.bytesAllocated = (long long) (getStoredNormalBytes(randomNormals));
+    }
+    stopPhaseClock(clock, normalPhase);
 
-    return { averagePayoff, standardError, confidenceInterval, greeks };
+    OptionResult result = runMonteCarloSimulation(params, grid, randomNormals, true, "Simulating paths ", settings);
+    result.phases.insert(result.phases.begin(), normalPhase);
+    result.elapsedSeconds += normalPhase.wallSeconds;
+    return result;
 }
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include "Instrumentation.h"
+#include "Models.h"
+#include "MonteCarlo.h"
+#include "MultiAsset.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "Utils.h"
+
+namespace {
+    constexpr double CORRELATION_TOLERANCE = 1e-12;
+
+    std::shared_ptr<const CorrelationFactor> factoriseCorrelations(const std::vector<double>& correlations, int numAssets) {
+        if (numAssets <= 0 || int (correlations.size()) != numAssets * numAssets) {
+            throw std::runtime_error("the correlation matrix must have one row and one column per asset");
+        }
+        for (int i = 0; i < numAssets; i++) {
+            if (std::abs(correlations[i * numAssets + i] - 1.0) > CORRELATION_TOLERANCE) {
+                throw std::runtime_error("every asset must have a correlation of 1 with itself");
+            }
+            for (int j = 0; j < i; j++) {
+                if (std::abs(correlations[i * numAssets + j] - correlations[j * numAssets + i]) > CORRELATION_TOLERANCE) {
+                    throw std::runtime_error("the correlation matrix must be symmetric");
+                }
+            }
+        }
+
+        CorrelationFactor factor = { numAssets, std::vector<double>(std::size_t (numAssets) * numAssets, 0.0) };
+        std::vector<double>& lower = factor.lower;
+        for (int i = 0; i < numAssets; i++) {
+            for (int j = 0; j <= i; j++) {
+                double sum = correlations[i * numAssets + j];
+                for (int k = 0; k < j; k++) {
+                    sum -= lower[i * numAssets + k] * lower[j * numAssets + k];
+                }
+                if (i == j) {
+                    if (sum < -CORRELATION_TOLERANCE) {
+                        throw std::runtime_error("the correlation matrix must be positive semidefinite");
+                    }
+                    lower[i * numAssets + i] = std::sqrt(std::max(sum, 0.0));
+                }
+                else if (lower[j * numAssets + j] > CORRELATION_TOLERANCE) {
+                    lower[i * numAssets + j] = sum / lower[j * numAssets + j];
+                }
+                // A zero pivot means asset j is a combination of the assets before it, so it adds no new factor, but
+                // then asset i can only be correlated with it through those assets
+                else if (std::abs(sum) > CORRELATION_TOLERANCE) {
+                    throw std::runtime_error("the correlation matrix must be positive semidefinite");
+                }
+            }
+        }
+        return std::make_shared<const CorrelationFactor>(std::move(factor));
+    }
+
+    // Derivative of the payoff statistic (basket value, or the best or worst price) with respect to each price
+    double calculateStatistic(const MultiAssetParams& params, const double* prices, double* gradient) {
+        const int numAssets = int (params.spotPrices.size());
+        std::fill(gradient, gradient + numAssets, 0.0);
+        if (params.payoff == MultiAssetPayoff::Basket) {
+            double basket = 0.0;
+            for (int a = 0; a < numAssets; a++) {
+                basket += params.weights[a] * prices[a];
+                gradient[a] = params.weights[a];
+            }
+            return basket;
+        }
+
+        int extremeAsset = 0;
+        for (int a = 1; a < numAssets; a++) {
+            const bool isBetter = params.payoff == MultiAssetPayoff::BestOf ? prices[a] > prices[extremeAsset] : prices[a] < prices[extremeAsset];
+            if (isBetter) {
+                extremeAsset = a;
+            }
+        }
+        gradient[extremeAsset] = 1.0;
+        return prices[extremeAsset];
+    }
+
+    const char* getMultiAssetPayoffName(MultiAssetPayoff payoff) {
+        switch (payoff) {
+            case MultiAssetPayoff::Basket:
+                return "Basket";
+            case MultiAssetPayoff::BestOf:
+                return "BestOf";
+            case MultiAssetPayoff::WorstOf:
+                return "WorstOf";
+        }
+        return "Basket";
+    }
+
+    std::string describeLine(int lineNumber) {
+        return "line " + std::to_string(lineNumber) + " of the multi-asset file";
+    }
+
+    void validateMultiAssetSettings(const SimulationSettings& settings) {
+        const VarianceReduction& varianceReduction = settings.varianceReduction;
+        if (usesModelEngine(settings) || settings.earlyExercise.style != ExerciseStyle::European) {
+            throw std::runtime_error("multi-asset options are only supported for European exercise under the flat-rate Black-Scholes model");
+        }
+        else if (settings.quasiRandom || settings.singlePrecision || isAdaptive(settings)) {
+            throw std::runtime_error("multi-asset options do not support --qmc, --single-precision or adaptive path counts");
+        }
+        else if (varianceReduction.terminalPriceControl || varianceReduction.blackScholesControl
+         || varianceReduction.geometricAsianControl || varianceReduction.importanceSampling) {
+            throw std::runtime_error("multi-asset options do not support control variates or importance sampling");
+        }
+        else if (hasScenarioGrid(settings) || isSharded(settings) || settings.dumpPayoffs) {
+            throw std::runtime_error("multi-asset options do not support scenario ladders, sharding or --dump-payoffs");
+        }
+        else if (settings.outputStatistics || !settings.statisticsJsonPath.empty() || settings.barrierStepDays != 1) {
+            throw std::runtime_error("multi-asset options do not support --stats, --stats-json or --barrier-step-days");
+        }
+    }
+}
+
+std::shared_ptr<const CorrelationFactor> getCorrelationFactor(const std::vector<double>& correlations, int numAssets) {
+    static std::mutex cacheMutex;
+    static std::map<std::vector<double>, std::shared_ptr<const CorrelationFactor>> cachedFactors;
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        const auto cached = cachedFactors.find(correlations);
+        if (cached != cachedFactors.end() && cached->second->numAssets == numAssets) {
+            return cached->second;
+        }
+    }
+
+    // Factorise outside the lock; two threads racing on a new matrix just both compute the same factor
+    const std::shared_ptr<const CorrelationFactor> factor = factoriseCorrelations(correlations, numAssets);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (int (cachedFactors.size()) >= MAX_CACHED_CORRELATION_FACTORS) {
+        cachedFactors.clear();
+    }
+    cachedFactors[correlations] = factor;
+    return factor;
+}
+
+void correlateNormals(const CorrelationFactor& factor, const double* normals, double* increments) {
+    const int numAssets = factor.numAssets;
+    for (int a = 0; a < numAssets; a++) {
+        const double* row = factor.lower.data() + std::size_t (a) * numAssets;
+        double* output = increments + std::size_t (a) * MULTI_ASSET_BATCH_SIZE;
+        std::fill(output, output + MULTI_ASSET_BATCH_SIZE, 0.0);
+        for (int j = 0; j <= a; j++) {
+            const double* input = normals + std::size_t (j) * MULTI_ASSET_BATCH_SIZE;
+            for (int lane = 0; lane < MULTI_ASSET_BATCH_SIZE; lane++) {
+                output[lane] += row[j] * input[lane];
+            }
+        }
+    }
+}
+
+MultiAssetResult runMultiAssetSimulation(const MultiAssetParams& params, const SimulationSettings& settings, std::string logText) {
+    validateMultiAssetSettings(settings);
+    const auto startTime = std::chrono::steady_clock::now();
+    const int numAssets = int (params.spotPrices.size());
+    const std::shared_ptr<const CorrelationFactor> factor = getCorrelationFactor(params.correlations, numAssets);
+
+    // Terminal prices are exact in one step; stepping daily is only there to match the single-asset --stepped mode
+    const int numDays = int (params.timeToMaturity * NUM_YEARLY_WORKING_DAYS);
+    const bool stepped = settings.forceSteppedPaths && numDays > 0;
+    const int numSteps = stepped ? numDays : 1;
+    const double stepDt = stepped ? DT : params.timeToMaturity;
+    const double simulatedTime = numSteps * stepDt;
+    const double sqrtStepDt = std::sqrt(stepDt);
+    const double discountFactor = std::exp(-params.riskFreeRate * params.timeToMaturity);
+
+    std::vector<double> drifts(numAssets);
+    std::vector<double> diffusions(numAssets);
+    std::vector<double> logSpotPrices(numAssets);
+    for (int a = 0; a < numAssets; a++) {
+        drifts[a] = (params.riskFreeRate - params.volatilities[a] * params.volatilities[a] / 2.0) * stepDt;
+        diffusions[a] = params.volatilities[a] * sqrtStepDt;
+        logSpotPrices[a] = std::log(params.spotPrices[a]);
+    }
+    const OptionParams vanillaOption = { 0.0, params.strikePrice, params.timeToMaturity, params.riskFreeRate, 0.0, params.optionType };
+
+    // Per-path estimates, with the Greeks stored asset by asset
+    const int numSimulations = settings.numSimulations;
+    const std::size_t numPaths = std::size_t (numSimulations);
+    std::vector<double> payoffSamples(numPaths);
+    std::vector<double> crudeSamples(numPaths);
+    std::vector<double> deltaSamples(std::size_t (numAssets) * numPaths);
+    std::vector<double> vegaSamples(std::size_t (numAssets) * numPaths);
+
+    const int numBatches = (numSimulations + MULTI_ASSET_BATCH_SIZE - 1) / MULTI_ASSET_BATCH_SIZE;
+    ProgressReporter progress(logText, numSimulations);
+    parallelFor(0, numBatches, settings.numThreads, [&](int, int firstBatch, int lastBatch) {
+        // Every buffer holds one row of lanes per asset, so memory per worker is independent of the step count
+        const std::size_t batchValues = std::size_t (numAssets) * MULTI_ASSET_BATCH_SIZE;
+        std::vector<double> normals(batchValues);
+        std::vector<double> increments(batchValues);
+        std::vector<double> logPrices(batchValues);
+        std::vector<double> antiLogPrices(batchValues);
+        std::vector<double> incrementSums(batchValues);
+        std::vector<double> pathNormals(numAssets);
+        std::vector<double> prices(numAssets);
+        std::vector<double> antiPrices(numAssets);
+        std::vector<double> gradient(numAssets);
+        std::vector<double> antiGradient(numAssets);
+
+        for (int batch = firstBatch; batch < lastBatch; batch++) {
+            const int firstPath = batch * MULTI_ASSET_BATCH_SIZE;
+            const int lastPath = std::min(firstPath + MULTI_ASSET_BATCH_SIZE, numSimulations);
+            for (int a = 0; a < numAssets; a++) {
+                std::fill_n(logPrices.begin() + a * MULTI_ASSET_BATCH_SIZE, MULTI_ASSET_BATCH_SIZE, logSpotPrices[a]);
+                std::fill_n(antiLogPrices.begin() + a * MULTI_ASSET_BATCH_SIZE, MULTI_ASSET_BATCH_SIZE, logSpotPrices[a]);
+            }
+            std::fill(incrementSums.begin(), incrementSums.end(), 0.0);
+            std::fill(normals.begin(), normals.end(), 0.0);
+
+            for (int step = 0; step < numSteps; step++) {
+                for (int i = firstPath; i < lastPath; i++) {
+                    generatePathNormals(settings.seed, std::uint64_t (i), step * numAssets, numAssets, pathNormals.data());
+                    for (int a = 0; a < numAssets; a++) {
+                        normals[std::size_t (a) * MULTI_ASSET_BATCH_SIZE + (i - firstPath)] = pathNormals[a];
+                    }
+                }
+                correlateNormals(*factor, normals.data(), increments.data());
+                for (int a = 0; a < numAssets; a++) {
+                    const std::size_t row = std::size_t (a) * MULTI_ASSET_BATCH_SIZE;
+                    for (int lane = 0; lane < MULTI_ASSET_BATCH_SIZE; lane++) {
+                        logPrices[row + lane] = (logPrices[row + lane] + drifts[a]) + diffusions[a] * increments[row + lane];
+                        antiLogPrices[row + lane] = (antiLogPrices[row + lane] + drifts[a]) - diffusions[a] * increments[row + lane];
+                        incrementSums[row + lane] += increments[row + lane];
+                    }
+                }
+            }
+
+            for (int i = firstPath; i < lastPath; i++) {
+                const int lane = i - firstPath;
+                for (int a = 0; a < numAssets; a++) {
+                    prices[a] = std::exp(logPrices[std::size_t (a) * MULTI_ASSET_BATCH_SIZE + lane]);
+                    antiPrices[a] = std::exp(antiLogPrices[std::size_t (a) * MULTI_ASSET_BATCH_SIZE + lane]);
+                }
+                const double statistic = calculateStatistic(params, prices.data(), gradient.data());
+                const double antiStatistic = calculateStatistic(params, antiPrices.data(), antiGradient.data());
+                const double payoff = discountFactor * calculateVanillaPayoff(vanillaOption, statistic);
+                const double antiPayoff = discountFactor * calculateVanillaPayoff(vanillaOption, antiStatistic);
+                const double slope = discountFactor * calculatePayoffSlope(vanillaOption, statistic);
+                const double antiSlope = discountFactor * calculatePayoffSlope(vanillaOption, antiStatistic);
+
+                auto combineLegs = [&](double estimate, double antitheticEstimate) {
+                    return settings.varianceReduction.antithetic ? 0.5 * (estimate + antitheticEstimate) : estimate;
+                };
+                payoffSamples[i] = combineLegs(payoff, antiPayoff);
+                crudeSamples[i] = payoff;
+
+                // Pathwise: dS_a/dS0_a = S_a / S0_a and dS_a/dsigma_a = S_a (W_a - sigma_a t), with W_a the asset's
+                // correlated Brownian motion
+                for (int a = 0; a < numAssets; a++) {
+                    const double brownianMotion = sqrtStepDt * incrementSums[std::size_t (a) * MULTI_ASSET_BATCH_SIZE + lane];
+                    const double volatilityTime = params.volatilities[a] * simulatedTime;
+                    const std::size_t sample = std::size_t (a) * numPaths + std::size_t (i);
+                    deltaSamples[sample] = combineLegs(slope * gradient[a] * prices[a] / params.spotPrices[a],
+                     antiSlope * antiGradient[a] * antiPrices[a] / params.spotPrices[a]);
+                    vegaSamples[sample] = combineLegs(slope * gradient[a] * prices[a] * (brownianMotion - volatilityTime),
+                     antiSlope * antiGradient[a] * antiPrices[a] * (-brownianMotion - volatilityTime));
+                }
+            }
+            progress.addCompletedWork(lastPath - firstPath);
+        }
+    });
+    progress.finish();
+
+    MultiAssetResult result;
+    const RunningStatistics payoffStatistics = summarise(payoffSamples);
+    result.averagePayoff = payoffStatistics.mean;
+    result.standardError = calculateStandardError(payoffStatistics);
+    result.confidenceInterval = calculateConfidenceInterval(result.averagePayoff, result.standardError);
+    for (int a = 0; a < numAssets; a++) {
+        const auto first = std::size_t (a) * numPaths;
+        const RunningStatistics deltaStatistics = summarise(std::vector<double>(deltaSamples.begin() + first, deltaSamples.begin() + first + numPaths));
+        const RunningStatistics vegaStatistics = summarise(std::vector<double>(vegaSamples.begin() + first, vegaSamples.begin() + first + numPaths));
+        result.deltas.push_back(deltaStatistics.mean);
+        result.deltaStandardErrors.push_back(calculateStandardError(deltaStatistics));
+        result.vegas.push_back(vegaStatistics.mean);
+        result.vegaStandardErrors.push_back(calculateStandardError(vegaStatistics));
+    }
+    result.varianceReductionFactor = calculateVarianceReductionFactor(calculateStandardError(summarise(crudeSamples)), result.standardError);
+    result.numPaths = numSimulations;
+    result.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return result;
+}
+
+MultiAssetParams readMultiAssetFile(const std::filesystem::path& inputPath) {
+    std::ifstream inputFile(inputPath);
+    if (!inputFile) {
+        throw std::runtime_error("could not open " + inputPath.string());
+    }
+
+    MultiAssetParams params = {};
+    bool readOption = false;
+    std::vector<std::vector<double>> correlationRows;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(inputFile, line)) {
+        lineNumber++;
+        const std::vector<std::string> fields = splitCsvLine(line);
+        if (fields.empty() || !isNonNegativeDouble(fields[0].c_str())) {
+            continue;
+        }
+
+        if (!readOption) {
+            if (fields.size() != 5) {
+                throw std::runtime_error(describeLine(lineNumber) + " must be strikePrice,timeToMaturity,riskFreeRate,optionType,payoff");
+            }
+            else if (!isNonNegativeDouble(fields[0].c_str())) {
+                throw std::runtime_error("the strike price on " + describeLine(lineNumber) + " must be a non-negative double");
+            }
+            else if (!isPositiveDouble(fields[1].c_str())) {
+                throw std::runtime_error("the time to maturity on " + describeLine(lineNumber) + " must be a positive double");
+            }
+            else if (!isNonNegativeDouble(fields[2].c_str())) {
+                throw std::runtime_error("the risk-free rate on " + describeLine(lineNumber) + " must be a non-negative double");
+            }
+            else if (!isValidOptionType(fields[3].c_str())) {
+                throw std::runtime_error("the option type on " + describeLine(lineNumber) + " must be either \"Call\" or \"Put\"");
+            }
+
+            params.strikePrice = std::stod(fields[0]);
+            params.timeToMaturity = std::stod(fields[1]);
+            params.riskFreeRate = std::stod(fields[2]) / 100.0;
+            params.optionType = insensitiveEquals(fields[3], "Call") ? OptionType::Call : OptionType::Put;
+            bool isValidPayoff = false;
+            for (MultiAssetPayoff payoff : { MultiAssetPayoff::Basket, MultiAssetPayoff::BestOf, MultiAssetPayoff::WorstOf }) {
+                if (insensitiveEquals(fields[4], getMultiAssetPayoffName(payoff))) {
+                    params.payoff = payoff;
+                    isValidPayoff = true;
+                }
+            }
+            if (!isValidPayoff) {
+                throw std::runtime_error("the payoff on " + describeLine(lineNumber) + " must be Basket, BestOf or WorstOf");
+            }
+            readOption = true;
+            continue;
+        }
+
+        if (fields.size() < 4) {
+            throw std::runtime_error(describeLine(lineNumber) + " must be spotPrice,volatility,weight followed by a row of correlations");
+        }
+        else if (!isPositiveDouble(fields[0].c_str())) {
+            throw std::runtime_error("the spot price on " + describeLine(lineNumber) + " must be a positive double");
+        }
+        else if (!isNonNegativeDouble(fields[1].c_str())) {
+            throw std::runtime_error("the volatility on " + describeLine(lineNumber) + " must be a non-negative double");
+        }
+
+        std::vector<double> row;
+        try {
+            params.weights.push_back(std::stod(fields[2]));
+            for (std::size_t j = 3; j < fields.size(); j++) {
+                row.push_back(std::stod(fields[j]));
+            }
+        }
+        catch (const std::exception&) {
+            throw std::runtime_error("the weight and correlations on " + describeLine(lineNumber) + " must be numbers");
+        }
+        params.spotPrices.push_back(std::stod(fields[0]));
+        params.volatilities.push_back(std::stod(fields[1]) / 100.0);
+        correlationRows.push_back(row);
+    }
+
+    const std::size_t numAssets = params.spotPrices.size();
+    if (!readOption || numAssets == 0) {
+        throw std::runtime_error("the multi-asset file must describe the option and at least one asset");
+    }
+    for (const std::vector<double>& row : correlationRows) {
+        if (row.size() != numAssets) {
+            throw std::runtime_error("every asset must have one correlation per asset");
+        }
+        params.correlations.insert(params.correlations.end(), row.begin(), row.end());
+    }
+    return params;
+}
+
+int runMultiAssetPricing(const std::filesystem::path& inputPath, const SimulationSettings& settings) {
+    try {
+        const MultiAssetParams params = readMultiAssetFile(inputPath);
+        const MultiAssetResult result = runMultiAssetSimulation(params, settings, "Simulating paths ");
+
+        std::cout << std::endl;
+        outputRow("Option value", prepareForOutput(result.averagePayoff));
+        outputRow("Standard error", prepareForOutput(result.standardError));
+        const std::string roundedLowerBound = prepareForOutput(std::get<0>(result.confidenceInterval));
+        const std::string roundedUpperBound = prepareForOutput(std::get<1>(result.confidenceInterval));
+        outputRow("95% confidence interval", "(" + roundedLowerBound + ", " + roundedUpperBound + ")");
+        outputRow("Variance reduction", prepareForOutput(result.varianceReductionFactor) + "x");
+        outputRow("Paths used", std::to_string(result.numPaths));
+        outputRow("Elapsed time (s)", prepareForOutput(result.elapsedSeconds));
+        for (std::size_t a = 0; a < result.deltas.size(); a++) {
+            const std::string asset = " (asset " + std::to_string(a + 1) + ")";
+            outputRow("Delta" + asset, prepareForOutput(result.deltas[a]) + " +/- " + prepareForOutput(result.deltaStandardErrors[a]));
+            outputRow("Vega" + asset, prepareForOutput(result.vegas[a]) + " +/- " + prepareForOutput(result.vegaStandardErrors[a]));
+        }
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
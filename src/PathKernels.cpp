@@ -0,0 +1,190 @@
+#include "PathKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define MONTE_CARLO_X86 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define MONTE_CARLO_TARGET(isa)
+    #else
+        #define MONTE_CARLO_TARGET(isa) __attribute__((target(isa)))
+    #endif
+#endif
+
+namespace {
+    void advanceLogPathsScalar(const double* normals, int numSteps, PathConstants constants, double* logPrices, double* antiLogPrices) {
+        for (int step = 0; step < numSteps; step++) {
+            const double* Z = normals + step * PATH_BATCH_SIZE;
+            for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                logPrices[lane] = (logPrices[lane] + constants.drift) + constants.diffusion * Z[lane];
+                antiLogPrices[lane] = (antiLogPrices[lane] + constants.drift) - constants.diffusion * Z[lane];
+            }
+        }
+    }
+
+    void advanceLogReturnsScalar(const float* normals, int numSteps, SinglePathConstants constants, float* logReturns, float* antiLogReturns) {
+        for (int step = 0; step < numSteps; step++) {
+            const float* Z = normals + step * PATH_BATCH_SIZE;
+            for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+                logReturns[lane] = (logReturns[lane] + constants.drift) + constants.diffusion * Z[lane];
+                antiLogReturns[lane] = (antiLogReturns[lane] + constants.drift) - constants.diffusion * Z[lane];
+            }
+        }
+    }
+
+#ifdef MONTE_CARLO_X86
+    // Separate multiplies and adds rather than FMA, matching the scalar kernel's rounding exactly
+    MONTE_CARLO_TARGET("avx2")
+    void advanceLogPathsAvx2(const double* normals, int numSteps, PathConstants constants, double* logPrices, double* antiLogPrices) {
+        const __m256d drift = _mm256_set1_pd(constants.drift);
+        const __m256d diffusion = _mm256_set1_pd(constants.diffusion);
+        __m256d lowPrices = _mm256_loadu_pd(logPrices);
+        __m256d highPrices = _mm256_loadu_pd(logPrices + 4);
+        __m256d lowAntiPrices = _mm256_loadu_pd(antiLogPrices);
+        __m256d highAntiPrices = _mm256_loadu_pd(antiLogPrices + 4);
+
+        for (int step = 0; step < numSteps; step++) {
+            const __m256d lowShocks = _mm256_mul_pd(diffusion, _mm256_loadu_pd(normals + step * PATH_BATCH_SIZE));
+            const __m256d highShocks = _mm256_mul_pd(diffusion, _mm256_loadu_pd(normals + step * PATH_BATCH_SIZE + 4));
+            lowPrices = _mm256_add_pd(_mm256_add_pd(lowPrices, drift), lowShocks);
+            highPrices = _mm256_add_pd(_mm256_add_pd(highPrices, drift), highShocks);
+            lowAntiPrices = _mm256_sub_pd(_mm256_add_pd(lowAntiPrices, drift), lowShocks);
+            highAntiPrices = _mm256_sub_pd(_mm256_add_pd(highAntiPrices, drift), highShocks);
+        }
+
+        _mm256_storeu_pd(logPrices, lowPrices);
+        _mm256_storeu_pd(logPrices + 4, highPrices);
+        _mm256_storeu_pd(antiLogPrices, lowAntiPrices);
+        _mm256_storeu_pd(antiLogPrices + 4, highAntiPrices);
+    }
+
+    MONTE_CARLO_TARGET("avx512f")
+    void advanceLogPathsAvx512(const double* normals, int numSteps, PathConstants constants, double* logPrices, double* antiLogPrices) {
+        const __m512d drift = _mm512_set1_pd(constants.drift);
+        const __m512d diffusion = _mm512_set1_pd(constants.diffusion);
+        __m512d prices = _mm512_loadu_pd(logPrices);
+        __m512d antiPrices = _mm512_loadu_pd(antiLogPrices);
+
+        for (int step = 0; step < numSteps; step++) {
+            const __m512d shocks = _mm512_mul_pd(diffusion, _mm512_loadu_pd(normals + step * PATH_BATCH_SIZE));
+            prices = _mm512_add_pd(_mm512_add_pd(prices, drift), shocks);
+            antiPrices = _mm512_sub_pd(_mm512_add_pd(antiPrices, drift), shocks);
+        }
+
+        _mm512_storeu_pd(logPrices, prices);
+        _mm512_storeu_pd(antiLogPrices, antiPrices);
+    }
+
+    MONTE_CARLO_TARGET("avx2")
+    void advanceLogReturnsAvx2(const float* normals, int numSteps, SinglePathConstants constants, float* logReturns, float* antiLogReturns) {
+        const __m256 drift = _mm256_set1_ps(constants.drift);
+        const __m256 diffusion = _mm256_set1_ps(constants.diffusion);
+        __m256 returns = _mm256_loadu_ps(logReturns);
+        __m256 antiReturns = _mm256_loadu_ps(antiLogReturns);
+
+        for (int step = 0; step < numSteps; step++) {
+            const __m256 shocks = _mm256_mul_ps(diffusion, _mm256_loadu_ps(normals + step * PATH_BATCH_SIZE));
+            returns = _mm256_add_ps(_mm256_add_ps(returns, drift), shocks);
+            antiReturns = _mm256_sub_ps(_mm256_add_ps(antiReturns, drift), shocks);
+        }
+
+        _mm256_storeu_ps(logReturns, returns);
+        _mm256_storeu_ps(antiLogReturns, antiReturns);
+    }
+
+    #ifdef _MSC_VER
+    bool hasCpuFeatures(bool avx512) {
+        int registers[4];
+        __cpuid(registers, 1);
+        const bool osSavesAvx = (registers[2] & (1 << 27)) != 0 && (registers[2] & (1 << 28)) != 0;
+        if (!osSavesAvx) {
+            return false;
+        }
+        const unsigned long long enabledStates = _xgetbv(0);
+        __cpuidex(registers, 7, 0);
+        if (!avx512) {
+            return (enabledStates & 0x6) == 0x6 && (registers[1] & (1 << 5)) != 0;
+        }
+        return (enabledStates & 0xE6) == 0xE6 && (registers[1] & (1 << 16)) != 0;
+    }
+    #endif
+#endif
+}
+
+bool isKernelIsaSupported(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::Scalar:
+            return true;
+#ifdef MONTE_CARLO_X86
+    #ifdef _MSC_VER
+        case KernelIsa::Avx2:
+            return hasCpuFeatures(false);
+        case KernelIsa::Avx512:
+            return hasCpuFeatures(true);
+    #else
+        case KernelIsa::Avx2:
+            return __builtin_cpu_supports("avx2");
+        case KernelIsa::Avx512:
+            return __builtin_cpu_supports("avx512f");
+    #endif
+#endif
+        default:
+            return false;
+    }
+}
+
+KernelIsa detectKernelIsa() {
+    if (isKernelIsaSupported(KernelIsa::Avx512)) {
+        return KernelIsa::Avx512;
+    }
+    if (isKernelIsaSupported(KernelIsa::Avx2)) {
+        return KernelIsa::Avx2;
+    }
+    return KernelIsa::Scalar;
+}
+
+const char* getKernelIsaName(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::Avx2:
+            return "AVX2";
+        case KernelIsa::Avx512:
+            return "AVX-512";
+        default:
+            return "scalar";
+    }
+}
+
+LogPathKernel getLogPathKernel(KernelIsa isa) {
+    switch (isa) {
+#ifdef MONTE_CARLO_X86
+        case KernelIsa::Avx2:
+            return advanceLogPathsAvx2;
+        case KernelIsa::Avx512:
+            return advanceLogPathsAvx512;
+#endif
+        default:
+            return advanceLogPathsScalar;
+    }
+}
+
+LogPathKernel getLogPathKernel() {
+    static const LogPathKernel kernel = getLogPathKernel(detectKernelIsa());
+    return kernel;
+}
+
+SingleLogPathKernel getSingleLogPathKernel(KernelIsa isa) {
+    switch (isa) {
+#ifdef MONTE_CARLO_X86
+        case KernelIsa::Avx2:
+        case KernelIsa::Avx512:
+            return advanceLogReturnsAvx2;
+#endif
+        default:
+            return advanceLogReturnsScalar;
+    }
+}
+
+SingleLogPathKernel getSingleLogPathKernel() {
+    static const SingleLogPathKernel kernel = getSingleLogPathKernel(detectKernelIsa());
+    return kernel;
+}
@@ -0,0 +1,183 @@
+#include <cmath>
+#include "MonteCarlo.h"
+#include "PathPayoffs.h"
+
+namespace {
+    // Multiplies the barrier survival probability by the chance that the path did not touch the barrier between two
+    // grid prices, carrying its derivatives along. Each parameter moves the two log distances and the step variance:
+    //   d/dlogS0: the whole path shifts, so both distances fall by barrierSide
+    //   d/dsigma: log prices move by W - sigma t and the variance by 2 sigma dt
+    //   d/dr: log prices move by t
+    // For the first step, which starts at the spot price, it also records what gamma needs (see PathState). variance
+    // is that of the step's log return, sigma^2 dt under GBM.
+    void monitorBarrier(PathState& state, const PayoffConstants& payoff, double previousLogPrice, double previousVega, double previousTime, double vega, double variance, double dt) {
+        if (state.survival <= 0.0) {
+            return;
+        }
+        const double previousDistance = payoff.barrierSide * (payoff.logBarrier - previousLogPrice);
+        const double distance = payoff.barrierSide * (payoff.logBarrier - state.logPrice);
+        if (distance <= 0.0) {
+            state.survival = state.survivalDelta = state.survivalVega = state.survivalRho = 0.0;
+            state.remainingSurvival = state.remainingSurvivalDelta = 0.0;
+            return;
+        }
+        if (variance <= 0.0) {
+            return;
+        }
+
+        const double crossingProbability = std::exp(-2.0 * previousDistance * distance / variance);
+        auto crossingDerivative = [&](double previousDistanceDerivative, double distanceDerivative, double varianceDerivative) {
+            return crossingProbability * -2.0 / variance * (previousDistanceDerivative * distance + previousDistance * distanceDerivative
+             - previousDistance * distance * varianceDerivative / variance);
+        };
+        const double crossingDelta = crossingDerivative(-payoff.barrierSide, -payoff.barrierSide, 0.0);
+        const double crossingVega = crossingDerivative(-payoff.barrierSide * previousVega, -payoff.barrierSide * vega, 2.0 * payoff.volatility * dt);
+        const double crossingRho = crossingDerivative(-payoff.barrierSide * previousTime, -payoff.barrierSide * state.time, 0.0);
+
+        const double survivalFactor = 1.0 - crossingProbability;
+        if (state.numObservations == 0) {
+            state.firstCrossingSpotDerivative = 2.0 * payoff.barrierSide * crossingProbability * distance / variance;
+            state.firstCrossingSpotCurvature = 2.0 * crossingProbability / variance * (2.0 * (previousDistance + distance) * distance / variance - 1.0);
+        }
+        else {
+            state.remainingSurvivalDelta = state.remainingSurvivalDelta * survivalFactor - state.remainingSurvival * crossingDelta;
+            state.remainingSurvival *= survivalFactor;
+        }
+        state.survivalDelta = state.survivalDelta * survivalFactor - state.survival * crossingDelta;
+        state.survivalVega = state.survivalVega * survivalFactor - state.survival * crossingVega;
+        state.survivalRho = state.survivalRho * survivalFactor - state.survival * crossingRho;
+        state.survival *= survivalFactor;
+    }
+
+    // Folds the price the state has just moved to into its running statistics, given the log price's pathwise
+    // derivatives with respect to the volatility before and after the step and the variance of the step's log return
+    void recordObservation(PathState& state, const PayoffConstants& payoff, double previousLogPrice, double previousVega, double previousTime, double vega, double variance, double dt) {
+        const double rho = state.time;
+
+        if (payoff.payoffStyle == PayoffStyle::ArithmeticAsian) {
+            const double price = std::exp(state.logPrice);
+            state.sumPrices += price;
+            state.sumPriceVegas += price * vega;
+            state.sumPriceRhos += price * rho;
+        }
+        else if (payoff.payoffStyle == PayoffStyle::Lookback) {
+            const double price = std::exp(state.logPrice);
+            const bool isNewExtreme = state.numObservations == 0 || (payoff.tracksMaximum ? price > state.extremePrice : price < state.extremePrice);
+            if (isNewExtreme) {
+                state.extremePrice = price;
+                state.extremeVega = price * vega;
+                state.extremeRho = price * rho;
+            }
+        }
+        else if (payoff.payoffStyle == PayoffStyle::Barrier) {
+            monitorBarrier(state, payoff, previousLogPrice, previousVega, previousTime, vega, variance, dt);
+        }
+        if (payoff.tracksGeometricAverage) {
+            state.sumLogPrices += state.logPrice;
+            state.sumVegas += vega;
+            state.sumTimes += rho;
+        }
+        state.numObservations++;
+    }
+
+    void advancePathState(PathState& state, const PayoffConstants& payoff, PathConstants constants, double normal, double brownianIncrement, double dt) {
+        const double previousLogPrice = state.logPrice;
+        const double previousVega = state.brownianMotion - payoff.volatility * state.time;
+        const double previousTime = state.time;
+        state.logPrice = (state.logPrice + constants.drift) + constants.diffusion * normal;
+        state.brownianMotion += brownianIncrement;
+        state.time += dt;
+
+        // Pathwise derivative of this log price with respect to the volatility
+        const double vega = state.brownianMotion - payoff.volatility * state.time;
+        recordObservation(state, payoff, previousLogPrice, previousVega, previousTime, vega, payoff.volatility * payoff.volatility * dt, dt);
+    }
+
+    PayoffSensitivities evaluateStatisticPayoff(const OptionParams& params, double statistic, double statisticVega, double statisticRho) {
+        const double slope = calculatePayoffSlope(params, statistic);
+        return { calculateVanillaPayoff(params, statistic), slope * statistic, slope * statisticVega, slope * statisticRho, 0.0 };
+    }
+}
+
+PayoffConstants createPayoffConstants(const OptionParams& params, bool tracksGeometricAverage) {
+    PayoffConstants payoff;
+    payoff.payoffStyle = params.payoffStyle;
+    payoff.tracksGeometricAverage = tracksGeometricAverage || params.payoffStyle == PayoffStyle::GeometricAsian;
+    payoff.volatility = params.volatility;
+    payoff.logBarrier = params.barrierLevel > 0.0 ? std::log(params.barrierLevel) : 0.0;
+    payoff.barrierSide = params.barrierType == BarrierType::UpAndOut || params.barrierType == BarrierType::UpAndIn ? 1.0 : -1.0;
+    payoff.knockIn = params.barrierType == BarrierType::UpAndIn || params.barrierType == BarrierType::DownAndIn;
+    payoff.tracksMaximum = params.optionType == OptionType::Call;
+    return payoff;
+}
+
+PathState createPathState(const PayoffConstants& payoff, double logSpotPrice) {
+    PathState state = {};
+    state.logPrice = logSpotPrice;
+    if (payoff.payoffStyle == PayoffStyle::Barrier) {
+        state.survival = payoff.barrierSide * (payoff.logBarrier - logSpotPrice) > 0.0 ? 1.0 : 0.0;
+        state.remainingSurvival = state.survival;
+    }
+    return state;
+}
+
+void advancePathStates(const double* normals, int numSteps, PathConstants constants, double brownianDrift, double dt, const PayoffConstants& payoff, PathState* states, PathState* antiStates) {
+    const double sqrtDt = std::sqrt(dt);
+    for (int step = 0; step < numSteps; step++) {
+        const double* Z = normals + step * PATH_BATCH_SIZE;
+        for (int lane = 0; lane < PATH_BATCH_SIZE; lane++) {
+            advancePathState(states[lane], payoff, constants, Z[lane], sqrtDt * Z[lane] + brownianDrift, dt);
+            if (antiStates != nullptr) {
+                advancePathState(antiStates[lane], payoff, constants, -Z[lane], brownianDrift - sqrtDt * Z[lane], dt);
+            }
+        }
+    }
+}
+
+void observeModelPrice(PathState& state, const PayoffConstants& payoff, double logPrice, double stepVariance, double dt) {
+    const double previousLogPrice = state.logPrice;
+    const double previousTime = state.time;
+    state.logPrice = logPrice;
+    state.time += dt;
+    recordObservation(state, payoff, previousLogPrice, 0.0, previousTime, 0.0, stepVariance, dt);
+}
+
+PayoffSensitivities evaluateTerminalPayoff(const OptionParams& params, double finalPrice, double brownianMotion, double simulatedTime) {
+    return evaluateStatisticPayoff(params, finalPrice, finalPrice * (brownianMotion - params.volatility * simulatedTime), finalPrice * simulatedTime);
+}
+
+PayoffSensitivities evaluatePathPayoff(const OptionParams& params, const PayoffConstants& payoff, const PathState& state) {
+    const double numObservations = double (state.numObservations > 0 ? state.numObservations : 1);
+    switch (params.payoffStyle) {
+        case PayoffStyle::European:
+            break;
+        case PayoffStyle::ArithmeticAsian:
+            return evaluateStatisticPayoff(params, state.sumPrices / numObservations, state.sumPriceVegas / numObservations,
+             state.sumPriceRhos / numObservations);
+        case PayoffStyle::GeometricAsian: {
+            const double average = std::exp(state.sumLogPrices / numObservations);
+            return evaluateStatisticPayoff(params, average, average * state.sumVegas / numObservations, average * state.sumTimes / numObservations);
+        }
+        case PayoffStyle::Lookback:
+            return evaluateStatisticPayoff(params, state.extremePrice, state.extremeVega, state.extremeRho);
+        case PayoffStyle::Barrier: {
+            // A knock-in pays exactly when the matching knock-out does not. The spot moves the knock-out payoff
+            // g(S) R (1 - p1) directly through p1 by -g R dp1/dlogS0, and shifting the whole path moves that in turn.
+            const PayoffSensitivities terminal = evaluateTerminalPayoff(params, std::exp(state.logPrice), state.brownianMotion, state.time);
+            const double weight = payoff.knockIn ? 1.0 - state.survival : state.survival;
+            const double weightSign = payoff.knockIn ? -1.0 : 1.0;
+            const double spotCurvature = -weightSign * ((terminal.logSpotPrice * state.remainingSurvival + terminal.payoff * state.remainingSurvivalDelta)
+             * state.firstCrossingSpotDerivative + terminal.payoff * state.remainingSurvival * state.firstCrossingSpotCurvature);
+            return { terminal.payoff * weight,
+                     terminal.logSpotPrice * weight + weightSign * terminal.payoff * state.survivalDelta,
+                     terminal.volatility * weight + weightSign * terminal.payoff * state.survivalVega,
+                     terminal.rate * weight + weightSign * terminal.payoff * state.survivalRho,
+                     spotCurvature };
+        }
+    }
+    return evaluateTerminalPayoff(params, std::exp(state.logPrice), state.brownianMotion, state.time);
+}
+
+double calculateGeometricAveragePayoff(const OptionParams& params, const PathState& state) {
+    return calculateVanillaPayoff(params, std::exp(state.sumLogPrices / (state.numObservations > 0 ? state.numObservations : 1)));
+}
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "Parallel.h"
+#include "Random.h"
+#include "Sobol.h"
+
+namespace {
+    constexpr std::uint32_t PHILOX_MULTIPLIER_0 = 0xD2511F53;
+    constexpr std::uint32_t PHILOX_MULTIPLIER_1 = 0xCD9E8D57;
+    constexpr std::uint32_t PHILOX_WEYL_0 = 0x9E3779B9;
+    constexpr std::uint32_t PHILOX_WEYL_1 = 0xBB67AE85;
+    constexpr int PHILOX_ROUNDS = 10;
+    constexpr double TWO_PI = 6.283185307179586;
+    constexpr double UNIFORM_SCALE = 1.0 / 9007199254740992.0; // 2^-53
+
+    // Maps 64 random bits onto the open interval (0, 1), so the logarithm below is always finite
+    double toOpenUniform(std::uint32_t high, std::uint32_t low) {
+        const std::uint64_t bits = ((std::uint64_t (high) << 32) | low) >> 11;
+        return (double (bits) + 0.5) * UNIFORM_SCALE;
+    }
+
+    // Stores every path's normals, as written by generate(pathIndex, normals), in values or, rounded, in singleValues
+    template <typename Generate>
+    void storeNormals(RandomNormals& randomNormals, bool singlePrecision, int numThreads, Generate generate) {
+        const int numSteps = randomNormals.numSteps;
+        if (singlePrecision) {
+            randomNormals.singleValues.assign(randomNormals.numSimulations, std::vector<float>(numSteps));
+        }
+        else {
+            randomNormals.values.assign(randomNormals.numSimulations, std::vector<double>(numSteps));
+        }
+        parallelFor(0, randomNormals.numSimulations, numThreads, [&](int, int firstPath, int lastPath) {
+            std::vector<double> buffer(singlePrecision ? numSteps : 0);
+            for (int i = firstPath; i < lastPath; i++) {
+                if (!singlePrecision) {
+                    generate(i, randomNormals.values[i].data());
+                    continue;
+                }
+                generate(i, buffer.data());
+                std::copy(buffer.begin(), buffer.end(), randomNormals.singleValues[i].begin());
+            }
+        });
+    }
+}
+
+PhiloxBlock philox4x32(std::uint64_t key, std::uint64_t pathIndex, std::uint64_t blockIndex) {
+    std::uint32_t counter[4] = {
+        std::uint32_t (blockIndex), std::uint32_t (blockIndex >> 32),
+        std::uint32_t (pathIndex), std::uint32_t (pathIndex >> 32)
+    };
+    std::uint32_t keyLow = std::uint32_t (key);
+    std::uint32_t keyHigh = std::uint32_t (key >> 32);
+
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        const std::uint64_t product0 = std::uint64_t (PHILOX_MULTIPLIER_0) * counter[0];
+        const std::uint64_t product1 = std::uint64_t (PHILOX_MULTIPLIER_1) * counter[2];
+        const std::uint32_t next0 = std::uint32_t (product1 >> 32) ^ counter[1] ^ keyLow;
+        const std::uint32_t next2 = std::uint32_t (product0 >> 32) ^ counter[3] ^ keyHigh;
+        counter[0] = next0;
+        counter[1] = std::uint32_t (product1);
+        counter[2] = next2;
+        counter[3] = std::uint32_t (product0);
+        keyLow += PHILOX_WEYL_0;
+        keyHigh += PHILOX_WEYL_1;
+    }
+
+    return { { counter[0], counter[1], counter[2], counter[3] } };
+}
+
+double inverseNormalCdf(double probability) {
+    static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+    static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00 };
+    constexpr double LOWER_REGION = 0.02425;
+
+    double x;
+    if (probability < LOWER_REGION) {
+        const double q = std::sqrt(-2.0 * std::log(probability));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    }
+    else if (probability <= 1.0 - LOWER_REGION) {
+        const double q = probability - 0.5;
+        const double r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+    }
+    else {
+        const double q = std::sqrt(-2.0 * std::log(1.0 - probability));
+        x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    }
+
+    const double error = 0.5 * std::erfc(-x / std::sqrt(2.0)) - probability;
+    const double step = error * std::sqrt(TWO_PI) * std::exp(x * x / 2.0);
+    return x - step / (1.0 + x * step / 2.0);
+}
+
+std::uint64_t generateSeed() {
+    return std::uint64_t (std::chrono::system_clock::now().time_since_epoch().count());
+}
+
+void generatePathNormals(std::uint64_t seed, std::uint64_t pathIndex, int firstStep, int numSteps, double* normals) {
+    // Each Philox block feeds one Box-Muller transform, giving the normals for steps 2k and 2k + 1
+    int step = firstStep;
+    const int lastStep = firstStep + numSteps;
+    while (step < lastStep) {
+        const PhiloxBlock block = philox4x32(seed, pathIndex, std::uint64_t (step / 2));
+        const double radius = std::sqrt(-2.0 * std::log(toOpenUniform(block.words[0], block.words[1])));
+        const double angle = TWO_PI * toOpenUniform(block.words[2], block.words[3]);
+        if (step % 2 == 0) {
+            normals[step - firstStep] = radius * std::cos(angle);
+            step++;
+        }
+        if (step < lastStep) {
+            normals[step - firstStep] = radius * std::sin(angle);
+            step++;
+        }
+    }
+}
+
+std::vector<std::vector<double>> generateRandomNormals(int numSimulations, int numSteps, std::uint64_t seed, int numThreads) {
+    std::vector<std::vector<double>> randomNormals(numSimulations, std::vector<double>(numSteps));
+
+    // We use the same random variables for our Greeks calculations
+    parallelFor(0, numSimulations, numThreads, [&](int, int firstPath, int lastPath) {
+        for (int i = firstPath; i < lastPath; i++) {
+            generatePathNormals(seed, std::uint64_t (i), 0, numSteps, randomNormals[i].data());
+        }
+    });
+
+    return randomNormals;
+}
+
+RandomNormals createRandomNormals(int numSimulations, int numSteps, std::uint64_t seed, bool streamed, int numThreads, bool singlePrecision) {
+    RandomNormals randomNormals = { seed, numSimulations, numSteps, {}, nullptr, 0, {} };
+    if (!streamed) {
+        storeNormals(randomNormals, singlePrecision, numThreads, [&](int pathIndex, double* normals) {
+            generatePathNormals(seed, std::uint64_t (pathIndex), 0, numSteps, normals);
+        });
+    }
+    return randomNormals;
+}
+
+RandomNormals createQuasiRandomNormals(int numSimulations, int numBridgeSteps, int numSteps, std::uint64_t seed, bool streamed, int numThreads, bool singlePrecision) {
+    const std::shared_ptr<const QuasiRandomSource> source = std::make_shared<const QuasiRandomSource>(
+     createQuasiRandomSource(seed, numSimulations, numBridgeSteps, numSteps));
+    RandomNormals randomNormals = { seed, numSimulations, numSteps, {}, source, 0, {} };
+    if (!streamed) {
+        storeNormals(randomNormals, singlePrecision, numThreads, [&](int pathIndex, double* normals) {
+            generateQuasiRandomPathNormals(*source, pathIndex, numSteps, normals);
+        });
+    }
+    return randomNormals;
+}
+
+bool isStreamed(const RandomNormals& randomNormals) {
+    return randomNormals.values.empty() && randomNormals.singleValues.empty();
+}
+
+std::size_t getStoredNormalBytes(const RandomNormals& randomNormals) {
+    if (isStreamed(randomNormals)) {
+        return 0;
+    }
+    const std::size_t valueBytes = randomNormals.singleValues.empty() ? sizeof(double) : sizeof(float);
+    return std::size_t (randomNormals.numSimulations) * randomNormals.numSteps * valueBytes;
+}
+
+const double* getPathNormals(const RandomNormals& randomNormals, int pathIndex, int numSteps, std::vector<double>& buffer) {
+    const int numStoredSteps = isStreamed(randomNormals) ? 0 : std::min(numSteps, randomNormals.numSteps);
+    if (!randomNormals.values.empty() && numStoredSteps == numSteps) {
+        return randomNormals.values[pathIndex].data();
+    }
+
+    if (int (buffer.size()) < numSteps) {
+        buffer.resize(numSteps);
+    }
+    if (randomNormals.quasiRandom && numStoredSteps < numSteps) {
+        generateQuasiRandomPathNormals(*randomNormals.quasiRandom, randomNormals.firstPath + pathIndex, numSteps, buffer.data());
+        return buffer.data();
+    }
+    if (!randomNormals.values.empty()) {
+        std::copy_n(randomNormals.values[pathIndex].begin(), numStoredSteps, buffer.begin());
+    }
+    else if (numStoredSteps > 0) {
+        std::copy_n(randomNormals.singleValues[pathIndex].begin(), numStoredSteps, buffer.begin());
+    }
+    generatePathNormals(randomNormals.seed, std::uint64_t (randomNormals.firstPath) + std::uint64_t (pathIndex), numStoredSteps, numSteps - numStoredSteps, buffer.data() + numStoredSteps);
+    return buffer.data();
+}
+
+const float* getStoredSinglePathNormals(const RandomNormals& randomNormals, int pathIndex, int numSteps) {
+    return !randomNormals.singleValues.empty() && numSteps <= randomNormals.numSteps ? randomNormals.singleValues[pathIndex].data() : nullptr;
+}
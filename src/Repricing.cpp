@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "Batch.h"
+#include "Instrumentation.h"
+#include "Models.h"
+#include "MonteCarlo.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "Repricing.h"
+#include "Statistics.h"
+
+namespace {
+    constexpr int REPRICING_BLOCK_SIZE = 4096;
+
+    enum class RepricingMethod { Resimulation, SpotRescale, Reweighting };
+
+    ContractKey createContractKey(const OptionParams& params) {
+        return { params.strikePrice, params.timeToMaturity, params.optionType };
+    }
+
+    ResultKey createResultKey(const OptionParams& params) {
+        return { params.strikePrice, params.timeToMaturity, params.optionType, params.spotPrice, params.volatility, params.riskFreeRate };
+    }
+
+    // Estimates from one path of a repricing, already multiplied by its likelihood ratio weight
+    struct RepricedLegEstimates {
+        double payoff;
+        double delta;
+        double gamma;
+        double vega;
+        double rho;
+        double theta;
+    };
+
+    // Simulates the option on the terminal grid and keeps the terminal and extension normals and the growth factor of
+    // every path
+    OptionResult simulateAndCachePaths(const OptionParams& params, const SimulationSettings& settings, std::shared_ptr<const CachedPaths>& paths) {
+        const TimeGrid grid = createTerminalTimeGrid(params);
+        const RandomNormals randomNormals = createGridNormals(grid, settings);
+        const OptionResult result = runMonteCarloSimulation(params, grid, randomNormals, false, "", settings);
+
+        const int numSimulations = randomNormals.numSimulations;
+        const double drift = (params.riskFreeRate - params.volatility * params.volatility / 2.0) * params.timeToMaturity;
+        const double diffusion = params.volatility * std::sqrt(params.timeToMaturity);
+        std::shared_ptr<CachedPaths> cachedPaths = std::make_shared<CachedPaths>();
+        cachedPaths->spotPrice = params.spotPrice;
+        cachedPaths->volatility = params.volatility;
+        cachedPaths->riskFreeRate = params.riskFreeRate;
+        cachedPaths->normals.resize(numSimulations);
+        cachedPaths->extensionNormals.resize(numSimulations);
+        cachedPaths->growthFactors.resize(numSimulations);
+        parallelFor(0, numSimulations, settings.numThreads, [&](int, int firstPath, int lastPath) {
+            std::vector<double> buffer;
+            for (int i = firstPath; i < lastPath; i++) {
+                const double* normals = getPathNormals(randomNormals, i, getNumGridSteps(grid), buffer);
+                cachedPaths->normals[i] = normals[0];
+                cachedPaths->extensionNormals[i] = normals[1];
+                cachedPaths->growthFactors[i] = std::exp(drift + diffusion * normals[0]);
+            }
+        });
+        paths = cachedPaths;
+        return result;
+    }
+
+    // Prices the option from cached paths. Each path's terminal log price is drift + diffusion * z under the cached
+    // parameters; under the new ones the same log price is their drift + diffusion * z', and the path is weighted by
+    // the ratio of the two normal densities, (diffusion / diffusion') exp((z^2 - z'^2) / 2). The Greeks are the pathwise
+    // ones under the new parameters, holding z' fixed. Theta continues each terminal price for TIME_TO_MATURITY_JUMP
+    // more with the path's cached extension normal, as a fresh simulation does; that normal is independent of z, so it
+    // needs no weight of its own.
+    OptionResult repriceFromPaths(const CachedPaths& paths, const OptionParams& params, const SimulationSettings& settings) {
+        const auto startTime = std::chrono::steady_clock::now();
+        const PhaseClock clock = startPhaseClock();
+        const double timeToMaturity = params.timeToMaturity;
+        const double sqrtTimeToMaturity = std::sqrt(timeToMaturity);
+        const double cachedDrift = (paths.riskFreeRate - paths.volatility * paths.volatility / 2.0) * timeToMaturity;
+        const double cachedDiffusion = paths.volatility * sqrtTimeToMaturity;
+        const double driftRate = params.riskFreeRate - params.volatility * params.volatility / 2.0;
+        const double drift = driftRate * timeToMaturity;
+        const double diffusion = params.volatility * sqrtTimeToMaturity;
+        const bool reweights = params.volatility != paths.volatility || params.riskFreeRate != paths.riskFreeRate;
+        const double logWeightOffset = reweights ? std::log(cachedDiffusion / diffusion) : 0.0;
+        const double discountFactor = std::exp(-params.riskFreeRate * timeToMaturity);
+        OptionParams timeToMaturityUpOption = params;
+        timeToMaturityUpOption.timeToMaturity = timeToMaturity + TIME_TO_MATURITY_JUMP;
+        const PathConstants extension = calculatePathConstants(params, TIME_TO_MATURITY_JUMP);
+        // The antithetic path's growth factor is exp(2 drift) divided by the path's own
+        const double antitheticGrowthNumerator = std::exp(2.0 * cachedDrift);
+
+        auto estimateLeg = [&](double normal, double extensionNormal, double growthFactor) {
+            const double terminalPrice = params.spotPrice * growthFactor;
+            double weight = 1.0;
+            double repricedNormal = normal;
+            if (reweights) {
+                repricedNormal = (cachedDrift + cachedDiffusion * normal - drift) / diffusion;
+                weight = std::exp(logWeightOffset + 0.5 * (normal * normal - repricedNormal * repricedNormal));
+            }
+            const double payoff = discountFactor * calculateVanillaPayoff(params, terminalPrice);
+            const double slope = discountFactor * calculatePayoffSlope(params, terminalPrice);
+            RepricedLegEstimates leg;
+            leg.payoff = weight * payoff;
+            leg.delta = weight * slope * terminalPrice / params.spotPrice;
+            leg.gamma = diffusion > 0.0 ? leg.delta / params.spotPrice * (repricedNormal / diffusion - 1.0) : 0.0;
+            leg.vega = weight * slope * terminalPrice * (sqrtTimeToMaturity * repricedNormal - params.volatility * timeToMaturity);
+            leg.rho = weight * (slope * terminalPrice * timeToMaturity - timeToMaturity * payoff);
+            const double extendedPrice = terminalPrice * std::exp(extension.drift + extension.diffusion * extensionNormal);
+            leg.theta = -weight * (calculateDiscountedPayoff(timeToMaturityUpOption, extendedPrice) - payoff) / TIME_TO_MATURITY_JUMP;
+            return leg;
+        };
+
+        const int numSimulations = int (paths.normals.size());
+        const bool antithetic = settings.varianceReduction.antithetic;
+        std::vector<double> payoffSamples(numSimulations);
+        std::vector<double> crudeSamples(numSimulations);
+        std::vector<double> deltaSamples, gammaSamples, vegaSamples, rhoSamples, thetaSamples;
+        if (settings.computeGreeks) {
+            for (std::vector<double>* estimates : { &deltaSamples, &gammaSamples, &vegaSamples, &rhoSamples, &thetaSamples }) {
+                estimates->resize(numSimulations);
+            }
+        }
+
+        const int numBlocks = (numSimulations + REPRICING_BLOCK_SIZE - 1) / REPRICING_BLOCK_SIZE;
+        parallelFor(0, numBlocks, settings.numThreads, [&](int, int firstBlock, int lastBlock) {
+            const int lastPath = std::min(lastBlock * REPRICING_BLOCK_SIZE, numSimulations);
+            for (int i = firstBlock * REPRICING_BLOCK_SIZE; i < lastPath; i++) {
+                const double growthFactor = paths.growthFactors[i];
+                const RepricedLegEstimates leg = estimateLeg(paths.normals[i], paths.extensionNormals[i], growthFactor);
+                const RepricedLegEstimates antitheticLeg = antithetic
+                 ? estimateLeg(-paths.normals[i], -paths.extensionNormals[i], antitheticGrowthNumerator / growthFactor) : leg;
+                auto combineLegs = [&](double estimate, double antitheticEstimate) {
+                    return antithetic ? 0.5 * (estimate + antitheticEstimate) : estimate;
+                };
+
+                payoffSamples[i] = combineLegs(leg.payoff, antitheticLeg.payoff);
+                crudeSamples[i] = leg.payoff;
+                if (settings.computeGreeks) {
+                    deltaSamples[i] = combineLegs(leg.delta, antitheticLeg.delta);
+                    gammaSamples[i] = combineLegs(leg.gamma, antitheticLeg.gamma);
+                    vegaSamples[i] = combineLegs(leg.vega, antitheticLeg.vega);
+                    rhoSamples[i] = combineLegs(leg.rho, antitheticLeg.rho);
+                    thetaSamples[i] = combineLegs(leg.theta, antitheticLeg.theta);
+                }
+            }
+        });
+
+        PricingStatistics statistics;
+        statistics.payoff = summarise(payoffSamples);
+        statistics.crude = summarise(crudeSamples);
+        statistics.delta = summarise(deltaSamples);
+        statistics.gamma = summarise(gammaSamples);
+        statistics.vega = summarise(vegaSamples);
+        statistics.rho = summarise(rhoSamples);
+        statistics.theta = summarise(thetaSamples);
+
+        PhaseStatistics phase = { "repricing" };
+        phase.paths = numSimulations;
+        for (const std::vector<double>* estimates : { &payoffSamples, &crudeSamples, &deltaSamples, &gammaSamples, &vegaSamples, &rhoSamples, &thetaSamples }) {
+            phase.bytesAllocated += (long long) (estimates->capacity() * sizeof(double));
+        }
+        stopPhaseClock(clock, phase);
+
+        const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        OptionResult result = createOptionResult(statistics, numSimulations, elapsedSeconds);
+        result.phases = { phase };
+        return result;
+    }
+
+    bool canReweight(const CachedPaths& paths, const OptionParams& params, const RepricingThresholds& thresholds) {
+        return paths.volatility > 0.0 && params.volatility > 0.0
+         && std::abs(params.volatility - paths.volatility) <= thresholds.volatility
+         && std::abs(params.riskFreeRate - paths.riskFreeRate) <= thresholds.riskFreeRate;
+    }
+}
+
+bool isIncrementallyRepriceable(const OptionParams& params, const SimulationSettings& settings) {
+    const VarianceReduction& varianceReduction = settings.varianceReduction;
+    return params.payoffStyle == PayoffStyle::European && !settings.forceSteppedPaths && !usesModelEngine(settings)
+     && settings.earlyExercise.style == ExerciseStyle::European && !settings.quasiRandom && !settings.singlePrecision && !isAdaptive(settings)
+     && !varianceReduction.terminalPriceControl && !varianceReduction.blackScholesControl
+     && !varianceReduction.importanceSampling && !varianceReduction.geometricAsianControl;
+}
+
+OptionResult repriceOption(RepricingCache& cache, const OptionParams& params, const SimulationSettings& settings) {
+    const bool repriceable = isIncrementallyRepriceable(params, settings);
+    const ResultKey resultKey = createResultKey(params);
+    std::shared_ptr<const CachedPaths> paths;
+    RepricingThresholds thresholds;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        const auto cachedResult = cache.results.find(resultKey);
+        if (repriceable && cachedResult != cache.results.end()) {
+            cache.counts.resultHits++;
+            return cachedResult->second;
+        }
+        const auto cachedPaths = cache.contracts.find(createContractKey(params));
+        if (repriceable && cachedPaths != cache.contracts.end()) {
+            paths = cachedPaths->second;
+        }
+        thresholds = cache.thresholds;
+    }
+
+    OptionResult result;
+    RepricingMethod method = RepricingMethod::Resimulation;
+    if (!repriceable) {
+        result = priceBatch({ params }, settings)[0];
+    }
+    else if (paths != nullptr && params.volatility == paths->volatility && params.riskFreeRate == paths->riskFreeRate) {
+        result = repriceFromPaths(*paths, params, settings);
+        method = RepricingMethod::SpotRescale;
+    }
+    else if (paths != nullptr && canReweight(*paths, params, thresholds)) {
+        result = repriceFromPaths(*paths, params, settings);
+        method = RepricingMethod::Reweighting;
+    }
+    else {
+        result = simulateAndCachePaths(params, settings, paths);
+    }
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    switch (method) {
+        case RepricingMethod::Resimulation:
+            cache.counts.resimulations++;
+            break;
+        case RepricingMethod::SpotRescale:
+            cache.counts.spotRescales++;
+            break;
+        case RepricingMethod::Reweighting:
+            cache.counts.reweightings++;
+            break;
+    }
+    if (!repriceable) {
+        return result;
+    }
+
+    if (int (cache.results.size()) >= REPRICING_CACHE_MAX_RESULTS) {
+        cache.results.clear();
+    }
+    cache.results[resultKey] = result;
+    if (method == RepricingMethod::Resimulation) {
+        if (int (cache.contracts.size()) >= REPRICING_CACHE_MAX_CONTRACTS) {
+            cache.contracts.clear();
+        }
+        cache.contracts[createContractKey(params)] = paths;
+    }
+    return result;
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include "Instrumentation.h"
+#include "Models.h"
+#include "MonteCarlo.h"
+#include "Parallel.h"
+#include "PathPayoffs.h"
+#include "Random.h"
+#include "ScenarioGrid.h"
+#include "Statistics.h"
+#include "Utils.h"
+
+namespace {
+    void validateScenarioSettings(const SimulationSettings& settings) {
+        const VarianceReduction& varianceReduction = settings.varianceReduction;
+        if (usesModelEngine(settings) || settings.earlyExercise.style != ExerciseStyle::European) {
+            throw std::runtime_error("scenario grids are only supported for European-exercise options under the flat-rate Black-Scholes model");
+        }
+        else if (settings.quasiRandom || isAdaptive(settings)) {
+            throw std::runtime_error("scenario grids do not support --qmc or adaptive path counts");
+        }
+        else if (varianceReduction.terminalPriceControl || varianceReduction.blackScholesControl
+         || varianceReduction.geometricAsianControl || varianceReduction.importanceSampling) {
+            throw std::runtime_error("scenario grids do not support control variates or importance sampling");
+        }
+    }
+}
+
+ScenarioResults runScenarioGrid(const OptionParams& params, const ScenarioGrid& grid, const SimulationSettings& settings) {
+    validateScenarioSettings(settings);
+    const auto startTime = std::chrono::steady_clock::now();
+    const PhaseClock clock = startPhaseClock();
+
+    ScenarioResults results;
+    for (double shift : grid.spotPriceShifts.empty() ? std::vector<double> { 0.0 } : grid.spotPriceShifts) {
+        if (1.0 + shift <= 0.0) {
+            throw std::runtime_error("every scenario's spot price must be positive");
+        }
+        results.spotPrices.push_back(params.spotPrice * (1.0 + shift));
+    }
+    for (double shift : grid.volatilityShifts.empty() ? std::vector<double> { 0.0 } : grid.volatilityShifts) {
+        if (params.volatility + shift < 0.0) {
+            throw std::runtime_error("every scenario's volatility must be non-negative");
+        }
+        results.volatilities.push_back(params.volatility + shift);
+    }
+    const int numSpotPrices = int (results.spotPrices.size());
+    const int numVolatilities = int (results.volatilities.size());
+    const int numNodes = numSpotPrices * numVolatilities;
+
+    // Node (i, j) prices the path at unit scale with the strike and barrier divided by spot i's scale factor, which is
+    // the same as pricing the path scaled up by that factor, and then multiplies the payoff back up
+    std::vector<double> spotScales(numSpotPrices);
+    std::vector<OptionParams> scaledOptions(numNodes);
+    std::vector<PayoffConstants> payoffs(numNodes);
+    for (int i = 0; i < numSpotPrices; i++) {
+        spotScales[i] = results.spotPrices[i] / params.spotPrice;
+        for (int j = 0; j < numVolatilities; j++) {
+            OptionParams& option = scaledOptions[i * numVolatilities + j];
+            option = params;
+            option.strikePrice /= spotScales[i];
+            option.barrierLevel /= spotScales[i];
+            option.volatility = results.volatilities[j];
+            payoffs[i * numVolatilities + j] = createPayoffConstants(option, false);
+        }
+    }
+
+    const TimeGrid timeGrid = createTimeGrid(params, settings);
+    const RandomNormals randomNormals = createGridNormals(timeGrid, settings);
+    const int numSteps = timeGrid.numSteps;
+    const double stepDt = timeGrid.stepDt;
+    const double sqrtStepDt = std::sqrt(stepDt);
+    const double simulatedTime = numSteps * stepDt;
+    const double logSpotPrice = std::log(params.spotPrice);
+    const double discountFactor = std::exp(-params.riskFreeRate * params.timeToMaturity);
+    const bool walksPathStates = isPathDependent(params.payoffStyle);
+    const bool walksPerSpotPrice = params.payoffStyle == PayoffStyle::Barrier;
+    const bool antithetic = settings.varianceReduction.antithetic;
+    const int numLegs = antithetic ? 2 : 1;
+
+    const int numSimulations = randomNormals.numSimulations;
+    const int numBlocks = (numSimulations + SCENARIO_BLOCK_SIZE - 1) / SCENARIO_BLOCK_SIZE;
+    std::vector<RunningStatistics> blockStatistics(std::size_t (numBlocks) * numNodes);
+    parallelFor(0, numBlocks, settings.numThreads, [&](int, int firstBlock, int lastBlock) {
+        std::vector<double> normalBuffer;
+        std::vector<double> brownianMotions(numSteps);
+        std::vector<double> nodePayoffs(numNodes);
+
+        // Walks one leg at volatility j from the spot price, scoring it against every node in [firstNode, lastNode)
+        // that shares its walk
+        auto walkLeg = [&](double sign, int j, int firstNode, int lastNode, int nodeStride) {
+            const double volatility = results.volatilities[j];
+            const double driftRate = params.riskFreeRate - volatility * volatility / 2.0;
+            const double stepVariance = volatility * volatility * stepDt;
+            PathState state = createPathState(payoffs[firstNode], logSpotPrice);
+            for (int step = 0; step < numSteps; step++) {
+                const double logPrice = logSpotPrice + driftRate * (step + 1) * stepDt + volatility * sign * brownianMotions[step];
+                observeModelPrice(state, payoffs[firstNode], logPrice, stepVariance, stepDt);
+            }
+            for (int node = firstNode; node < lastNode; node += nodeStride) {
+                nodePayoffs[node] += spotScales[node / numVolatilities] * evaluatePathPayoff(scaledOptions[node], payoffs[node], state).payoff;
+            }
+        };
+
+        for (int block = firstBlock; block < lastBlock; block++) {
+            const int firstPath = block * SCENARIO_BLOCK_SIZE;
+            const int lastPath = std::min(firstPath + SCENARIO_BLOCK_SIZE, numSimulations);
+            RunningStatistics* statistics = blockStatistics.data() + std::size_t (block) * numNodes;
+            for (int path = firstPath; path < lastPath; path++) {
+                // The one shared buffer: W at every step, which every scenario's log prices are built from
+                const double* normals = getPathNormals(randomNormals, path, numSteps, normalBuffer);
+                double brownianMotion = 0.0;
+                for (int step = 0; step < numSteps; step++) {
+                    brownianMotion += sqrtStepDt * normals[step];
+                    brownianMotions[step] = brownianMotion;
+                }
+
+                std::fill(nodePayoffs.begin(), nodePayoffs.end(), 0.0);
+                for (int leg = 0; leg < numLegs; leg++) {
+                    const double sign = leg == 0 ? 1.0 : -1.0;
+                    for (int j = 0; j < numVolatilities; j++) {
+                        if (walksPerSpotPrice) {
+                            for (int i = 0; i < numSpotPrices; i++) {
+                                const int node = i * numVolatilities + j;
+                                walkLeg(sign, j, node, node + 1, 1);
+                            }
+                        }
+                        else if (walksPathStates) {
+                            walkLeg(sign, j, j, numNodes, numVolatilities);
+                        }
+                        else {
+                            const double volatility = results.volatilities[j];
+                            const double growthFactor = std::exp((params.riskFreeRate - volatility * volatility / 2.0) * simulatedTime
+                             + volatility * sign * brownianMotion);
+                            for (int i = 0; i < numSpotPrices; i++) {
+                                nodePayoffs[i * numVolatilities + j] += calculateVanillaPayoff(params, results.spotPrices[i] * growthFactor);
+                            }
+                        }
+                    }
+                }
+                for (int node = 0; node < numNodes; node++) {
+                    addSample(statistics[node], discountFactor * nodePayoffs[node] / numLegs);
+                }
+            }
+        }
+    });
+
+    results.prices.resize(numNodes);
+    results.standardErrors.resize(numNodes);
+    for (int node = 0; node < numNodes; node++) {
+        RunningStatistics statistics;
+        for (int block = 0; block < numBlocks; block++) {
+            mergeStatistics(statistics, blockStatistics[std::size_t (block) * numNodes + node]);
+        }
+        results.prices[node] = statistics.mean;
+        results.standardErrors[node] = calculateStandardError(statistics);
+    }
+
+    results.phase = { "scenario sweep" };
+    results.phase.paths = numSimulations;
+    results.phase.steps = (long long) (numSimulations) * numSteps * numVolatilities * (walksPerSpotPrice ? numSpotPrices : 1);
+    results.phase.randomDraws = (long long) (numSimulations) * numSteps;
+    results.phase.bytesAllocated = (long long) (getStoredNormalBytes(randomNormals))
+     + (long long) (blockStatistics.capacity() * sizeof(RunningStatistics));
+    stopPhaseClock(clock, results.phase);
+    results.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return results;
+}
+
+void outputScenarioResults(const ScenarioResults& results) {
+    constexpr int COLUMN_WIDTH = 12;
+    const int numVolatilities = int (results.volatilities.size());
+    std::cout << std::endl << std::fixed << std::setprecision(2) << std::setw(COLUMN_WIDTH) << "Spot \\ Vol";
+    for (double volatility : results.volatilities) {
+        std::cout << std::setw(COLUMN_WIDTH - 1) << volatility * 100.0 << "%";
+    }
+    std::cout << std::endl;
+    for (std::size_t i = 0; i < results.spotPrices.size(); i++) {
+        std::cout << std::setprecision(2) << std::setw(COLUMN_WIDTH) << results.spotPrices[i] << std::setprecision(5);
+        for (int j = 0; j < numVolatilities; j++) {
+            std::cout << std::setw(COLUMN_WIDTH) << results.prices[i * numVolatilities + j];
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::defaultfloat << std::endl;
+
+    outputRow("Scenarios", std::to_string(results.prices.size()));
+    outputRow("Largest standard error", prepareForOutput(*std::max_element(results.standardErrors.begin(), results.standardErrors.end())));
+    outputRow("Elapsed time (s)", prepareForOutput(results.elapsedSeconds));
+}
+
+void writeScenarioStatisticsJson(const std::filesystem::path& outputPath, const ScenarioResults& results) {
+    std::ofstream outputFile(outputPath);
+    if (!outputFile) {
+        throw std::runtime_error("could not open " + outputPath.string() + " for writing");
+    }
+
+    outputFile << std::setprecision(std::numeric_limits<double>::digits10);
+    outputFile << "{\n"
+               << "  \"scenarios\": " << results.prices.size() << ",\n"
+               << "  \"largestStandardError\": " << *std::max_element(results.standardErrors.begin(), results.standardErrors.end()) << ",\n"
+               << "  \"numPaths\": " << results.phase.paths << ",\n"
+               << "  \"elapsedSeconds\": " << results.elapsedSeconds << ",\n";
+    writePhaseStatisticsJson(outputFile, { results.phase });
+    outputFile << "}\n";
+}
+
+int runScenarioPricing(const OptionParams& params, const SimulationSettings& settings) {
+    try {
+        const ScenarioResults results = runScenarioGrid(params, settings.scenarioGrid, settings);
+        outputScenarioResults(results);
+        if (settings.outputStatistics) {
+            outputPhaseStatistics({ results.phase });
+        }
+        if (!settings.statisticsJsonPath.empty()) {
+            writeScenarioStatisticsJson(settings.statisticsJsonPath, results);
+        }
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
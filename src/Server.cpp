@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Batch.h"
+#include "Repricing.h"
+#include "Server.h"
+#include "Utils.h"
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+    #ifdef _WIN32
+        using SocketHandle = SOCKET;
+        constexpr SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+        constexpr int SEND_FLAGS = 0;
+        constexpr int SHUTDOWN_BOTH = SD_BOTH;
+
+        void closeSocket(SocketHandle socketHandle) {
+            closesocket(socketHandle);
+        }
+
+        // Winsock has to be started before any socket is opened
+        struct SocketLibrary {
+            SocketLibrary() {
+                WSADATA data;
+                if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+                    throw std::runtime_error("could not start Winsock");
+                }
+            }
+            ~SocketLibrary() {
+                WSACleanup();
+            }
+        };
+    #else
+        using SocketHandle = int;
+        constexpr SocketHandle INVALID_SOCKET_HANDLE = -1;
+        constexpr int SEND_FLAGS = MSG_NOSIGNAL; // A client that has gone away must not kill the server with SIGPIPE
+        constexpr int SHUTDOWN_BOTH = SHUT_RDWR;
+
+        void closeSocket(SocketHandle socketHandle) {
+            close(socketHandle);
+        }
+
+        struct SocketLibrary {};
+    #endif
+
+    const std::string SHUTDOWN_COMMAND = "SHUTDOWN";
+
+    bool isPortNumber(const std::string& address) {
+        return isPositiveInteger(address.c_str()) && address.length() <= 5 && std::stoi(address) <= 65535;
+    }
+
+    SocketHandle openListeningSocket(const std::string& address) {
+        SocketHandle listener;
+        if (isPortNumber(address)) {
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            if (listener == INVALID_SOCKET_HANDLE) {
+                throw std::runtime_error("could not open a TCP socket");
+            }
+            const int reuseAddress = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress));
+            sockaddr_in socketAddress = {};
+            socketAddress.sin_family = AF_INET;
+            socketAddress.sin_port = htons(std::uint16_t (std::stoi(address)));
+            socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(listener, reinterpret_cast<const sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0) {
+                closeSocket(listener);
+                throw std::runtime_error("could not listen on port " + address);
+            }
+        }
+        else {
+        #ifdef _WIN32
+            throw std::runtime_error("the server only listens on TCP ports on Windows");
+        #else
+            sockaddr_un socketAddress = {};
+            if (address.length() >= sizeof(socketAddress.sun_path)) {
+                throw std::runtime_error("the socket path " + address + " is too long");
+            }
+            // A socket file left behind by an earlier server would make bind fail; anything else is left alone
+            if (std::filesystem::is_socket(address)) {
+                std::filesystem::remove(address);
+            }
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener == INVALID_SOCKET_HANDLE) {
+                throw std::runtime_error("could not open a Unix domain socket");
+            }
+            socketAddress.sun_family = AF_UNIX;
+            std::copy(address.begin(), address.end(), socketAddress.sun_path);
+            if (bind(listener, reinterpret_cast<const sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0) {
+                closeSocket(listener);
+                throw std::runtime_error("could not listen on " + address);
+            }
+        #endif
+        }
+
+        if (listen(listener, SERVER_LISTEN_BACKLOG) != 0) {
+            closeSocket(listener);
+            throw std::runtime_error("could not listen on " + address);
+        }
+        return listener;
+    }
+
+    // Sends all of text, giving up quietly if the client has disconnected
+    void sendText(SocketHandle socketHandle, const std::string& text) {
+        std::size_t sent = 0;
+        while (sent < text.length()) {
+            const int chunk = int (std::min<std::size_t>(text.length() - sent, std::numeric_limits<int>::max()));
+            const auto result = send(socketHandle, text.data() + sent, chunk, SEND_FLAGS);
+            if (result <= 0) {
+                return;
+            }
+            sent += std::size_t (result);
+        }
+    }
+
+    // Only the pricer writes to a connection once it has been greeted, so replies need no lock of their own. The socket
+    // is closed when the last quote holding the connection has been answered.
+    struct Connection {
+        SocketHandle socketHandle;
+
+        ~Connection() {
+            closeSocket(socketHandle);
+        }
+    };
+
+    struct PendingQuote {
+        std::shared_ptr<Connection> connection;
+        OptionParams option;
+        std::string error; // Set instead of pricing when the row could not be read
+        bool isShutdown = false;
+        std::chrono::steady_clock::time_point arrivalTime;
+    };
+
+    struct ServerState {
+        std::mutex mutex;
+        std::condition_variable quotesArrived;
+        std::condition_variable readersStopped;
+        std::deque<PendingQuote> queue;
+        std::vector<std::weak_ptr<Connection>> connections;
+        int numReaders = 0;
+    };
+
+    // Splits everything the client sends into lines and queues them, one lock per chunk received
+    void readQuotes(std::shared_ptr<ServerState> state, std::shared_ptr<Connection> connection) {
+        std::vector<char> buffer(SERVER_READ_BUFFER_SIZE);
+        std::string partialLine;
+        std::vector<PendingQuote> received;
+        while (true) {
+            const auto numBytes = recv(connection->socketHandle, buffer.data(), int (buffer.size()), 0);
+            if (numBytes <= 0) {
+                break;
+            }
+
+            received.clear();
+            const auto arrivalTime = std::chrono::steady_clock::now();
+            std::size_t lineStart = 0;
+            bool isLineTooLong = false;
+            partialLine.append(buffer.data(), std::size_t (numBytes));
+            for (std::size_t lineEnd = partialLine.find('\n'); lineEnd != std::string::npos; lineEnd = partialLine.find('\n', lineStart)) {
+                if (lineEnd - lineStart > SERVER_MAX_LINE_BYTES) {
+                    isLineTooLong = true;
+                    break;
+                }
+                std::string line = partialLine.substr(lineStart, lineEnd - lineStart);
+                lineStart = lineEnd + 1;
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (line.empty()) {
+                    continue;
+                }
+
+                PendingQuote quote;
+                quote.connection = connection;
+                quote.arrivalTime = arrivalTime;
+                if (line == SHUTDOWN_COMMAND) {
+                    quote.isShutdown = true;
+                }
+                else {
+                    try {
+                        quote.option = parsePortfolioRow(splitCsvLine(line), "the request");
+                    }
+                    catch (const std::exception& error) {
+                        quote.error = error.what();
+                    }
+                }
+                received.push_back(std::move(quote));
+            }
+            partialLine.erase(0, lineStart);
+
+            // The error is answered in turn like any quote, and the connection closes once the reader lets go of it
+            isLineTooLong = isLineTooLong || partialLine.size() > SERVER_MAX_LINE_BYTES;
+            if (isLineTooLong) {
+                PendingQuote quote;
+                quote.connection = connection;
+                quote.arrivalTime = arrivalTime;
+                quote.error = "line longer than " + std::to_string(SERVER_MAX_LINE_BYTES) + " bytes; closing the connection";
+                received.push_back(std::move(quote));
+            }
+            if (!received.empty()) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                std::move(received.begin(), received.end(), std::back_inserter(state->queue));
+                state->quotesArrived.notify_one();
+            }
+            if (isLineTooLong) {
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->numReaders--;
+        state->readersStopped.notify_all();
+    }
+
+    void acceptConnections(std::shared_ptr<ServerState> state, SocketHandle listener, bool isTcp) {
+        while (true) {
+            const SocketHandle socketHandle = accept(listener, nullptr, nullptr);
+            if (socketHandle == INVALID_SOCKET_HANDLE) {
+                return;
+            }
+            if (isTcp) {
+                // Replies are small and latency-sensitive, so send them at once rather than waiting to fill a segment
+                const int noDelay = 1;
+                setsockopt(socketHandle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+            }
+            const std::shared_ptr<Connection> connection = std::make_shared<Connection>();
+            connection->socketHandle = socketHandle;
+            sendText(socketHandle, std::string(BATCH_RESULT_HEADER) + '\n');
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->connections.erase(std::remove_if(state->connections.begin(), state->connections.end(),
+             [](const std::weak_ptr<Connection>& existing) { return existing.expired(); }), state->connections.end());
+            state->connections.push_back(connection);
+            state->numReaders++;
+            std::thread(readQuotes, state, connection).detach();
+        }
+    }
+
+    // Waits for quotes, then for up to SERVER_BATCH_WINDOW_MICROSECONDS after the oldest one arrived in case more
+    // follow, and takes at most SERVER_MAX_BATCH_SIZE of them
+    std::vector<PendingQuote> takeBatch(ServerState& state) {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.quotesArrived.wait(lock, [&]() { return !state.queue.empty(); });
+        const auto deadline = state.queue.front().arrivalTime + std::chrono::microseconds(SERVER_BATCH_WINDOW_MICROSECONDS);
+        state.quotesArrived.wait_until(lock, deadline, [&]() { return int (state.queue.size()) >= SERVER_MAX_BATCH_SIZE; });
+
+        const int batchSize = std::min(int (state.queue.size()), SERVER_MAX_BATCH_SIZE);
+        std::vector<PendingQuote> batch(std::make_move_iterator(state.queue.begin()), std::make_move_iterator(state.queue.begin() + batchSize));
+        state.queue.erase(state.queue.begin(), state.queue.begin() + batchSize);
+        return batch;
+    }
+
+    // Quotes that repriceOption can answer from earlier work go through the repricing cache, one by one. The rest are
+    // priced together; if that fails, each is priced alone so one bad quote cannot fail the others.
+    std::vector<std::string> priceQuotes(const std::vector<OptionParams>& options, const SimulationSettings& settings,
+     NormalsCache& normalsCache, RepricingCache& repricingCache) {
+        std::vector<std::string> replies(options.size());
+        auto formatReply = [](const OptionParams& option, const OptionResult& result) {
+            std::ostringstream reply;
+            reply << std::setprecision(std::numeric_limits<double>::digits10);
+            writeBatchResultRow(reply, option, result);
+            return reply.str();
+        };
+        auto formatError = [](const std::exception& error) {
+            return std::string("ERROR,") + error.what() + '\n';
+        };
+
+        std::vector<OptionParams> batchOptions;
+        std::vector<std::size_t> batchIndices;
+        for (std::size_t i = 0; i < options.size(); i++) {
+            if (!isIncrementallyRepriceable(options[i], settings)) {
+                batchOptions.push_back(options[i]);
+                batchIndices.push_back(i);
+                continue;
+            }
+            try {
+                replies[i] = formatReply(options[i], repriceOption(repricingCache, options[i], settings));
+            }
+            catch (const std::exception& error) {
+                replies[i] = formatError(error);
+            }
+        }
+
+        try {
+            const std::vector<OptionResult> results = priceBatch(batchOptions, settings, &normalsCache);
+            for (std::size_t i = 0; i < batchOptions.size(); i++) {
+                replies[batchIndices[i]] = formatReply(batchOptions[i], results[i]);
+            }
+        }
+        catch (const std::exception&) {
+            for (std::size_t i = 0; i < batchOptions.size(); i++) {
+                try {
+                    replies[batchIndices[i]] = formatReply(batchOptions[i], priceBatch({ batchOptions[i] }, settings, &normalsCache)[0]);
+                }
+                catch (const std::exception& error) {
+                    replies[batchIndices[i]] = formatError(error);
+                }
+            }
+        }
+        return replies;
+    }
+}
+
+int runPricingServer(const std::string& address, const SimulationSettings& settings) {
+    const bool isTcp = isPortNumber(address);
+    std::unique_ptr<SocketLibrary> socketLibrary;
+    SocketHandle listener;
+    try {
+        socketLibrary = std::make_unique<SocketLibrary>();
+        listener = openListeningSocket(address);
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return EXIT_FAILURE;
+    }
+
+    const std::shared_ptr<ServerState> state = std::make_shared<ServerState>();
+    std::thread acceptor(acceptConnections, state, listener, isTcp);
+    std::cout << "Pricing server listening on " << (isTcp ? "127.0.0.1:" : "") << address << std::endl;
+
+    NormalsCache normalsCache;
+    RepricingCache repricingCache;
+    repricingCache.thresholds = settings.repricingThresholds;
+    long long numQuotes = 0;
+    long long numBatches = 0;
+    double totalQueueingSeconds = 0.0;
+    double totalPricingSeconds = 0.0;
+    bool isShuttingDown = false;
+    while (!isShuttingDown) {
+        const std::vector<PendingQuote> batch = takeBatch(*state);
+        const auto startTime = std::chrono::steady_clock::now();
+
+        std::vector<OptionParams> options;
+        for (const PendingQuote& quote : batch) {
+            if (!quote.isShutdown && quote.error.empty()) {
+                options.push_back(quote.option);
+                totalQueueingSeconds += std::chrono::duration<double>(startTime - quote.arrivalTime).count();
+            }
+        }
+        const std::vector<std::string> pricedReplies = priceQuotes(options, settings, normalsCache, repricingCache);
+
+        // Gather each connection's replies in the order it sent them, so each client gets one write per batch
+        std::unordered_map<Connection*, std::string> replies;
+        std::size_t nextPriced = 0;
+        for (const PendingQuote& quote : batch) {
+            std::string& connectionReplies = replies[quote.connection.get()];
+            if (quote.isShutdown) {
+                connectionReplies += "OK\n";
+                isShuttingDown = true;
+            }
+            else if (!quote.error.empty()) {
+                connectionReplies += "ERROR," + quote.error + '\n';
+            }
+            else {
+                connectionReplies += pricedReplies[nextPriced++];
+            }
+        }
+        for (const auto& [connection, text] : replies) {
+            sendText(connection->socketHandle, text);
+        }
+
+        numQuotes += (long long) (options.size());
+        numBatches++;
+        totalPricingSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    // Stop accepting, then disconnect every client so that their readers return
+    shutdown(listener, SHUTDOWN_BOTH);
+    acceptor.join();
+    closeSocket(listener);
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        for (const std::weak_ptr<Connection>& weakConnection : state->connections) {
+            if (const std::shared_ptr<Connection> connection = weakConnection.lock()) {
+                shutdown(connection->socketHandle, SHUTDOWN_BOTH);
+            }
+        }
+        state->readersStopped.wait(lock, [&]() { return state->numReaders == 0; });
+    }
+    if (!isTcp) {
+        std::filesystem::remove(address);
+    }
+
+    outputRow("Quotes priced", std::to_string(numQuotes));
+    outputRow("Batches", std::to_string(numBatches));
+    outputRow("Mean batch size", prepareForOutput(double (numQuotes) / std::max(numBatches, 1LL)));
+    const RepricingCounts& counts = repricingCache.counts;
+    outputRow("Repriced from cache", std::to_string(counts.resultHits + counts.spotRescales + counts.reweightings));
+    outputRow("Mean queueing delay (us)", prepareForOutput(totalQueueingSeconds * 1e6 / std::max(numQuotes, 1LL)));
+    outputRow("Throughput (quotes/sec)", prepareForOutput(numQuotes / std::max(totalPricingSeconds, 1e-9)));
+    return EXIT_SUCCESS;
+}
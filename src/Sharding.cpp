@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "Instrumentation.h"
+#include "Models.h"
+#include "Parallel.h"
+#include "Sharding.h"
+#include "Utils.h"
+
+namespace {
+    constexpr int SHARD_DIGITS = 17; // Enough for every double to read back as itself
+
+    void validateShardSettings(const SimulationSettings& settings) {
+        const VarianceReduction& varianceReduction = settings.varianceReduction;
+        if (usesModelEngine(settings) || settings.earlyExercise.style != ExerciseStyle::European) {
+            throw std::runtime_error("sharded runs are only supported for European-exercise options under the flat-rate Black-Scholes model");
+        }
+        else if (settings.quasiRandom || isAdaptive(settings)) {
+            throw std::runtime_error("sharded runs do not support --qmc or adaptive path counts");
+        }
+        else if (varianceReduction.terminalPriceControl || varianceReduction.blackScholesControl || varianceReduction.geometricAsianControl) {
+            throw std::runtime_error("sharded runs do not support control variates, whose coefficients need every path at once");
+        }
+        else if (hasScenarioGrid(settings) || settings.dumpPayoffs) {
+            throw std::runtime_error("sharded runs do not support scenario grids or --dump-payoffs");
+        }
+    }
+
+    // The blocks [first, last) merged pairwise, so the rounding error grows with the logarithm of the block count
+    PricingStatistics mergeBlocks(const std::vector<const PricingStatistics*>& blocks, std::size_t first, std::size_t last) {
+        if (last - first == 1) {
+            return *blocks[first];
+        }
+        const std::size_t middle = first + (last - first) / 2;
+        PricingStatistics statistics = mergeBlocks(blocks, first, middle);
+        mergePricingStatistics(statistics, mergeBlocks(blocks, middle, last));
+        return statistics;
+    }
+
+    void writeRunningStatistics(std::ostream& output, const RunningStatistics& statistics) {
+        output << "," << statistics.count << "," << statistics.mean << "," << statistics.sumSquaredDeviations;
+    }
+
+    RunningStatistics readRunningStatistics(const std::vector<std::string>& fields, std::size_t first) {
+        RunningStatistics statistics;
+        statistics.count = std::stoll(fields[first]);
+        statistics.mean = std::stod(fields[first + 1]);
+        statistics.sumSquaredDeviations = std::stod(fields[first + 2]);
+        return statistics;
+    }
+
+    std::string quoteArgument(const std::string& argument) {
+        #ifdef _WIN32
+            return "\"" + argument + "\"";
+        #else
+            std::string quoted = "'";
+            for (char character : argument) {
+                quoted += character == '\'' ? std::string("'\\''") : std::string(1, character);
+            }
+            return quoted + "'";
+        #endif
+    }
+
+    // The workers share this machine's threads, and all use this process's seed, which may have been generated
+    std::string buildWorkerCommand(const std::vector<std::string>& optionArguments, const SimulationSettings& settings,
+     int shardIndex, const std::filesystem::path& outputPath) {
+        const ShardSettings& shard = settings.shard;
+        const int numWorkerThreads = std::max(1, resolveThreadCount(settings.numThreads) / shard.numWorkers);
+        std::string command = quoteArgument(shard.executablePath);
+        for (const std::string& flag : shard.workerFlags) {
+            command += " " + quoteArgument(flag);
+        }
+        command += " --seed " + std::to_string(settings.seed) + " --threads " + std::to_string(numWorkerThreads)
+         + " --graph-paths 0 --shard " + std::to_string(shardIndex) + "/" + std::to_string(shard.numWorkers)
+         + " --shard-output " + quoteArgument(outputPath.string());
+        for (const std::string& argument : optionArguments) {
+            command += " " + quoteArgument(argument);
+        }
+        #ifdef _WIN32
+            return "\"" + command + " > nul\"";
+        #else
+            return command + " > /dev/null";
+        #endif
+    }
+
+    // Starts one worker process per shard, waits for them all and reads back their shard files
+    std::vector<ShardStatistics> runLocalWorkers(const std::vector<std::string>& optionArguments, const SimulationSettings& settings) {
+        const int numWorkers = settings.shard.numWorkers;
+        const std::string runName = "MonteCarlo-" + std::to_string(settings.seed) + "-"
+         + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        std::vector<std::filesystem::path> outputPaths(numWorkers);
+        std::vector<int> exitCodes(numWorkers);
+        std::vector<std::thread> workers;
+        for (int k = 0; k < numWorkers; k++) {
+            outputPaths[k] = std::filesystem::temp_directory_path() / (runName + "-shard" + std::to_string(k) + ".csv");
+            const std::string command = buildWorkerCommand(optionArguments, settings, k, outputPaths[k]);
+            workers.emplace_back([command, k, &exitCodes]() {
+                exitCodes[k] = std::system(command.c_str());
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        std::vector<ShardStatistics> shards;
+        std::string error;
+        for (int k = 0; k < numWorkers; k++) {
+            if (exitCodes[k] != 0 && error.empty()) {
+                error = "worker " + std::to_string(k) + " exited with code " + std::to_string(exitCodes[k]);
+            }
+            else if (error.empty()) {
+                shards.push_back(readShardFile(outputPaths[k]));
+            }
+            std::error_code ignored;
+            std::filesystem::remove(outputPaths[k], ignored);
+        }
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+        return shards;
+    }
+}
+
+int getNumShardBlocks(int numPaths) {
+    return int ((numPaths + (long long) (SHARD_BLOCK_SIZE) - 1) / SHARD_BLOCK_SIZE);
+}
+
+std::string describeShardedRun(const OptionParams& params, const SimulationSettings& settings) {
+    std::ostringstream run;
+    run << std::setprecision(SHARD_DIGITS)
+        << "spotPrice=" << params.spotPrice << ";strikePrice=" << params.strikePrice
+        << ";timeToMaturity=" << params.timeToMaturity << ";riskFreeRate=" << params.riskFreeRate
+        << ";volatility=" << params.volatility << ";optionType=" << (params.optionType == OptionType::Call ? "Call" : "Put")
+        << ";payoffStyle=" << getPayoffStyleName(params.payoffStyle);
+    if (params.payoffStyle == PayoffStyle::Barrier) {
+        run << ";barrierType=" << getBarrierTypeName(params.barrierType) << ";barrierLevel=" << params.barrierLevel;
+    }
+    run << ";seed=" << settings.seed << ";paths=" << settings.numSimulations
+        << ";antithetic=" << settings.varianceReduction.antithetic
+        << ";importanceSampling=" << settings.varianceReduction.importanceSampling
+        << ";stepped=" << settings.forceSteppedPaths << ";barrierStepDays=" << settings.barrierStepDays
+        << ";singlePrecision=" << settings.singlePrecision << ";greeks=" << settings.computeGreeks;
+    return run.str();
+}
+
+ShardStatistics runShard(const OptionParams& params, int shardIndex, int numShards, const SimulationSettings& settings) {
+    validateShardSettings(settings);
+    if (shardIndex < 0 || shardIndex >= numShards) {
+        throw std::runtime_error("the shard index must be below the shard count");
+    }
+
+    const int numPaths = settings.numSimulations;
+    const int numBlocks = getNumShardBlocks(numPaths);
+    ShardStatistics shard = { describeShardedRun(params, settings), shardIndex, numShards, numPaths,
+     int ((long long) (numBlocks) * shardIndex / numShards), {}, {} };
+    const int lastBlock = int ((long long) (numBlocks) * (shardIndex + 1) / numShards);
+
+    // Streamed normals are keyed by each path's index in the whole run, so a block draws the same paths in any shard
+    const TimeGrid grid = createTimeGrid(params, settings);
+    RandomNormals randomNormals = createRandomNormals(SHARD_BLOCK_SIZE, getNumGridSteps(grid), settings.seed, true, settings.numThreads, false);
+    for (int block = shard.firstBlock; block < lastBlock; block++) {
+        randomNormals.firstPath = block * SHARD_BLOCK_SIZE;
+        randomNormals.numSimulations = std::min(SHARD_BLOCK_SIZE, numPaths - randomNormals.firstPath);
+        const FusedPayoffSamples samples = simulateFusedPayoffs(params, grid, randomNormals, false, "", settings);
+        addPhaseStatistics(shard.phases, samples.phase);
+
+        const PhaseClock clock = startPhaseClock();
+        PricingStatistics statistics;
+        accumulatePricingStatistics(statistics, samples, samples.base, randomNormals);
+        shard.blocks.push_back(statistics);
+        PhaseStatistics estimatorPhase = { "estimators" };
+        estimatorPhase.paths = randomNormals.numSimulations;
+        stopPhaseClock(clock, estimatorPhase);
+        addPhaseStatistics(shard.phases, estimatorPhase);
+    }
+    return shard;
+}
+
+void writeShardFile(const std::filesystem::path& outputPath, const ShardStatistics& shard) {
+    std::ofstream outputFile(outputPath);
+    if (!outputFile) {
+        throw std::runtime_error("could not open " + outputPath.string() + " for writing");
+    }
+    outputFile << std::setprecision(SHARD_DIGITS) << SHARD_FILE_HEADER << "\n"
+               << "run," << shard.run << "\n"
+               << "shard," << shard.shardIndex << "," << shard.numShards << "," << shard.numPaths << "\n";
+    for (const PhaseStatistics& phase : shard.phases) {
+        outputFile << "phase," << phase.name << "," << phase.wallSeconds << "," << phase.cpuSeconds << "," << phase.paths
+                   << "," << phase.steps << "," << phase.randomDraws << "," << phase.bytesAllocated << "\n";
+    }
+    for (std::size_t i = 0; i < shard.blocks.size(); i++) {
+        const PricingStatistics& block = shard.blocks[i];
+        outputFile << "block," << shard.firstBlock + int (i);
+        for (const RunningStatistics* statistics : { &block.payoff, &block.crude, &block.delta, &block.gamma, &block.vega, &block.rho, &block.theta }) {
+            writeRunningStatistics(outputFile, *statistics);
+        }
+        outputFile << "\n";
+    }
+    if (!outputFile) {
+        throw std::runtime_error("could not write " + outputPath.string());
+    }
+}
+
+ShardStatistics readShardFile(const std::filesystem::path& inputPath) {
+    std::ifstream inputFile(inputPath);
+    if (!inputFile) {
+        throw std::runtime_error("could not open " + inputPath.string());
+    }
+    std::string line;
+    if (!std::getline(inputFile, line) || line != SHARD_FILE_HEADER) {
+        throw std::runtime_error(inputPath.string() + " is not a shard file");
+    }
+
+    ShardStatistics shard = { "", 0, 0, 0, 0, {}, {} };
+    bool hasShardLine = false;
+    int lineNumber = 1;
+    while (std::getline(inputFile, line)) {
+        lineNumber++;
+        if (line.empty()) {
+            continue;
+        }
+        const std::string location = inputPath.string() + " line " + std::to_string(lineNumber);
+        if (line.rfind("run,", 0) == 0) {
+            shard.run = line.substr(4);
+            continue;
+        }
+        const std::vector<std::string> fields = splitCsvLine(line);
+        try {
+            if (fields[0] == "shard" && fields.size() == 4) {
+                shard.shardIndex = std::stoi(fields[1]);
+                shard.numShards = std::stoi(fields[2]);
+                shard.numPaths = std::stoi(fields[3]);
+                hasShardLine = true;
+            }
+            else if (fields[0] == "phase" && fields.size() == 8) {
+                PhaseStatistics phase = { fields[1], std::stod(fields[2]), std::stod(fields[3]), std::stoll(fields[4]),
+                 std::stoll(fields[5]), std::stoll(fields[6]), std::stoll(fields[7]) };
+                shard.phases.push_back(phase);
+            }
+            else if (fields[0] == "block" && fields.size() == 23) {
+                const int block = std::stoi(fields[1]);
+                if (shard.blocks.empty()) {
+                    shard.firstBlock = block;
+                }
+                else if (block != shard.firstBlock + int (shard.blocks.size())) {
+                    throw std::runtime_error("blocks out of order");
+                }
+                shard.blocks.push_back({ readRunningStatistics(fields, 2), readRunningStatistics(fields, 5), readRunningStatistics(fields, 8),
+                 readRunningStatistics(fields, 11), readRunningStatistics(fields, 14), readRunningStatistics(fields, 17), readRunningStatistics(fields, 20) });
+            }
+            else {
+                throw std::runtime_error("unrecognised row");
+            }
+        }
+        catch (const std::runtime_error& error) {
+            throw std::runtime_error(location + ": " + error.what());
+        }
+        catch (const std::exception&) {
+            throw std::runtime_error(location + ": malformed number");
+        }
+    }
+    if (!hasShardLine || shard.run.empty()) {
+        throw std::runtime_error(inputPath.string() + " is incomplete");
+    }
+    return shard;
+}
+
+OptionResult mergeShards(const std::vector<ShardStatistics>& shards, double elapsedSeconds) {
+    if (shards.empty()) {
+        throw std::runtime_error("no shards to merge");
+    }
+    const ShardStatistics& firstShard = shards.front();
+    const int numBlocks = getNumShardBlocks(firstShard.numPaths);
+    std::vector<const PricingStatistics*> blocks(numBlocks, nullptr);
+    std::vector<PhaseStatistics> phases;
+    for (const ShardStatistics& shard : shards) {
+        if (shard.run != firstShard.run || shard.numPaths != firstShard.numPaths) {
+            throw std::runtime_error("shard " + std::to_string(shard.shardIndex) + " belongs to a different run");
+        }
+        for (std::size_t i = 0; i < shard.blocks.size(); i++) {
+            const int block = shard.firstBlock + int (i);
+            if (block < 0 || block >= numBlocks || blocks[block] != nullptr) {
+                throw std::runtime_error("block " + std::to_string(block) + " appears more than once or lies outside the run");
+            }
+            blocks[block] = &shard.blocks[i];
+        }
+        for (const PhaseStatistics& phase : shard.phases) {
+            addPhaseStatistics(phases, phase);
+        }
+    }
+    for (int block = 0; block < numBlocks; block++) {
+        if (blocks[block] == nullptr) {
+            throw std::runtime_error("block " + std::to_string(block) + " is missing; every shard of the run is needed");
+        }
+    }
+
+    const PhaseClock clock = startPhaseClock();
+    const PricingStatistics statistics = numBlocks > 0 ? mergeBlocks(blocks, 0, blocks.size()) : PricingStatistics {};
+    PhaseStatistics mergePhase = { "shard merge" };
+    mergePhase.paths = firstShard.numPaths;
+    stopPhaseClock(clock, mergePhase);
+    phases.push_back(mergePhase);
+
+    OptionResult result = createOptionResult(statistics, firstShard.numPaths, elapsedSeconds);
+    result.phases = phases;
+    return result;
+}
+
+int runShardedPricing(const OptionParams& params, const std::vector<std::string>& optionArguments, const SimulationSettings& settings) {
+    const ShardSettings& shard = settings.shard;
+    try {
+        if (shard.numShards > 0) {
+            writeShardFile(shard.outputPath, runShard(params, shard.shardIndex, shard.numShards, settings));
+            std::cout << "Wrote shard " << shard.shardIndex << " of " << shard.numShards << " to " << shard.outputPath << "." << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        validateShardSettings(settings);
+        const auto startTime = std::chrono::steady_clock::now();
+        std::cout << "Simulating paths on " << shard.numWorkers << " worker processes..." << std::endl;
+        const std::vector<ShardStatistics> shards = runLocalWorkers(optionArguments, settings);
+        const std::string run = describeShardedRun(params, settings);
+        for (const ShardStatistics& workerShard : shards) {
+            if (workerShard.run != run) {
+                throw std::runtime_error("worker " + std::to_string(workerShard.shardIndex) + " priced a different run");
+            }
+        }
+        OptionResult result = mergeShards(shards, std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+        outputResults(result);
+        return outputRunStatistics(result, settings) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return EXIT_FAILURE;
+    }
+}
+
+int runShardMerge(const std::vector<std::filesystem::path>& inputPaths, const SimulationSettings& settings) {
+    try {
+        // Shards run side by side, so the run took as long as its slowest shard
+        std::vector<ShardStatistics> shards;
+        double elapsedSeconds = 0.0;
+        for (const std::filesystem::path& inputPath : inputPaths) {
+            shards.push_back(readShardFile(inputPath));
+            double shardSeconds = 0.0;
+            for (const PhaseStatistics& phase : shards.back().phases) {
+                shardSeconds += phase.wallSeconds;
+            }
+            elapsedSeconds = std::max(elapsedSeconds, shardSeconds);
+        }
+        OptionResult result = mergeShards(shards, elapsedSeconds);
+        outputResults(result);
+        return outputRunStatistics(result, settings) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return EXIT_FAILURE;
+    }
+}
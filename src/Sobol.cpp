@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "Random.h"
+#include "Sobol.h"
+
+namespace {
+    constexpr std::uint64_t DIRECTION_NUMBER_KEY = 0x5B0B01D1ULL;
+    constexpr std::uint64_t SCRAMBLE_KEY = 0x0E3A5C8A7ULL;
+    constexpr double UNIFORM_SCALE = 1.0 / 4294967296.0; // 2^-32
+
+    struct SobolPolynomial {
+        int degree;
+        std::uint32_t coefficients; // a: the middle coefficients, highest power first
+        std::vector<std::uint32_t> initialNumbers;
+    };
+
+    // Joe & Kuo (2008), new-joe-kuo-6.21201, dimensions 2 to 16
+    const SobolPolynomial JOE_KUO_POLYNOMIALS[] = {
+        { 1, 0, { 1 } },
+        { 2, 1, { 1, 3 } },
+        { 3, 1, { 1, 3, 1 } },
+        { 3, 2, { 1, 1, 1 } },
+        { 4, 1, { 1, 1, 3, 3 } },
+        { 4, 4, { 1, 3, 5, 13 } },
+        { 5, 2, { 1, 1, 5, 5, 17 } },
+        { 5, 4, { 1, 1, 5, 5, 5 } },
+        { 5, 7, { 1, 1, 7, 11, 19 } },
+        { 5, 11, { 1, 1, 5, 1, 1 } },
+        { 5, 13, { 1, 1, 1, 3, 11 } },
+        { 5, 14, { 1, 3, 5, 5, 31 } },
+        { 6, 1, { 1, 3, 3, 9, 7, 49 } },
+        { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+        { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+    };
+
+    std::uint64_t reduceModulo(std::uint64_t value, std::uint64_t modulus, int degree) {
+        for (int bit = 63; bit >= degree; bit--) {
+            if ((value >> bit) & 1) {
+                value ^= modulus << (bit - degree);
+            }
+        }
+        return value;
+    }
+
+    // Carry-less product of two polynomials over GF(2), reduced modulo a polynomial of the given degree
+    std::uint64_t multiplyModulo(std::uint64_t left, std::uint64_t right, std::uint64_t modulus, int degree) {
+        std::uint64_t product = 0;
+        for (int bit = 0; bit < degree; bit++) {
+            if ((right >> bit) & 1) {
+                product ^= left << bit;
+            }
+        }
+        return reduceModulo(product, modulus, degree);
+    }
+
+    std::uint64_t powerOfXModulo(std::uint64_t exponent, std::uint64_t modulus, int degree) {
+        std::uint64_t result = 1;
+        std::uint64_t base = reduceModulo(2, modulus, degree);
+        while (exponent > 0) {
+            if (exponent & 1) {
+                result = multiplyModulo(result, base, modulus, degree);
+            }
+            base = multiplyModulo(base, base, modulus, degree);
+            exponent >>= 1;
+        }
+        return result;
+    }
+
+    // A polynomial with a non-zero constant term is primitive exactly when x has order 2^degree - 1 modulo it
+    bool isPrimitive(std::uint64_t polynomial, int degree) {
+        const std::uint64_t groupOrder = (std::uint64_t (1) << degree) - 1;
+        if (powerOfXModulo(groupOrder, polynomial, degree) != 1) {
+            return false;
+        }
+        std::uint64_t remaining = groupOrder;
+        for (std::uint64_t factor = 2; factor * factor <= remaining; factor++) {
+            if (remaining % factor == 0) {
+                if (powerOfXModulo(groupOrder / factor, polynomial, degree) == 1) {
+                    return false;
+                }
+                while (remaining % factor == 0) {
+                    remaining /= factor;
+                }
+            }
+        }
+        return remaining == 1 || remaining == groupOrder || powerOfXModulo(groupOrder / remaining, polynomial, degree) != 1;
+    }
+
+    // Lists primitive polynomials in order of degree and then coefficients, which is the order Joe & Kuo use
+    std::vector<SobolPolynomial> findPrimitivePolynomials(int count) {
+        std::vector<SobolPolynomial> polynomials;
+        for (int degree = 1; int (polynomials.size()) < count; degree++) {
+            if (degree >= SOBOL_BITS) {
+                throw std::invalid_argument("too many Sobol dimensions requested");
+            }
+            const std::uint32_t numCoefficientSets = degree > 1 ? std::uint32_t (1) << (degree - 1) : 1;
+            for (std::uint32_t coefficients = 0; coefficients < numCoefficientSets && int (polynomials.size()) < count; coefficients++) {
+                const std::uint64_t polynomial = (std::uint64_t (1) << degree) | (std::uint64_t (coefficients) << 1) | 1;
+                if (isPrimitive(polynomial, degree)) {
+                    polynomials.push_back({ degree, coefficients, {} });
+                }
+            }
+        }
+        return polynomials;
+    }
+
+    std::uint32_t reverseBits(std::uint32_t value) {
+        value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+        value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+        value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+        value = ((value >> 8) & 0x00FF00FFu) | ((value & 0x00FF00FFu) << 8);
+        return (value >> 16) | (value << 16);
+    }
+}
+
+SobolDirections createSobolDirections(int numDimensions) {
+    SobolDirections directions = { numDimensions, std::vector<std::uint32_t>(std::size_t (numDimensions) * SOBOL_BITS) };
+    if (numDimensions == 0) {
+        return directions;
+    }
+
+    for (int bit = 0; bit < SOBOL_BITS; bit++) {
+        directions.numbers[bit] = std::uint32_t (1) << (SOBOL_BITS - 1 - bit);
+    }
+
+    const int numTabulated = int (sizeof(JOE_KUO_POLYNOMIALS) / sizeof(JOE_KUO_POLYNOMIALS[0]));
+    std::vector<SobolPolynomial> polynomials = findPrimitivePolynomials(numDimensions - 1);
+    for (int dimension = 1; dimension < numDimensions; dimension++) {
+        SobolPolynomial& polynomial = polynomials[dimension - 1];
+        if (dimension - 1 < numTabulated) {
+            polynomial = JOE_KUO_POLYNOMIALS[dimension - 1];
+        }
+        else {
+            for (int k = 1; k <= polynomial.degree; k++) {
+                const std::uint32_t random = philox4x32(DIRECTION_NUMBER_KEY, std::uint64_t (dimension), std::uint64_t (k)).words[0];
+                polynomial.initialNumbers.push_back(((random % (std::uint32_t (1) << (k - 1))) << 1) | 1);
+            }
+        }
+
+        std::uint32_t* numbers = directions.numbers.data() + std::size_t (dimension) * SOBOL_BITS;
+        const int degree = polynomial.degree;
+        for (int k = 1; k <= SOBOL_BITS; k++) {
+            if (k <= degree) {
+                numbers[k - 1] = polynomial.initialNumbers[k - 1] << (SOBOL_BITS - k);
+                continue;
+            }
+            numbers[k - 1] = numbers[k - degree - 1] ^ (numbers[k - degree - 1] >> degree);
+            for (int i = 1; i < degree; i++) {
+                if ((polynomial.coefficients >> (degree - 1 - i)) & 1) {
+                    numbers[k - 1] ^= numbers[k - i - 1];
+                }
+            }
+        }
+    }
+
+    return directions;
+}
+
+std::uint32_t sobolPoint(const SobolDirections& directions, std::uint32_t index, int dimension) {
+    const std::uint32_t* numbers = directions.numbers.data() + std::size_t (dimension) * SOBOL_BITS;
+    std::uint32_t point = 0;
+    for (int bit = 0; index != 0; bit++, index >>= 1) {
+        if (index & 1) {
+            point ^= numbers[bit];
+        }
+    }
+    return point;
+}
+
+std::uint32_t owenScramble(std::uint32_t point, std::uint32_t seed) {
+    std::uint32_t value = reverseBits(point);
+    value += seed;
+    value ^= value * 0x6C50B47Cu;
+    value ^= value * 0xB82F1E52u;
+    value ^= value * 0xC7AFE638u;
+    value ^= value * 0x8D22F6E6u;
+    return reverseBits(value);
+}
+
+BrownianBridge createBrownianBridge(int numSteps) {
+    BrownianBridge bridge = { numSteps, std::vector<int>(numSteps), std::vector<int>(numSteps), std::vector<int>(numSteps),
+     std::vector<double>(numSteps), std::vector<double>(numSteps), std::vector<double>(numSteps) };
+    if (numSteps == 0) {
+        return bridge;
+    }
+
+    // Times are measured in steps, so the increments come out already normalised to unit variance
+    std::vector<bool> isPopulated(numSteps, false);
+    isPopulated[numSteps - 1] = true;
+    bridge.bridgeIndices[0] = numSteps - 1;
+    bridge.leftIndices[0] = -1;
+    bridge.rightIndices[0] = numSteps - 1;
+    bridge.standardDeviations[0] = std::sqrt(double (numSteps));
+
+    int gapStart = 0;
+    for (int i = 1; i < numSteps; i++) {
+        while (isPopulated[gapStart]) {
+            gapStart++;
+        }
+        int right = gapStart;
+        while (!isPopulated[right]) {
+            right++;
+        }
+        const int middle = gapStart + ((right - 1 - gapStart) >> 1);
+        isPopulated[middle] = true;
+
+        const int left = gapStart - 1;
+        const double leftTime = left + 1.0;
+        const double middleTime = middle + 1.0;
+        const double rightTime = right + 1.0;
+        bridge.bridgeIndices[i] = middle;
+        bridge.leftIndices[i] = left;
+        bridge.rightIndices[i] = right;
+        bridge.leftWeights[i] = (rightTime - middleTime) / (rightTime - leftTime);
+        bridge.rightWeights[i] = (middleTime - leftTime) / (rightTime - leftTime);
+        bridge.standardDeviations[i] = std::sqrt((middleTime - leftTime) * (rightTime - middleTime) / (rightTime - leftTime));
+
+        gapStart = right + 1;
+        if (gapStart >= numSteps) {
+            gapStart = 0;
+        }
+    }
+
+    return bridge;
+}
+
+void buildBridgedIncrements(const BrownianBridge& bridge, const double* normals, double* increments) {
+    const int numSteps = bridge.numSteps;
+    if (numSteps == 0) {
+        return;
+    }
+
+    // Build the Brownian path in place, then difference it
+    increments[numSteps - 1] = bridge.standardDeviations[0] * normals[0];
+    for (int i = 1; i < numSteps; i++) {
+        const int left = bridge.leftIndices[i];
+        const double leftValue = left >= 0 ? increments[left] : 0.0;
+        increments[bridge.bridgeIndices[i]] = bridge.leftWeights[i] * leftValue
+         + bridge.rightWeights[i] * increments[bridge.rightIndices[i]] + bridge.standardDeviations[i] * normals[i];
+    }
+    for (int j = numSteps - 1; j > 0; j--) {
+        increments[j] -= increments[j - 1];
+    }
+}
+
+QuasiRandomSource createQuasiRandomSource(std::uint64_t seed, int numSimulations, int numBridgeSteps, int numDimensions) {
+    const int numReplicates = std::max(1, std::min(NUM_QMC_REPLICATES, numSimulations));
+    const int pointsPerReplicate = (numSimulations + numReplicates - 1) / numReplicates;
+    return { seed, numReplicates, pointsPerReplicate, createSobolDirections(numDimensions), createBrownianBridge(numBridgeSteps) };
+}
+
+void generateQuasiRandomPathNormals(const QuasiRandomSource& source, int pathIndex, int numSteps, double* normals) {
+    const int replicate = pathIndex / source.pointsPerReplicate;
+    const std::uint32_t pointIndex = std::uint32_t (pathIndex % source.pointsPerReplicate);
+    const int numSobolSteps = std::min(numSteps, source.directions.numDimensions);
+
+    std::vector<double> sobolNormals(numSobolSteps);
+    for (int dimension = 0; dimension < numSobolSteps; dimension++) {
+        const std::uint32_t scrambleSeed = philox4x32(source.seed ^ SCRAMBLE_KEY, std::uint64_t (replicate), std::uint64_t (dimension)).words[0];
+        const std::uint32_t point = owenScramble(sobolPoint(source.directions, pointIndex, dimension), scrambleSeed);
+        sobolNormals[dimension] = inverseNormalCdf((double (point) + 0.5) * UNIFORM_SCALE);
+    }
+
+    const int numBridgeSteps = std::min(source.bridge.numSteps, numSobolSteps);
+    if (numBridgeSteps == source.bridge.numSteps) {
+        buildBridgedIncrements(source.bridge, sobolNormals.data(), normals);
+    }
+    else {
+        std::copy_n(sobolNormals.begin(), numBridgeSteps, normals);
+    }
+    std::copy(sobolNormals.begin() + numBridgeSteps, sobolNormals.end(), normals + numBridgeSteps);
+    generatePathNormals(source.seed, std::uint64_t (pathIndex), numSobolSteps, numSteps - numSobolSteps, normals + numSobolSteps);
+}
@@ -0,0 +1,58 @@
+#include <cmath>
+#include "Statistics.h"
+
+namespace {
+    // Samples summarised one by one before summaries start being merged pairwise
+    constexpr std::size_t PAIRWISE_BLOCK_SIZE = 64;
+}
+
+void addSample(RunningStatistics& statistics, double sample) {
+    statistics.count++;
+    const double deviation = sample - statistics.mean;
+    statistics.mean += deviation / double (statistics.count);
+    statistics.sumSquaredDeviations += deviation * (sample - statistics.mean);
+}
+
+void mergeStatistics(RunningStatistics& statistics, const RunningStatistics& other) {
+    if (other.count == 0) {
+        return;
+    }
+    const long long count = statistics.count + other.count;
+    const double deviation = other.mean - statistics.mean;
+    statistics.mean += deviation * double (other.count) / double (count);
+    statistics.sumSquaredDeviations += other.sumSquaredDeviations
+     + deviation * deviation * double (statistics.count) * double (other.count) / double (count);
+    statistics.count = count;
+}
+
+RunningStatistics summarise(const double* samples, std::size_t count) {
+    RunningStatistics statistics;
+    if (count <= PAIRWISE_BLOCK_SIZE) {
+        for (std::size_t i = 0; i < count; i++) {
+            addSample(statistics, samples[i]);
+        }
+        return statistics;
+    }
+    const std::size_t half = count / 2;
+    statistics = summarise(samples, half);
+    mergeStatistics(statistics, summarise(samples + half, count - half));
+    return statistics;
+}
+
+RunningStatistics summarise(const std::vector<double>& samples) {
+    return summarise(samples.data(), samples.size());
+}
+
+double calculateSampleVariance(const RunningStatistics& statistics) {
+    if (statistics.count < 2) {
+        return 0.0;
+    }
+    return statistics.sumSquaredDeviations / double (statistics.count - 1);
+}
+
+double calculateStandardError(const RunningStatistics& statistics) {
+    if (statistics.count == 0) {
+        return 0.0;
+    }
+    return std::sqrt(calculateSampleVariance(statistics) / double (statistics.count));
+}
@@ -1,10 +1,20 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <thread>
+#include "Instrumentation.h"
+#include "LongstaffSchwartz.h"
+#include "Models.h"
 #include "OptionTypes.h"
+#include "Sharding.h"
 #include "Utils.h"
+#include "VarianceReduction.h"
 
 void outputHelp() {
     std::cout << "=================================\n"
@@ -15,14 +25,82 @@ void outputHelp() {
               << "Options:\n"
               << "  -h     Show this help message and exit\n"
               << "  -d     Run demo simulation with example Amazon option parameters\n"
-              << "  [spotPrice] [strikePrice] [timeToMaturity] [riskFreeRate] [volatility] [optionType]\n"
+              << "  -b [inputFile] [outputFile]\n"
+              << "         Price every option in a CSV portfolio file and write one result row per option.\n"
+              << "         Input rows are spotPrice,strikePrice,timeToMaturity,riskFreeRate,volatility,optionType, optionally\n"
+              << "         followed by payoffStyle, or by payoffStyle,barrierType,barrierLevel for barrier options\n"
+              << "  -m [inputFile]\n"
+              << "         Price a basket, best-of or worst-of option on several correlated assets. The first row is\n"
+              << "         strikePrice,timeToMaturity,riskFreeRate,optionType,payoff (Basket, BestOf or WorstOf), then one\n"
+              << "         row per asset of spotPrice,volatility,weight followed by its row of the correlation matrix.\n"
+              << "         Only --threads, --seed, --paths, --stream, --stepped and --no-antithetic apply\n"
+              << "  -s [port or socketPath]\n"
+              << "         Run a pricing server on a localhost TCP port or a Unix domain socket. Each line sent is a -b\n"
+              << "         input row and is answered with its -b output row; SHUTDOWN stops the server\n"
+              << "  -c [shardFile...]\n"
+              << "         Merge the shard files written by --shard workers into the result of the whole run\n"
+              << "  --threads N  Number of worker threads (defaults to every hardware thread)\n"
+              << "  --seed N     Random seed; a given seed prices identically for any thread count\n"
+              << "  --stream     Regenerate random normals per path instead of storing them (flat memory use)\n"
+              << "  --stepped    Simulate every daily step even for payoffs that only need the terminal price\n"
+              << "  --qmc        Use scrambled Sobol points with a Brownian bridge instead of pseudorandom normals\n"
+              << "  --single-precision    Store normals and step paths in float; payoffs and statistics stay double\n"
+              << "  --paths N    Number of simulated paths (default 100000)\n"
+              << "  --tolerance X         Add paths until the standard error falls to X (adaptive mode)\n"
+              << "  --time-budget S       Stop adding paths after S seconds (adaptive mode)\n"
+              << "  --max-paths N         Path cap in adaptive mode (default 100000000)\n"
+              << "  --no-antithetic       Simulate each path on its own instead of averaging it with its mirror image\n"
+              << "  --control-variates    Use the discounted terminal price as a control variate\n"
+              << "  --black-scholes-control\n"
+              << "                        Use the vanilla payoff as a control variate with its Black-Scholes price\n"
+              << "                        (path-dependent payoff styles only)\n"
+              << "  --importance-sampling Drift out of the money paths towards the strike and reweight them\n"
+              << "  --geometric-control   Use the geometric Asian payoff as a control variate with its closed-form price\n"
+              << "                        (arithmetic Asian options only)\n"
+              << "  --barrier-step-days N Days per simulated step for barrier options (default 1); the Brownian bridge\n"
+              << "                        correction keeps the barrier continuously monitored on any grid\n"
+              << "  --heston v0,kappa,theta,xi,rho\n"
+              << "                        Simulate Heston stochastic variance (initial variance, mean reversion, long-run\n"
+              << "                        variance, volatility of variance, correlation) with Andersen's QE scheme\n"
+              << "  --sabr alpha,beta,nu,rho\n"
+              << "                        Simulate SABR on the forward to maturity\n"
+              << "  --local-vol FILE      Simulate a local volatility surface: a header row of spot prices, then rows of\n"
+              << "                        time followed by the volatility (%) at each spot price\n"
+              << "  --rate-curve FILE     Discount and drift with time,zeroRate (%) rows instead of the flat risk-free rate\n"
+              << "                        Other models and rate curves ignore the volatility (resp. the risk-free rate) below,\n"
+              << "                        step daily, and take their Greeks from bumped paths that reuse the same normals\n"
+              << "  --american            Allow exercise on any working day, pricing with Longstaff-Schwartz regression\n"
+              << "  --bermudan N          Allow exercise on N evenly spaced dates, the last being maturity\n"
+              << "  --basis NAME          Regression basis for early exercise: Laguerre (default) or Monomial\n"
+              << "  --basis-degree N      Highest degree of the regression basis (default 3, at most 8)\n"
+              << "  --spot-ladder FROM:TO:STEP\n"
+              << "                        Revalue one option over spot price shifts in percent (e.g. -10:10:1), not with -b or -s\n"
+              << "  --vol-ladder FROM:TO:STEP\n"
+              << "                        Revalue over volatility shifts in percentage points, combined with any spot ladder\n"
+              << "  --reprice-threshold VOL,RATE\n"
+              << "                        With -s, reweight a contract's cached paths for volatility and rate moves of up\n"
+              << "                        to VOL and RATE percentage points (default 2,1); larger moves simulate afresh\n"
+              << "  --graph-paths N       Number of paths written to output/paths.npy and plotted (default 100, 0 for none)\n"
+              << "  --dump-payoffs        Write every path's discounted payoff to output/payoffs.npy\n"
+              << "  --workers N           Split the paths across N local worker processes and merge their statistics\n"
+              << "  --shard K/N           Price only shard K (from 0) of N, for a worker on another machine, and write its\n"
+              << "                        statistics to the file given by --shard-output FILE instead of printing results\n"
+              << "  --stats               Print the time, paths, steps, random draws and memory of each phase\n"
+              << "  --stats-json FILE     Write the results and phase statistics to FILE as JSON\n"
+              << "  [spotPrice] [strikePrice] [timeToMaturity] [riskFreeRate] [volatility] [optionType] [payoffStyle]\n"
+              << "  [barrierType] [barrierLevel]\n"
               << "         Run simulation with user-specified parameters:\n"
               << "           spotPrice        Spot price (positive double)\n"
               << "           strikePrice      Strike price (positive double)\n"
               << "           timeToMaturity   Time to maturity in years (positive double)\n"
               << "           riskFreeRate     Risk-free interest rate as percentage (non-negative double)\n"
               << "           volatility       Volatility as percentage (non-negative double)\n"
-              << "           optionType       Option type: Call or Put (case-insensitive)\n\n"
+              << "           optionType       Option type: Call or Put (case-insensitive)\n"
+              << "           payoffStyle      Optional: European (default), Asian, GeometricAsian, Lookback or Barrier.\n"
+              << "                            Asians pay on the average of the daily prices, lookbacks on their maximum\n"
+              << "                            (calls) or minimum (puts)\n"
+              << "           barrierType      Barrier options only: UpAndOut, UpAndIn, DownAndOut or DownAndIn\n"
+              << "           barrierLevel     Barrier options only: barrier price (positive double)\n\n"
               << "If no arguments are provided, the program will prompt interactively for these inputs.\n\n"
               << std::endl;
 }
@@ -71,6 +149,47 @@ bool isNonNegativeDouble(const char* price) {
     }
 }
 
+bool isPositiveInteger(const char* number) {
+    if (number == nullptr) {
+        return false;
+    }
+    std::string numberString(number);
+    if (numberString.empty()) {
+        return false;
+    }
+
+    try {
+        size_t position;
+        long long numberValue = std::stoll(numberString, &position);
+        if (position != numberString.length() || numberValue <= 0) {
+            return false;
+        }
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool isNonNegativeInteger(const char* number) {
+    if (number == nullptr) {
+        return false;
+    }
+    std::string numberString(number);
+    if (numberString.empty() || numberString[0] == '-') {
+        return false;
+    }
+
+    try {
+        size_t position;
+        std::stoull(numberString, &position);
+        return position == numberString.length();
+    }
+    catch (...) {
+        return false;
+    }
+}
+
 bool insensitiveEquals(std::string string1, std::string string2) {
     if (string1.length() != string2.length()) {
         return false;
@@ -83,11 +202,412 @@ bool insensitiveEquals(std::string string1, std::string string2) {
     return true;
 }
 
+std::vector<std::string> splitCsvLine(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ',')) {
+        const std::size_t first = field.find_first_not_of(" \t\r");
+        const std::size_t last = field.find_last_not_of(" \t\r");
+        fields.push_back(first == std::string::npos ? "" : field.substr(first, last - first + 1));
+    }
+    return fields;
+}
+
 bool isValidOptionType(const char* optionType) {
     std::string optionString(optionType);
     return insensitiveEquals(optionString, "Call") || insensitiveEquals(optionString, "Put");
 }
 
+bool isValidPayoffStyle(const char* payoffStyle) {
+    for (PayoffStyle style : { PayoffStyle::European, PayoffStyle::ArithmeticAsian, PayoffStyle::GeometricAsian, PayoffStyle::Lookback, PayoffStyle::Barrier }) {
+        if (insensitiveEquals(payoffStyle, getPayoffStyleName(style))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isValidBarrierType(const char* barrierType) {
+    for (BarrierType type : { BarrierType::UpAndOut, BarrierType::UpAndIn, BarrierType::DownAndOut, BarrierType::DownAndIn }) {
+        if (insensitiveEquals(barrierType, getBarrierTypeName(type))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+PayoffStyle getPayoffStyle(const std::string& payoffStyle) {
+    for (PayoffStyle style : { PayoffStyle::ArithmeticAsian, PayoffStyle::GeometricAsian, PayoffStyle::Lookback, PayoffStyle::Barrier }) {
+        if (insensitiveEquals(payoffStyle, getPayoffStyleName(style))) {
+            return style;
+        }
+    }
+    return PayoffStyle::European;
+}
+
+BarrierType getBarrierType(const std::string& barrierType) {
+    for (BarrierType type : { BarrierType::UpAndIn, BarrierType::DownAndOut, BarrierType::DownAndIn }) {
+        if (insensitiveEquals(barrierType, getBarrierTypeName(type))) {
+            return type;
+        }
+    }
+    return BarrierType::UpAndOut;
+}
+
+const char* getPayoffStyleName(PayoffStyle payoffStyle) {
+    switch (payoffStyle) {
+        case PayoffStyle::European:
+            return "European";
+        case PayoffStyle::ArithmeticAsian:
+            return "Asian";
+        case PayoffStyle::GeometricAsian:
+            return "GeometricAsian";
+        case PayoffStyle::Lookback:
+            return "Lookback";
+        case PayoffStyle::Barrier:
+            return "Barrier";
+    }
+    return "European";
+}
+
+const char* getBarrierTypeName(BarrierType barrierType) {
+    switch (barrierType) {
+        case BarrierType::UpAndOut:
+            return "UpAndOut";
+        case BarrierType::UpAndIn:
+            return "UpAndIn";
+        case BarrierType::DownAndOut:
+            return "DownAndOut";
+        case BarrierType::DownAndIn:
+            return "DownAndIn";
+    }
+    return "UpAndOut";
+}
+
+namespace {
+    // Reads exactly count comma-separated numbers, which may be negative
+    bool parseNumberList(const char* text, std::size_t count, std::vector<double>& values) {
+        values.clear();
+        for (const std::string& field : splitCsvLine(text)) {
+            try {
+                std::size_t position;
+                values.push_back(std::stod(field, &position));
+                if (position != field.length()) {
+                    return false;
+                }
+            }
+            catch (const std::exception&) {
+                return false;
+            }
+        }
+        return values.size() == count;
+    }
+
+    // Reads a ladder written as from:to:step in percentage points, such as -10:10:1, into fractions
+    bool parseLadder(const char* text, std::vector<double>& values) {
+        std::string ladder = text;
+        std::replace(ladder.begin(), ladder.end(), ':', ',');
+        std::vector<double> bounds;
+        if (!parseNumberList(ladder.c_str(), 3, bounds) || bounds[2] <= 0.0 || bounds[1] < bounds[0]) {
+            return false;
+        }
+        values.clear();
+        const int numPoints = int (std::floor((bounds[1] - bounds[0]) / bounds[2] + 1e-9)) + 1;
+        for (int i = 0; i < numPoints; i++) {
+            values.push_back((bounds[0] + i * bounds[2]) / 100.0);
+        }
+        return true;
+    }
+
+    // Reads a shard written as K/N, numbering shards from 0
+    bool parseShard(const char* text, ShardSettings& shard) {
+        const std::string shardText = text;
+        const std::size_t slash = shardText.find('/');
+        if (slash == std::string::npos) {
+            return false;
+        }
+        const std::string indexText = shardText.substr(0, slash);
+        const std::string countText = shardText.substr(slash + 1);
+        try {
+            if (!isNonNegativeInteger(indexText.c_str()) || !isPositiveInteger(countText.c_str())
+             || std::stoll(countText) > std::numeric_limits<int>::max() || std::stoll(indexText) >= std::stoll(countText)) {
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+        shard.shardIndex = std::stoi(indexText);
+        shard.numShards = std::stoi(countText);
+        return true;
+    }
+}
+
+bool extractSimulationFlags(int argc, char* argv[], SimulationSettings& settings, std::vector<char*>& arguments) {
+    arguments.clear();
+    arguments.push_back(argv[0]);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp("--threads", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveInteger(argv[i + 1])) {
+                std::cerr << "\033[31mERROR: --threads must be followed by a positive integer.\033[0m";
+                return false;
+            }
+            settings.numThreads = std::stoi(argv[++i]);
+        }
+        else if (strcmp("--seed", argv[i]) == 0) {
+            if (i + 1 >= argc || !isNonNegativeInteger(argv[i + 1])) {
+                std::cerr << "\033[31mERROR: --seed must be followed by a non-negative integer.\033[0m";
+                return false;
+            }
+            settings.seed = std::stoull(argv[++i]);
+        }
+        else if (strcmp("--stream", argv[i]) == 0) {
+            settings.streamNormals = true;
+        }
+        else if (strcmp("--stepped", argv[i]) == 0) {
+            settings.forceSteppedPaths = true;
+        }
+        else if (strcmp("--single-precision", argv[i]) == 0) {
+            settings.singlePrecision = true;
+        }
+        else if (strcmp("--qmc", argv[i]) == 0) {
+            settings.quasiRandom = true;
+        }
+        else if (strcmp("--tolerance", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveDouble(argv[i + 1])) {
+                std::cerr << "\033[31mERROR: --tolerance must be followed by a positive number.\033[0m";
+                return false;
+            }
+            settings.targetStandardError = std::stod(argv[++i]);
+        }
+        else if (strcmp("--time-budget", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveDouble(argv[i + 1])) {
+                std::cerr << "\033[31mERROR: --time-budget must be followed by a positive number of seconds.\033[0m";
+                return false;
+            }
+            settings.timeBudgetSeconds = std::stod(argv[++i]);
+        }
+        else if (strcmp("--max-paths", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveInteger(argv[i + 1]) || std::stoll(argv[i + 1]) > std::numeric_limits<int>::max()) {
+                std::cerr << "\033[31mERROR: --max-paths must be followed by a positive integer.\033[0m";
+                return false;
+            }
+            settings.maxSimulations = std::stoi(argv[++i]);
+        }
+        else if (strcmp("--no-antithetic", argv[i]) == 0) {
+            settings.varianceReduction.antithetic = false;
+        }
+        else if (strcmp("--control-variates", argv[i]) == 0) {
+            settings.varianceReduction.terminalPriceControl = true;
+        }
+        else if (strcmp("--black-scholes-control", argv[i]) == 0) {
+            settings.varianceReduction.blackScholesControl = true;
+        }
+        else if (strcmp("--importance-sampling", argv[i]) == 0) {
+            settings.varianceReduction.importanceSampling = true;
+        }
+        else if (strcmp("--geometric-control", argv[i]) == 0) {
+            settings.varianceReduction.geometricAsianControl = true;
+        }
+        else if (strcmp("--barrier-step-days", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveInteger(argv[i + 1]) || std::stoll(argv[i + 1]) > std::numeric_limits<int>::max()) {
+                std::cerr << "\033[31mERROR: --barrier-step-days must be followed by a positive integer.\033[0m";
+                return false;
+            }
+            settings.barrierStepDays = std::stoi(argv[++i]);
+        }
+        else if (strcmp("--stats", argv[i]) == 0) {
+            settings.outputStatistics = true;
+        }
+        else if (strcmp("--stats-json", argv[i]) == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "\033[31mERROR: --stats-json must be followed by a file path.\033[0m";
+                return false;
+            }
+            settings.statisticsJsonPath = argv[++i];
+        }
+        else if (strcmp("--heston", argv[i]) == 0) {
+            std::vector<double> values;
+            if (i + 1 >= argc || !parseNumberList(argv[i + 1], 5, values)) {
+                std::cerr << "\033[31mERROR: --heston must be followed by v0,kappa,theta,xi,rho.\033[0m";
+                return false;
+            }
+            settings.model.type = ModelType::Heston;
+            settings.model.heston = { values[0], values[1], values[2], values[3], values[4] };
+            i++;
+        }
+        else if (strcmp("--sabr", argv[i]) == 0) {
+            std::vector<double> values;
+            if (i + 1 >= argc || !parseNumberList(argv[i + 1], 4, values)) {
+                std::cerr << "\033[31mERROR: --sabr must be followed by alpha,beta,nu,rho.\033[0m";
+                return false;
+            }
+            settings.model.type = ModelType::Sabr;
+            settings.model.sabr = { values[0], values[1], values[2], values[3] };
+            i++;
+        }
+        else if (strcmp("--local-vol", argv[i]) == 0 || strcmp("--rate-curve", argv[i]) == 0) {
+            const bool readsLocalVolatility = strcmp("--local-vol", argv[i]) == 0;
+            if (i + 1 >= argc) {
+                std::cerr << "\033[31mERROR: " << argv[i] << " must be followed by a file path.\033[0m";
+                return false;
+            }
+            try {
+                if (readsLocalVolatility) {
+                    settings.model.type = ModelType::LocalVolatility;
+                    settings.model.localVolatility = readLocalVolatilityFile(argv[++i]);
+                }
+                else {
+                    settings.model.rateCurve = readRateCurveFile(argv[++i]);
+                }
+            }
+            catch (const std::exception& error) {
+                std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+                return false;
+            }
+        }
+        else if (strcmp("--american", argv[i]) == 0) {
+            settings.earlyExercise.style = ExerciseStyle::American;
+        }
+        else if (strcmp("--bermudan", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveInteger(argv[i + 1]) || std::stoll(argv[i + 1]) > std::numeric_limits<int>::max()) {
+                std::cerr << "\033[31mERROR: --bermudan must be followed by a positive number of exercise dates.\033[0m";
+                return false;
+            }
+            settings.earlyExercise.style = ExerciseStyle::Bermudan;
+            settings.earlyExercise.numExerciseDates = std::stoi(argv[++i]);
+        }
+        else if (strcmp("--basis", argv[i]) == 0) {
+            if (i + 1 >= argc || (!insensitiveEquals(argv[i + 1], "Monomial") && !insensitiveEquals(argv[i + 1], "Laguerre"))) {
+                std::cerr << "\033[31mERROR: --basis must be followed by \"Monomial\" or \"Laguerre\".\033[0m";
+                return false;
+            }
+            settings.earlyExercise.basis = insensitiveEquals(argv[++i], "Monomial") ? RegressionBasis::Monomial : RegressionBasis::Laguerre;
+        }
+        else if (strcmp("--basis-degree", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveInteger(argv[i + 1]) || std::stoll(argv[i + 1]) > MAX_BASIS_DEGREE) {
+                std::cerr << "\033[31mERROR: --basis-degree must be followed by an integer from 1 to " << MAX_BASIS_DEGREE << ".\033[0m";
+                return false;
+            }
+            settings.earlyExercise.basisDegree = std::stoi(argv[++i]);
+        }
+        else if (strcmp("--spot-ladder", argv[i]) == 0 || strcmp("--vol-ladder", argv[i]) == 0) {
+            const bool isSpotLadder = strcmp("--spot-ladder", argv[i]) == 0;
+            std::vector<double>& shifts = isSpotLadder ? settings.scenarioGrid.spotPriceShifts : settings.scenarioGrid.volatilityShifts;
+            if (i + 1 >= argc || !parseLadder(argv[i + 1], shifts)) {
+                std::cerr << "\033[31mERROR: " << argv[i] << " must be followed by from:to:step in percentage points.\033[0m";
+                return false;
+            }
+            i++;
+        }
+        else if (strcmp("--reprice-threshold", argv[i]) == 0) {
+            std::vector<double> thresholds;
+            if (i + 1 >= argc || !parseNumberList(argv[i + 1], 2, thresholds) || thresholds[0] < 0.0 || thresholds[1] < 0.0) {
+                std::cerr << "\033[31mERROR: --reprice-threshold must be followed by vol,rate in non-negative percentage points.\033[0m";
+                return false;
+            }
+            settings.repricingThresholds.volatility = thresholds[0] / 100.0;
+            settings.repricingThresholds.riskFreeRate = thresholds[1] / 100.0;
+            i++;
+        }
+        else if (strcmp("--graph-paths", argv[i]) == 0) {
+            if (i + 1 >= argc || !isNonNegativeInteger(argv[i + 1]) || std::stoll(argv[i + 1]) > std::numeric_limits<int>::max()) {
+                std::cerr << "\033[31mERROR: --graph-paths must be followed by a non-negative integer.\033[0m";
+                return false;
+            }
+            settings.numGraphedPaths = std::stoi(argv[++i]);
+        }
+        else if (strcmp("--dump-payoffs", argv[i]) == 0) {
+            settings.dumpPayoffs = true;
+        }
+        else if (strcmp("--shard", argv[i]) == 0) {
+            if (i + 1 >= argc || !parseShard(argv[i + 1], settings.shard)) {
+                std::cerr << "\033[31mERROR: --shard must be followed by K/N, with shard index K below the shard count N.\033[0m";
+                return false;
+            }
+            i++;
+        }
+        else if (strcmp("--shard-output", argv[i]) == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "\033[31mERROR: --shard-output must be followed by a file path.\033[0m";
+                return false;
+            }
+            settings.shard.outputPath = argv[++i];
+        }
+        else if (strcmp("--workers", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveInteger(argv[i + 1]) || std::stoll(argv[i + 1]) > MAX_LOCAL_WORKERS) {
+                std::cerr << "\033[31mERROR: --workers must be followed by an integer from 1 to " << MAX_LOCAL_WORKERS << ".\033[0m";
+                return false;
+            }
+            settings.shard.numWorkers = std::stoi(argv[++i]);
+        }
+        else if (strcmp("--paths", argv[i]) == 0) {
+            if (i + 1 >= argc || !isPositiveInteger(argv[i + 1]) || std::stoll(argv[i + 1]) > std::numeric_limits<int>::max()) {
+                std::cerr << "\033[31mERROR: --paths must be followed by a positive integer.\033[0m";
+                return false;
+            }
+            settings.numSimulations = std::stoi(argv[++i]);
+        }
+        else {
+            arguments.push_back(argv[i]);
+        }
+    }
+
+    if ((settings.shard.numShards > 0) != !settings.shard.outputPath.empty()) {
+        std::cerr << "\033[31mERROR: --shard and --shard-output must be given together.\033[0m";
+        return false;
+    }
+    else if (settings.shard.numShards > 0 && settings.shard.numWorkers > 0) {
+        std::cerr << "\033[31mERROR: A worker started with --shard cannot start workers of its own.\033[0m";
+        return false;
+    }
+    else if (settings.shard.numWorkers > 0) {
+        // Workers get every flag this process was given except --workers, with the option arguments after them
+        settings.shard.executablePath = argv[0];
+        for (int i = 1; i < argc; i++) {
+            if (strcmp("--workers", argv[i]) == 0) {
+                i++;
+            }
+            else if (std::find(arguments.begin(), arguments.end(), argv[i]) == arguments.end()) {
+                settings.shard.workerFlags.push_back(argv[i]);
+            }
+        }
+    }
+
+    if (settings.dumpPayoffs && (isAdaptive(settings) || usesModelEngine(settings) || settings.earlyExercise.style != ExerciseStyle::European)) {
+        std::cerr << "\033[31mERROR: --dump-payoffs needs a fixed path count under the Black-Scholes model with European exercise.\033[0m";
+        return false;
+    }
+    const bool pricesManyOptions = arguments.size() >= 2
+     && (strcmp("-b", arguments[1]) == 0 || strcmp("-s", arguments[1]) == 0 || strcmp("-c", arguments[1]) == 0);
+    if (hasScenarioGrid(settings) && pricesManyOptions) {
+        std::cerr << "\033[31mERROR: --spot-ladder and --vol-ladder only apply to a single option, not to -b, -s or -c.\033[0m";
+        return false;
+    }
+
+    try {
+        validateModelSettings(settings);
+        validateEarlyExercise(settings);
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return false;
+    }
+    return true;
+}
+
+bool checkControlVariates(PayoffStyle payoffStyle, const SimulationSettings& settings) {
+    try {
+        validateControlVariates(payoffStyle, settings.varianceReduction);
+    }
+    catch (const std::exception& error) {
+        std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+        return false;
+    }
+    return true;
+}
+
 std::filesystem::path getRootDirectory() {
     const std::filesystem::path filePath = __FILE__;
     return filePath.parent_path().parent_path();
@@ -147,10 +667,43 @@ void outputResults(OptionResult& params) {
     const std::string roundedLowerBound = prepareForOutput(std::get<0>(params.confidenceInterval));
     const std::string roundedUpperBound = prepareForOutput(std::get<1>(params.confidenceInterval));
     outputRow("95% confidence interval", "(" + roundedLowerBound + ", " + roundedUpperBound + ")");
+    outputRow("Variance reduction", prepareForOutput(params.varianceReductionFactor) + "x");
+    outputRow("Paths used", std::to_string(params.numPaths));
+    outputRow("Elapsed time (s)", prepareForOutput(params.elapsedSeconds));
+
+    outputRow("Delta", prepareForOutput(params.greeks.delta) + " +/- " + prepareForOutput(params.greekStandardErrors.delta));
+    outputRow("Gamma", prepareForOutput(params.greeks.gamma) + " +/- " + prepareForOutput(params.greekStandardErrors.gamma));
+    outputRow("Vega", prepareForOutput(params.greeks.vega) + " +/- " + prepareForOutput(params.greekStandardErrors.vega));
+    outputRow("Rho", prepareForOutput(params.greeks.rho) + " +/- " + prepareForOutput(params.greekStandardErrors.rho));
+    outputRow("Theta", prepareForOutput(params.greeks.theta) + " +/- " + prepareForOutput(params.greekStandardErrors.theta));
+}
 
-    outputRow("Delta", prepareForOutput(params.greeks.delta));
-    outputRow("Gamma", prepareForOutput(params.greeks.gamma));
-    outputRow("Vega", prepareForOutput(params.greeks.vega));
-    outputRow("Rho", prepareForOutput(params.greeks.rho));
-    outputRow("Theta", prepareForOutput(params.greeks.theta));
+void outputPhaseStatistics(const std::vector<PhaseStatistics>& phases) {
+    for (const PhaseStatistics& phase : phases) {
+        std::cout << std::endl;
+        outputRow("Phase", phase.name);
+        outputRow("Wall time (s)", prepareForOutput(phase.wallSeconds));
+        outputRow("CPU time (s)", prepareForOutput(phase.cpuSeconds));
+        outputRow("Paths", std::to_string(phase.paths));
+        outputRow("Steps", std::to_string(phase.steps));
+        outputRow("Random draws", std::to_string(phase.randomDraws));
+        outputRow("Bytes allocated", std::to_string(phase.bytesAllocated));
+    }
+}
+
+bool outputRunStatistics(const OptionResult& result, const SimulationSettings& settings) {
+    if (settings.outputStatistics) {
+        outputPhaseStatistics(result.phases);
+    }
+
+    if (!settings.statisticsJsonPath.empty()) {
+        try {
+            writeRunStatisticsJson(settings.statisticsJsonPath, result);
+        }
+        catch (const std::exception& error) {
+            std::cerr << "\033[31mERROR: " << error.what() << ".\033[0m";
+            return false;
+        }
+    }
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "MonteCarlo.h"
+#include "VarianceReduction.h"
+
+void validateControlVariates(PayoffStyle payoffStyle, const VarianceReduction& varianceReduction) {
+    if (varianceReduction.blackScholesControl && payoffStyle == PayoffStyle::European) {
+        throw std::runtime_error("--black-scholes-control is the payoff itself for European options, so it only applies to path-dependent ones");
+    }
+    if (varianceReduction.geometricAsianControl && payoffStyle != PayoffStyle::ArithmeticAsian) {
+        throw std::runtime_error("--geometric-control only applies to arithmetic Asian options");
+    }
+}
+
+std::vector<double> estimateControlVariateCoefficients(const std::vector<double>& payoffs, const std::vector<ControlVariate>& controls) {
+    const std::size_t numControls = controls.size();
+    std::vector<double> controlMeans(numControls, 0.0);
+    std::vector<double> controlCovariances(numControls * numControls, 0.0);
+    std::vector<double> payoffCovariances(numControls, 0.0);
+    std::vector<double> deviations(numControls);
+    double payoffMean = 0.0;
+
+    // Welford-style update of the means and co-moments
+    for (std::size_t i = 0; i < payoffs.size(); i++) {
+        const double count = double (i + 1);
+        const double payoffDeviation = payoffs[i] - payoffMean;
+        for (std::size_t k = 0; k < numControls; k++) {
+            deviations[k] = controls[k].samples[i] - controlMeans[k];
+            controlMeans[k] += deviations[k] / count;
+        }
+        payoffMean += payoffDeviation / count;
+        for (std::size_t k = 0; k < numControls; k++) {
+            const double updatedDeviation = controls[k].samples[i] - controlMeans[k];
+            payoffCovariances[k] += payoffDeviation * updatedDeviation;
+            for (std::size_t l = 0; l < numControls; l++) {
+                controlCovariances[k * numControls + l] += deviations[l] * updatedDeviation;
+            }
+        }
+    }
+
+    // Solve the normal equations by Gaussian elimination with partial pivoting; there are only ever a few controls
+    std::vector<double> coefficients = payoffCovariances;
+    for (std::size_t column = 0; column < numControls; column++) {
+        std::size_t pivot = column;
+        for (std::size_t row = column + 1; row < numControls; row++) {
+            if (std::abs(controlCovariances[row * numControls + column]) > std::abs(controlCovariances[pivot * numControls + column])) {
+                pivot = row;
+            }
+        }
+        if (std::abs(controlCovariances[pivot * numControls + column]) <= std::numeric_limits<double>::min()) {
+            // A control with no variance carries no information, so it gets no weight
+            for (std::size_t l = 0; l < numControls; l++) {
+                controlCovariances[column * numControls + l] = l == column ? 1.0 : 0.0;
+            }
+            coefficients[column] = 0.0;
+            continue;
+        }
+        for (std::size_t l = 0; l < numControls; l++) {
+            std::swap(controlCovariances[column * numControls + l], controlCovariances[pivot * numControls + l]);
+        }
+        std::swap(coefficients[column], coefficients[pivot]);
+
+        for (std::size_t row = column + 1; row < numControls; row++) {
+            const double factor = controlCovariances[row * numControls + column] / controlCovariances[column * numControls + column];
+            for (std::size_t l = column; l < numControls; l++) {
+                controlCovariances[row * numControls + l] -= factor * controlCovariances[column * numControls + l];
+            }
+            coefficients[row] -= factor * coefficients[column];
+        }
+    }
+    for (std::size_t column = numControls; column-- > 0;) {
+        for (std::size_t l = column + 1; l < numControls; l++) {
+            coefficients[column] -= controlCovariances[column * numControls + l] * coefficients[l];
+        }
+        coefficients[column] /= controlCovariances[column * numControls + column];
+    }
+
+    return coefficients;
+}
+
+std::vector<double> applyControlVariates(const std::vector<double>& payoffs, const std::vector<ControlVariate>& controls, const std::vector<double>& coefficients) {
+    std::vector<double> adjustedPayoffs = payoffs;
+    for (std::size_t k = 0; k < controls.size(); k++) {
+        for (std::size_t i = 0; i < adjustedPayoffs.size(); i++) {
+            adjustedPayoffs[i] -= coefficients[k] * (controls[k].samples[i] - controls[k].expectation);
+        }
+    }
+    return adjustedPayoffs;
+}
+
+double calculateImportanceSamplingShift(const OptionParams& params, int numSteps, double stepDt) {
+    const PathConstants constants = calculatePathConstants(params, stepDt);
+    if (numSteps == 0 || constants.diffusion <= 0.0) {
+        return 0.0;
+    }
+
+    const double forwardPrice = params.spotPrice * std::exp(params.riskFreeRate * numSteps * stepDt);
+    const bool isOutOfTheMoney = params.optionType == OptionType::Call ? params.strikePrice > forwardPrice : params.strikePrice < forwardPrice;
+    if (!isOutOfTheMoney) {
+        return 0.0;
+    }
+
+    // Solve log(spot) + numSteps * (drift + diffusion * shift) = log(strike)
+    return (std::log(params.strikePrice / params.spotPrice) - numSteps * constants.drift) / (numSteps * constants.diffusion);
+}
+
+double calculateImportanceWeight(double shift, double normalSum, int numSteps) {
+    return std::exp(-shift * normalSum - numSteps * shift * shift / 2.0);
+}
+
+double calculateVarianceReductionFactor(double crudeStandardError, double standardError) {
+    if (standardError <= 0.0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return (crudeStandardError * crudeStandardError) / (standardError * standardError);
+}
@@ -1,18 +1,58 @@
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
+#include "Batch.h"
 #include "MonteCarlo.h"
+#include "MultiAsset.h"
+#include "ScenarioGrid.h"
+#include "Server.h"
+#include "Sharding.h"
 #include "Utils.h"
 
 int main(int argc, char* argv[]) {
+    SimulationSettings settings;
+    settings.seed = generateSeed();
+    std::vector<char*> arguments;
+    if (!extractSimulationFlags(argc, argv, settings, arguments)) {
+        return EXIT_FAILURE;
+    }
+    argc = int (arguments.size());
+    argv = arguments.data();
+
     if (argc == 2 && strcmp("-h", argv[1]) == 0) {
         outputHelp();
     }
     else if (argc == 2 && strcmp("-d", argv[1]) == 0) {
         OptionParams amazonOption { 226.13, 235, 1.164, 0.044, 0.2866, OptionType::Call };
-        OptionResult amazonModel = runMonteCarloSimulation(amazonOption);
+        if (!checkControlVariates(amazonOption.payoffStyle, settings)) {
+            return EXIT_FAILURE;
+        }
+        if (hasScenarioGrid(settings)) {
+            return runScenarioPricing(amazonOption, settings);
+        }
+        if (isSharded(settings)) {
+            return runShardedPricing(amazonOption, { argv[1] }, settings);
+        }
+        OptionResult amazonModel = runMonteCarloSimulation(amazonOption, settings);
         outputResults(amazonModel);
+        if (!outputRunStatistics(amazonModel, settings)) {
+            return EXIT_FAILURE;
+        }
+    }
+    else if (argc == 4 && strcmp("-b", argv[1]) == 0) {
+        return runBatchPricing(argv[2], argv[3], settings);
     }
-    else if (argc == 7) {
+    else if (argc == 3 && strcmp("-m", argv[1]) == 0) {
+        return runMultiAssetPricing(argv[2], settings);
+    }
+    else if (argc == 3 && strcmp("-s", argv[1]) == 0) {
+        return runPricingServer(argv[2], settings);
+    }
+    else if (argc >= 3 && strcmp("-c", argv[1]) == 0) {
+        return runShardMerge(std::vector<std::filesystem::path>(argv + 2, argv + argc), settings);
+    }
+    else if (argc == 7 || argc == 8 || argc == 10) {
         if (!isPositiveDouble(argv[1])) {
             std::cerr << "\033[31mERROR: The spot price must be a positive double.\033[0m";
             return EXIT_FAILURE;
@@ -37,6 +77,26 @@ int main(int argc, char* argv[]) {
             std::cerr << "\033[31mERROR: The option type must be either \"Call\" or \"Put\".\033[0m";
             return EXIT_FAILURE;
         }
+        else if (argc >= 8 && !isValidPayoffStyle(argv[7])) {
+            std::cerr << "\033[31mERROR: The payoff style must be one of \"European\", \"Asian\", \"GeometricAsian\", \"Lookback\" or \"Barrier\".\033[0m";
+            return EXIT_FAILURE;
+        }
+        else if (argc >= 8 && (getPayoffStyle(argv[7]) == PayoffStyle::Barrier) != (argc == 10)) {
+            std::cerr << "\033[31mERROR: A barrier type and level must be given for barrier options, and only for them.\033[0m";
+            return EXIT_FAILURE;
+        }
+        else if (argc == 10 && !isValidBarrierType(argv[8])) {
+            std::cerr << "\033[31mERROR: The barrier type must be one of \"UpAndOut\", \"UpAndIn\", \"DownAndOut\" or \"DownAndIn\".\033[0m";
+            return EXIT_FAILURE;
+        }
+        else if (argc == 10 && !isPositiveDouble(argv[9])) {
+            std::cerr << "\033[31mERROR: The barrier level must be a positive double.\033[0m";
+            return EXIT_FAILURE;
+        }
+        else if (argc >= 8 && isPathDependent(getPayoffStyle(argv[7])) && settings.earlyExercise.style != ExerciseStyle::European) {
+            std::cerr << "\033[31mERROR: --american and --bermudan only apply to European-style calls and puts.\033[0m";
+            return EXIT_FAILURE;
+        }
         else {
             OptionType optionType;
             if (insensitiveEquals(argv[6], "Call")) {
@@ -46,11 +106,34 @@ int main(int argc, char* argv[]) {
                 optionType = OptionType::Put;
             }
             OptionParams option = { std::stod(argv[1]), std::stod(argv[2]), std::stod(argv[3]), std::stod(argv[4]) / 100.0, std::stod(argv[5]) / 100.0, optionType };
-            OptionResult model = runMonteCarloSimulation(option);
+            if (argc >= 8) {
+                option.payoffStyle = getPayoffStyle(argv[7]);
+            }
+            if (argc == 10) {
+                option.barrierType = getBarrierType(argv[8]);
+                option.barrierLevel = std::stod(argv[9]);
+            }
+            if (!checkControlVariates(option.payoffStyle, settings)) {
+                return EXIT_FAILURE;
+            }
+            if (hasScenarioGrid(settings)) {
+                return runScenarioPricing(option, settings);
+            }
+            if (isSharded(settings)) {
+                return runShardedPricing(option, std::vector<std::string>(argv + 1, argv + argc), settings);
+            }
+            OptionResult model = runMonteCarloSimulation(option, settings);
             outputResults(model);
+            if (!outputRunStatistics(model, settings)) {
+                return EXIT_FAILURE;
+            }
         }
     }
     else if (argc == 1) {
+        // Interactive options are always European
+        if (!checkControlVariates(PayoffStyle::European, settings)) {
+            return EXIT_FAILURE;
+        }
         std::string spotPriceString, strikePriceString, timeToMaturityString, riskFreeRateString, volatilityString, optionTypeString;
         std::cout << "Enter the spot price: ";
         std::cin >> spotPriceString;
@@ -109,8 +192,17 @@ int main(int argc, char* argv[]) {
         }
 
         OptionParams option = { std::stod(spotPriceString), std::stod(strikePriceString), std::stod(timeToMaturityString), std::stod(riskFreeRateString) / 100.0, std::stod(volatilityString) / 100.0, optionType };
-        OptionResult model = runMonteCarloSimulation(option);
+        if (hasScenarioGrid(settings)) {
+            return runScenarioPricing(option, settings);
+        }
+        if (isSharded(settings)) {
+            return runShardedPricing(option, { spotPriceString, strikePriceString, timeToMaturityString, riskFreeRateString, volatilityString, optionTypeString }, settings);
+        }
+        OptionResult model = runMonteCarloSimulation(option, settings);
         outputResults(model);
+        if (!outputRunStatistics(model, settings)) {
+            return EXIT_FAILURE;
+        }
     }
     else {
         std::cerr << "Unrecognised argument format provided. Use ./MonteCarlo.exe -h for instructions.";